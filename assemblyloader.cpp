@@ -1,23 +1,37 @@
 #include "assemblyloader.h"
 #include "ui_assemblyloader.h"
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QTextStream>
 #include <QTextBlock>
 #include <QScrollBar>
+#include <QElapsedTimer>
+#include <QRegularExpression>
 
 AssemblyLoader::AssemblyLoader(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::AssemblyLoader)
     , currentInstructionIndex(-1)
+    , hitInstructionIndex(-1)
+    , running(false)
 {
     ui->setupUi(this);
     
+    // Editors usually save in several writes; coalesce them into one reload
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(50);
+
     // Connect signals and slots
     connect(ui->loadFileButton, &QPushButton::clicked, this, &AssemblyLoader::loadAssemblyFile);
     connect(ui->stepButton, &QPushButton::clicked, this, &AssemblyLoader::stepInstruction);
     connect(ui->resetButton, &QPushButton::clicked, this, &AssemblyLoader::resetStepping);
     connect(ui->sendInstructionButton, &QPushButton::clicked, this, &AssemblyLoader::sendCurrentInstruction);
+    connect(&fileWatcher, &QFileSystemWatcher::fileChanged, this, &AssemblyLoader::watchedFileChanged);
+    connect(&reloadTimer, &QTimer::timeout, this, &AssemblyLoader::reloadWatchedFile);
+    connect(ui->runButton, &QPushButton::clicked, this, &AssemblyLoader::runOrStop);
+    connect(ui->breakpointButton, &QPushButton::clicked, this, &AssemblyLoader::toggleBreakpoint);
+    connect(ui->watchLineEdit, &QLineEdit::editingFinished, this, &AssemblyLoader::updateWatchpoints);
 }
 
 AssemblyLoader::~AssemblyLoader()
@@ -25,74 +39,188 @@ AssemblyLoader::~AssemblyLoader()
     delete ui;
 }
 
+bool AssemblyLoader::readSourceFile(const QString& fileName, QString& content)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream in(&file);
+    content = in.readAll();
+    file.close();
+    return true;
+}
+
 void AssemblyLoader::loadAssemblyFile()
 {
     QString fileName = QFileDialog::getOpenFileName(this,
         "Open RISC-V Assembly File", "", "Assembly Files (*.s *.S);;All Files (*)");
     
-    if (fileName.isEmpty()) {
-        return;
+    if (!fileName.isEmpty()) {
+        openFile(fileName);
     }
+}
     
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+bool AssemblyLoader::openFile(const QString& fileName)
+{
+    QString fileContent;
+    if (!readSourceFile(fileName, fileContent)) {
         QMessageBox::warning(this, "File Error", 
-            QString("Could not open file: %1").arg(file.errorString()));
-        return;
+            QString("Could not open file: %1").arg(fileName));
+        return false;
     }
     
-    // Clear previous content
-    instructions.clear();
-    ui->assemblyTextEdit->clear();
-    
-    QTextStream in(&file);
-    QString fileContent;
-    int lineNumber = 0;
-    
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        
-        // Skip empty lines and comments
-        if (line.isEmpty() || line.startsWith('#') || line.startsWith("//")) {
-            fileContent += line + "\n";
-            continue;
-        }
-        
-        // Remove inline comments
-        int commentIndex = line.indexOf('#');
-        if (commentIndex != -1) {
-            line = line.left(commentIndex).trimmed();
-        }
-        
-        commentIndex = line.indexOf("//");
-        if (commentIndex != -1) {
-            line = line.left(commentIndex).trimmed();
-        }
-        
-        if (!line.isEmpty()) {
-            instructions.append(line);
-            fileContent += line + "\n";
-        }
+    // Stop watching the previous file
+    if (!fileWatcher.files().isEmpty()) {
+        fileWatcher.removePaths(fileWatcher.files());
     }
+    currentFileName = fileName;
+    fileWatcher.addPath(currentFileName);
     
-    file.close();
+    program.load(fileContent);
+    breakpointLines.clear();
+    rebuildPcBreakpoints();
     
-    // Display the assembly code
-    ui->assemblyTextEdit->setPlainText(fileContent);
+    // Display the assembly source; block N of the document is line N of the file
+    ui->assemblyTextEdit->setPlainText(program.sourceLines().join('\n'));
     
     // Update UI
-    ui->statusLabel->setText(QString("Loaded: %1 instructions").arg(instructions.size()));
-    ui->stepButton->setEnabled(!instructions.isEmpty());
-    ui->resetButton->setEnabled(!instructions.isEmpty());
+    const int count = program.instructions().size();
+    QString status = QString("Loaded: %1 instructions").arg(count);
+    if (program.pseudoInstructionCount() > 0) {
+        status += QString(" (%1 pseudo-instructions expanded)").arg(program.pseudoInstructionCount());
+    }
+    if (program.errorCount() > 0) {
+        status += QString(" (%1 with errors)").arg(program.errorCount());
+    }
+    ui->statusLabel->setText(status);
+    ui->stepButton->setEnabled(count > 0);
+    ui->resetButton->setEnabled(count > 0);
     ui->sendInstructionButton->setEnabled(false);
+    ui->runButton->setEnabled(count > 0);
+    ui->breakpointButton->setEnabled(count > 0);
     
     // Reset stepping
     resetStepping();
+    return true;
+}
+
+void AssemblyLoader::watchedFileChanged(const QString& path)
+{
+    if (path != currentFileName || !ui->watchCheckBox->isChecked()) {
+        return;
+    }
+
+    // Editors that save by rename drop the file from the watcher
+    if (!fileWatcher.files().contains(path) && QFileInfo::exists(path)) {
+        fileWatcher.addPath(path);
+    }
+
+    reloadTimer.start();
+}
+
+void AssemblyLoader::reloadWatchedFile()
+{
+    QString fileContent;
+    if (currentFileName.isEmpty() || !readSourceFile(currentFileName, fileContent)) {
+        return;
+    }
+
+    if (!fileWatcher.files().contains(currentFileName)) {
+        fileWatcher.addPath(currentFileName);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    AssemblyProgram::UpdateResult result = program.update(fileContent);
+    if (result.firstChangedLine < 0) {
+        return;
+    }
+
+    replaceDocumentLines(result);
+
+    // Breakpoints stay on their lines; those on removed lines go with them
+    QSet<int> movedLines;
+    for (int line : breakpointLines) {
+        if (line < result.firstChangedLine) {
+            movedLines.insert(line);
+        } else if (line >= result.firstChangedLine + result.removedLines) {
+            movedLines.insert(line + result.insertedLines - result.removedLines);
+        }
+    }
+    breakpointLines = movedLines;
+    rebuildPcBreakpoints();
+
+    // Keep the stepping position on the same instruction
+    currentInstructionIndex = program.remapIndex(currentInstructionIndex, result);
+    hitInstructionIndex = -1;
+    highlightCurrentInstruction();
+    updateStatus();
+
+    const int count = program.instructions().size();
+    ui->stepButton->setEnabled(count > 0 && currentInstructionIndex < count - 1);
+    ui->resetButton->setEnabled(count > 0);
+    ui->sendInstructionButton->setEnabled(currentInstructionIndex >= 0);
+    ui->runButton->setEnabled(count > 0);
+    ui->breakpointButton->setEnabled(count > 0);
+
+    QString status = QString("Reloaded: %1 instructions, %2 re-encoded, %3 relinked (%4 ms)")
+                         .arg(count)
+                         .arg(result.reencoded)
+                         .arg(result.relinked)
+                         .arg(timer.elapsed());
+    if (program.pseudoInstructionCount() > 0) {
+        status += QString(" (%1 pseudo-instructions expanded)").arg(program.pseudoInstructionCount());
+    }
+    if (program.errorCount() > 0) {
+        status += QString(" (%1 with errors)").arg(program.errorCount());
+    }
+    ui->statusLabel->setText(status);
+}
+
+void AssemblyLoader::replaceDocumentLines(const AssemblyProgram::UpdateResult& result)
+{
+    QTextDocument *document = ui->assemblyTextEdit->document();
+    const QStringList& lines = program.sourceLines();
+
+    QString text;
+    for (int i = 0; i < result.insertedLines; i++) {
+        text += lines[result.firstChangedLine + i] + '\n';
+    }
+
+    QTextBlock startBlock = document->findBlockByNumber(result.firstChangedLine);
+    QTextBlock endBlock = document->findBlockByNumber(result.firstChangedLine + result.removedLines);
+
+    // Only touch the edited blocks so scroll position and undo history survive
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    if (endBlock.isValid()) {
+        cursor.setPosition(startBlock.position());
+        cursor.setPosition(endBlock.position(), QTextCursor::KeepAnchor);
+    } else {
+        // The edit reaches the end of the file: drop the trailing newline instead
+        text.chop(1);
+        if (result.insertedLines == 0 && result.firstChangedLine > 0) {
+            // Removing the last lines also removes the newline before them
+            cursor.setPosition(startBlock.position() - 1);
+        } else if (startBlock.isValid()) {
+            cursor.setPosition(startBlock.position());
+        } else {
+            cursor.movePosition(QTextCursor::End);
+            text.prepend('\n');
+        }
+        cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+    }
+    cursor.insertText(text);
+    cursor.endEditBlock();
 }
 
 void AssemblyLoader::stepInstruction()
 {
-    if (instructions.isEmpty() || currentInstructionIndex >= instructions.size() - 1) {
+    const int count = program.instructions().size();
+    if (count == 0 || currentInstructionIndex >= count - 1) {
         return;
     }
     
@@ -103,78 +231,201 @@ void AssemblyLoader::stepInstruction()
     ui->sendInstructionButton->setEnabled(true);
     
     // Disable step button if we've reached the end
-    if (currentInstructionIndex >= instructions.size() - 1) {
+    if (currentInstructionIndex >= count - 1) {
         ui->stepButton->setEnabled(false);
     }
 }
 
+void AssemblyLoader::setCurrentIndex(int index)
+{
+    const int count = program.instructions().size();
+    currentInstructionIndex = qBound(-1, index, count - 1);
+    highlightCurrentInstruction();
+    updateStatus();
+
+    ui->stepButton->setEnabled(count > 0 && currentInstructionIndex < count - 1);
+    ui->sendInstructionButton->setEnabled(currentInstructionIndex >= 0);
+}
+
 void AssemblyLoader::resetStepping()
 {
     currentInstructionIndex = -1;
+    hitInstructionIndex = -1;
     
-    // Clear any highlighting
-    QTextCursor cursor(ui->assemblyTextEdit->document());
-    cursor.select(QTextCursor::Document);
-    QTextCharFormat format;
-    format.setBackground(Qt::white);
-    cursor.setCharFormat(format);
+    // Clear the stepping highlight; breakpoint marks stay
+    highlightCurrentInstruction();
     
     updateStatus();
-    ui->stepButton->setEnabled(!instructions.isEmpty());
+    ui->stepButton->setEnabled(!program.instructions().isEmpty());
     ui->sendInstructionButton->setEnabled(false);
 }
 
 void AssemblyLoader::sendCurrentInstruction()
 {
-    if (currentInstructionIndex >= 0 && currentInstructionIndex < instructions.size()) {
-        QString instruction = instructions[currentInstructionIndex];
+    if (currentInstructionIndex >= 0 && currentInstructionIndex < program.instructions().size()) {
+        // Label operands are sent already resolved to offsets
+        QString instruction = program.instructions()[currentInstructionIndex].resolvedText;
         emit instructionSelected(instruction);
     }
 }
 
 void AssemblyLoader::highlightCurrentInstruction()
 {
-    if (currentInstructionIndex < 0 || currentInstructionIndex >= instructions.size()) {
+    QTextDocument *document = ui->assemblyTextEdit->document();
+    QList<QTextEdit::ExtraSelection> selections;
+    auto markLine = [&](int sourceLine, const QColor& color) {
+        QTextBlock block = document->findBlockByNumber(sourceLine);
+        if (!block.isValid()) {
+            return false;
+        }
+        QTextEdit::ExtraSelection selection;
+        selection.format.setBackground(color);
+        selection.format.setProperty(QTextFormat::FullWidthSelection, true);
+        selection.cursor = QTextCursor(block);
+        selections.append(selection);
+        return true;
+    };
+
+    // Later selections are drawn on top: breakpoints, then the hit, then the current line
+    for (int line : breakpointLines) {
+        markLine(line, QColor(255, 210, 210));
+    }
+    const QVector<AssemblyProgram::Instruction>& instructions = program.instructions();
+    if (hitInstructionIndex >= 0 && hitInstructionIndex < instructions.size()) {
+        markLine(instructions[hitInstructionIndex].sourceLine, QColor(255, 150, 60));
+    }
+    const bool hasCurrent = currentInstructionIndex >= 0 && currentInstructionIndex < instructions.size()
+                            && markLine(instructions[currentInstructionIndex].sourceLine, Qt::yellow);
+    ui->assemblyTextEdit->setExtraSelections(selections);
+
+    // Ensure the highlighted line is visible
+    if (hasCurrent) {
+        ui->assemblyTextEdit->setTextCursor(selections.last().cursor);
+        ui->assemblyTextEdit->ensureCursorVisible();
+    }
+}
+
+void AssemblyLoader::rebuildPcBreakpoints()
+{
+    breakpointSet.clearPcBreakpoints();
+    for (const AssemblyProgram::Instruction& instruction : program.instructions()) {
+        if (instruction.expansionIndex == 0 && breakpointLines.contains(instruction.sourceLine)) {
+            BreakpointSet::Breakpoint breakpoint;
+            breakpoint.kind = BreakpointSet::Pc;
+            breakpoint.first = breakpoint.last = instruction.address;
+            breakpointSet.add(breakpoint);
+        }
+    }
+}
+
+void AssemblyLoader::toggleBreakpoint()
+{
+    // On the line with the text cursor, if it holds an instruction
+    const int line = ui->assemblyTextEdit->textCursor().blockNumber();
+    bool hasInstruction = false;
+    for (const AssemblyProgram::Instruction& instruction : program.instructions()) {
+        hasInstruction |= instruction.sourceLine == line;
+    }
+    if (breakpointLines.remove(line)) {
+        rebuildPcBreakpoints();
+    } else if (hasInstruction) {
+        breakpointLines.insert(line);
+        rebuildPcBreakpoints();
+    } else {
+        ui->statusLabel->setText("Place the cursor on an instruction line to set a breakpoint");
         return;
     }
-    
-    QTextDocument *document = ui->assemblyTextEdit->document();
-    QTextCursor cursor(document);
-    
-    // Clear previous highlighting
-    cursor.select(QTextCursor::Document);
-    QTextCharFormat defaultFormat;
-    defaultFormat.setBackground(Qt::white);
-    cursor.setCharFormat(defaultFormat);
-    
-    // Find and highlight the current instruction
-    QString targetLine = instructions[currentInstructionIndex];
-    QTextCursor findCursor(document);
-    
-    while (!findCursor.isNull() && !findCursor.atEnd()) {
-        findCursor = document->find(targetLine, findCursor);
-        if (!findCursor.isNull()) {
-            QTextCharFormat highlightFormat;
-            highlightFormat.setBackground(Qt::yellow);
-            findCursor.mergeCharFormat(highlightFormat);
-            
-            // Ensure the highlighted line is visible
-            ui->assemblyTextEdit->setTextCursor(findCursor);
-            ui->assemblyTextEdit->ensureCursorVisible();
-            break;
+    highlightCurrentInstruction();
+}
+
+void AssemblyLoader::updateWatchpoints()
+{
+    QVector<BreakpointSet::Breakpoint> watchpoints;
+    const QStringList specs = ui->watchLineEdit->text().split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+    for (const QString& spec : specs) {
+        BreakpointSet::Breakpoint watchpoint;
+        QString errorMessage;
+        if (!BreakpointSet::parse(spec, watchpoint, errorMessage)) {
+            QMessageBox::warning(this, "Watchpoint Error", errorMessage);
+            return;
         }
+        if (watchpoint.kind == BreakpointSet::Pc) {
+            QMessageBox::warning(this, "Watchpoint Error",
+                                 QString("'%1': set PC breakpoints on the source lines instead").arg(spec));
+            return;
+        }
+        watchpoints.append(watchpoint);
+    }
+
+    breakpointSet.clearWatchpoints();
+    for (const BreakpointSet::Breakpoint& watchpoint : watchpoints) {
+        breakpointSet.add(watchpoint);
     }
 }
 
+void AssemblyLoader::runOrStop()
+{
+    if (running) {
+        emit stopRequested();
+        return;
+    }
+    if (program.errorCount() > 0) {
+        QMessageBox::warning(this, "Run Error",
+                             QString("The program has %1 lines with errors").arg(program.errorCount()));
+        return;
+    }
+    
+    // Continues after the current instruction, or from the top
+    const int firstIndex = currentInstructionIndex + 1;
+    const QVector<AssemblyProgram::Instruction>& instructions = program.instructions();
+    if (firstIndex >= instructions.size()) {
+        ui->statusLabel->setText("Nothing left to run; Reset to start over");
+        return;
+    }
+    QVector<quint32> words;
+    words.reserve(instructions.size() - firstIndex);
+    for (int i = firstIndex; i < instructions.size(); i++) {
+        words.append(instructions[i].machineCode);
+    }
+    hitInstructionIndex = -1;
+    emit runRequested(words, firstIndex);
+}
+    
+void AssemblyLoader::setRunning(bool isRunning)
+{
+    running = isRunning;
+    ui->runButton->setText(running ? "Stop" : "Run");
+    ui->stepButton->setEnabled(!running && currentInstructionIndex < program.instructions().size() - 1);
+    ui->sendInstructionButton->setEnabled(!running && currentInstructionIndex >= 0);
+    ui->resetButton->setEnabled(!running);
+}
+    
+void AssemblyLoader::showBreak(int hitIndex, int lastExecuted, const QString& reason)
+{
+    hitInstructionIndex = hitIndex;
+    setCurrentIndex(lastExecuted);
+    ui->statusLabel->setText(QString("Stopped: %1").arg(reason));
+
+    show();
+    raise();
+}
+
 void AssemblyLoader::updateStatus()
 {
+    const QVector<AssemblyProgram::Instruction>& instructions = program.instructions();
     if (currentInstructionIndex >= 0 && currentInstructionIndex < instructions.size()) {
-        QString currentInstruction = instructions[currentInstructionIndex];
-        ui->currentInstructionLabel->setText(
-            QString("Current Instruction: [%1/%2] %3")
-                .arg(currentInstructionIndex + 1)
-                .arg(instructions.size())
-                .arg(currentInstruction));
+        const AssemblyProgram::Instruction& current = instructions[currentInstructionIndex];
+        QString text = QString("Current Instruction: [%1/%2] %3")
+                           .arg(currentInstructionIndex + 1)
+                           .arg(instructions.size())
+                           .arg(current.text);
+        if (!current.pseudoText.isEmpty()) {
+            text += QString(" (from %1)").arg(current.pseudoText);
+        }
+        if (!current.valid) {
+            text += QString(" - %1").arg(current.errorMessage);
+        }
+        ui->currentInstructionLabel->setText(text);
     } else {
         ui->currentInstructionLabel->setText("Current Instruction: None");
     }
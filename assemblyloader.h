@@ -6,6 +6,11 @@
 #include <QString>
 #include <QTextCursor>
 #include <QTextCharFormat>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
+#include "assemblyprogram.h"
+#include "breakpoints.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -21,21 +26,52 @@ public:
     explicit AssemblyLoader(QWidget *parent = nullptr);
     ~AssemblyLoader();
 
+    bool openFile(const QString& fileName);
+
+    // Stepping position, saved in and restored from session checkpoints
+    QString currentFile() const { return currentFileName; }
+    int currentIndex() const { return currentInstructionIndex; }
+    void setCurrentIndex(int index);
+
+    // PC breakpoints at the instructions of marked lines, plus the watchpoints typed in
+    const BreakpointSet *breakpoints() const { return &breakpointSet; }
+    // Called by the window streaming the program
+    void setRunning(bool running);
+    void showBreak(int hitIndex, int lastExecuted, const QString& reason);
+
 signals:
     void instructionSelected(const QString& instruction);
+    // Words from firstIndex to the end; word n is at address (firstIndex + n) * 4
+    void runRequested(const QVector<quint32>& words, int firstIndex);
+    void stopRequested();
 
 private slots:
     void loadAssemblyFile();
     void stepInstruction();
     void resetStepping();
     void sendCurrentInstruction();
+    void watchedFileChanged(const QString& path);
+    void reloadWatchedFile();
+    void runOrStop();
+    void toggleBreakpoint();
+    void updateWatchpoints();
 
 private:
     Ui::AssemblyLoader *ui;
-    QVector<QString> instructions;
+    AssemblyProgram program;
     int currentInstructionIndex;
-    
+    QString currentFileName;
+    QFileSystemWatcher fileWatcher;
+    QTimer reloadTimer;
+    BreakpointSet breakpointSet;
+    QSet<int> breakpointLines;      // source lines, kept through reloads
+    int hitInstructionIndex;
+    bool running;
+
+    bool readSourceFile(const QString& fileName, QString& content);
+    void replaceDocumentLines(const AssemblyProgram::UpdateResult& result);
     void highlightCurrentInstruction();
+    void rebuildPcBreakpoints();
     void updateStatus();
 };
 
@@ -0,0 +1,307 @@
+#include "assemblyprogram.h"
+#include <QRegularExpression>
+#include <QSet>
+#include "rvassembler.h"
+
+namespace {
+
+// %hi(label) or %lo(label); numbers were already resolved by the expansion
+const QRegularExpression& relocationPattern()
+{
+    static const QRegularExpression pattern(R"(%(hi|lo)\(\s*([A-Za-z_.][\w.]*)\s*\))");
+    return pattern;
+}
+
+}
+
+AssemblyProgram::AssemblyProgram()
+{
+}
+
+void AssemblyProgram::clear()
+{
+    lines.clear();
+    parsedLines.clear();
+    program.clear();
+    labelTable.clear();
+}
+
+AssemblyProgram::UpdateResult AssemblyProgram::load(const QString& source)
+{
+    clear();
+    return update(source);
+}
+
+AssemblyProgram::ParsedLine AssemblyProgram::parseLine(const QString& rawLine)
+{
+    ParsedLine parsed;
+    QString line = rawLine.trimmed();
+
+    // Remove comments
+    int commentIndex = line.indexOf('#');
+    if (commentIndex != -1) {
+        line = line.left(commentIndex);
+    }
+    commentIndex = line.indexOf("//");
+    if (commentIndex != -1) {
+        line = line.left(commentIndex);
+    }
+    line = line.trimmed();
+
+    // Leading label definitions, e.g. "loop: addi x5, x5, -1"
+    static const QRegularExpression labelPattern(R"(^([A-Za-z_.][\w.]*):\s*)");
+    QRegularExpressionMatch match = labelPattern.match(line);
+    while (match.hasMatch()) {
+        parsed.labels.append(match.captured(1));
+        line = line.mid(match.capturedLength()).trimmed();
+        match = labelPattern.match(line);
+    }
+
+    parsed.instruction = line;
+    if (!line.isEmpty()) {
+        // A line that does not expand is kept as written; encoding reports why
+        QString errorMessage;
+        if (!RiscVMachineCodeConverter::expandPseudoInstruction(line, parsed.expansion, errorMessage)) {
+            parsed.expansion = QStringList{line};
+        }
+    }
+    return parsed;
+}
+
+QString AssemblyProgram::labelOperand(const QString& instruction)
+{
+    static const QSet<QString> pcRelative = {
+        "beq", "bne", "blt", "bge", "bltu", "bgeu", "jal"
+    };
+    static const QRegularExpression separators("[\\s,]+");
+    static const QRegularExpression identifier(R"(^[A-Za-z_.][\w.]*$)");
+
+    QRegularExpressionMatch relocation = relocationPattern().match(instruction);
+    if (relocation.hasMatch()) {
+        return relocation.captured(2);
+    }
+
+    QStringList parts = instruction.split(separators, Qt::SkipEmptyParts);
+    if (parts.size() < 2 || !pcRelative.contains(parts[0].toLower())) {
+        return QString();
+    }
+
+    // The offset is always the last operand of a branch or jump
+    const QString& target = parts.last();
+    return identifier.match(target).hasMatch() ? target : QString();
+}
+
+void AssemblyProgram::rebuildLabels()
+{
+    labelTable.clear();
+    quint32 address = 0;
+    for (const ParsedLine& parsed : parsedLines) {
+        for (const QString& label : parsed.labels) {
+            labelTable.insert(label, address);
+        }
+        address += 4 * quint32(parsed.expansion.size());
+    }
+}
+
+void AssemblyProgram::encode(Instruction& instruction)
+{
+    instruction.dirty = false;
+    instruction.linkedAddress = instruction.address;
+    instruction.resolvedText = instruction.text;
+    instruction.errorMessage.clear();
+
+    if (!instruction.labelRef.isEmpty()) {
+        if (!labelTable.contains(instruction.labelRef)) {
+            instruction.linkedTarget = -1;
+            instruction.valid = false;
+            instruction.errorMessage = QString("Undefined label: '%1'").arg(instruction.labelRef);
+            return;
+        }
+
+        quint32 target = labelTable.value(instruction.labelRef);
+        instruction.linkedTarget = target;
+
+        QRegularExpressionMatch relocation = relocationPattern().match(instruction.text);
+        if (relocation.hasMatch()) {
+            // The absolute address, split as lui and addi take it
+            const QString value = relocation.captured(1) == "hi" ? QString::number(qint32(rv::hi(target) << 12))
+                                                                 : QString::number(rv::lo(target));
+            instruction.resolvedText = instruction.text.left(relocation.capturedStart()) + value
+                                       + instruction.text.mid(relocation.capturedEnd());
+        } else {
+            // Replace the label operand with the PC-relative byte offset
+            qint64 offset = qint64(target) - qint64(instruction.address);
+            instruction.resolvedText = instruction.text.left(instruction.text.size() - instruction.labelRef.size())
+                                       + QString::number(offset);
+        }
+    }
+
+    instruction.valid = converter.convertToMachineCode(instruction.resolvedText,
+                                                       instruction.machineCode,
+                                                       instruction.errorMessage);
+}
+
+AssemblyProgram::UpdateResult AssemblyProgram::update(const QString& source)
+{
+    QStringList newLines = source.split('\n');
+    for (QString& line : newLines) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+    }
+
+    UpdateResult result;
+    const int oldCount = lines.size();
+    const int newCount = newLines.size();
+
+    // Common prefix and suffix; everything in between is the edited range
+    int prefix = 0;
+    while (prefix < oldCount && prefix < newCount && lines[prefix] == newLines[prefix]) {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < oldCount - prefix && suffix < newCount - prefix
+           && lines[oldCount - 1 - suffix] == newLines[newCount - 1 - suffix]) {
+        suffix++;
+    }
+
+    if (prefix == oldCount && prefix == newCount) {
+        return result;
+    }
+
+    result.firstChangedLine = prefix;
+    result.removedLines = oldCount - prefix - suffix;
+    result.insertedLines = newCount - prefix - suffix;
+    const int lineDelta = result.insertedLines - result.removedLines;
+
+    // Parse only the edited lines
+    QVector<ParsedLine> segment;
+    segment.reserve(result.insertedLines);
+    QVector<Instruction> insertedInstructions;
+    for (int i = 0; i < result.insertedLines; i++) {
+        ParsedLine parsed = parseLine(newLines[prefix + i]);
+        const bool pseudo = parsed.expansion.size() > 1
+                            || (!parsed.expansion.isEmpty() && parsed.expansion.first() != parsed.instruction);
+        for (int part = 0; part < parsed.expansion.size(); part++) {
+            Instruction instruction;
+            instruction.sourceLine = prefix + i;
+            instruction.text = parsed.expansion[part];
+            instruction.pseudoText = pseudo ? parsed.instruction : QString();
+            instruction.expansionIndex = part;
+            instruction.labelRef = labelOperand(instruction.text);
+            insertedInstructions.append(instruction);
+        }
+        segment.append(parsed);
+    }
+
+    // Locate the instructions that belonged to the edited range
+    int firstOld = 0;
+    while (firstOld < program.size() && program[firstOld].sourceLine < prefix) {
+        firstOld++;
+    }
+    int endOld = firstOld;
+    while (endOld < program.size() && program[endOld].sourceLine < oldCount - suffix) {
+        endOld++;
+    }
+
+    result.firstChangedInstruction = firstOld;
+    result.removedInstructions = endOld - firstOld;
+    result.insertedInstructions = insertedInstructions.size();
+    result.layoutChanged = result.insertedInstructions != result.removedInstructions;
+
+    // Splice the new records between the untouched prefix and suffix
+    QVector<Instruction> updated;
+    updated.reserve(program.size() - result.removedInstructions + result.insertedInstructions);
+    for (int i = 0; i < firstOld; i++) {
+        updated.append(program[i]);
+    }
+    updated += insertedInstructions;
+    for (int i = endOld; i < program.size(); i++) {
+        updated.append(program[i]);
+        updated.last().sourceLine += lineDelta;
+    }
+    program = updated;
+
+    for (int i = firstOld; i < program.size(); i++) {
+        program[i].address = quint32(i) * 4;
+    }
+
+    QVector<ParsedLine> updatedLines;
+    updatedLines.reserve(newCount);
+    for (int i = 0; i < prefix; i++) {
+        updatedLines.append(parsedLines[i]);
+    }
+    updatedLines += segment;
+    for (int i = oldCount - suffix; i < oldCount; i++) {
+        updatedLines.append(parsedLines[i]);
+    }
+    parsedLines = updatedLines;
+    lines = newLines;
+
+    // Label addresses are cheap to recompute; encodings are not
+    rebuildLabels();
+
+    for (Instruction& instruction : program) {
+        bool needsLink = false;
+        if (!instruction.dirty && !instruction.labelRef.isEmpty()) {
+            qint64 target = labelTable.contains(instruction.labelRef)
+                                ? qint64(labelTable.value(instruction.labelRef)) : -1;
+            needsLink = target != instruction.linkedTarget
+                        || instruction.address != instruction.linkedAddress;
+        }
+
+        if (instruction.dirty) {
+            encode(instruction);
+            result.reencoded++;
+        } else if (needsLink) {
+            encode(instruction);
+            result.relinked++;
+        }
+    }
+
+    return result;
+}
+
+int AssemblyProgram::remapIndex(int oldIndex, const UpdateResult& result) const
+{
+    if (oldIndex < 0 || result.firstChangedLine < 0) {
+        return oldIndex;
+    }
+
+    int mapped;
+    if (oldIndex < result.firstChangedInstruction) {
+        mapped = oldIndex;
+    } else if (oldIndex >= result.firstChangedInstruction + result.removedInstructions) {
+        mapped = oldIndex + result.insertedInstructions - result.removedInstructions;
+    } else if (result.insertedInstructions > 0) {
+        // The current instruction itself was edited: stay on its replacement
+        mapped = result.firstChangedInstruction
+                 + qMin(oldIndex - result.firstChangedInstruction, result.insertedInstructions - 1);
+    } else {
+        mapped = result.firstChangedInstruction - 1;
+    }
+
+    return qMin(mapped, int(program.size()) - 1);
+}
+
+int AssemblyProgram::pseudoInstructionCount() const
+{
+    int count = 0;
+    for (const Instruction& instruction : program) {
+        if (!instruction.pseudoText.isEmpty() && instruction.expansionIndex == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int AssemblyProgram::errorCount() const
+{
+    int errors = 0;
+    for (const Instruction& instruction : program) {
+        if (!instruction.valid) {
+            errors++;
+        }
+    }
+    return errors;
+}
@@ -0,0 +1,87 @@
+#ifndef ASSEMBLYPROGRAM_H
+#define ASSEMBLYPROGRAM_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include "riscvmachinecodeconverter.h"
+
+// Assembled view of a .s source file: one record per instruction with its
+// address and encoding. Supports incremental updates so that an edited file
+// only re-encodes the lines that changed plus the label references whose
+// target moved.
+//
+// Pseudo-instructions are expanded when a line is parsed, into as few words
+// as their operands allow; each word gets its own record on the same line.
+class AssemblyProgram
+{
+public:
+    struct Instruction {
+        int sourceLine = -1;        // 0-based line in the source file
+        quint32 address = 0;        // byte address (index * 4)
+        QString text;               // instruction as written (comments stripped), or one word of its expansion
+        QString pseudoText;         // the pseudo-instruction as written, if this word came from one
+        int expansionIndex = 0;     // word within its line's expansion
+        QString resolvedText;       // text with label operands replaced by offsets
+        QString labelRef;           // label this instruction depends on, if any
+        quint32 machineCode = 0;
+        bool valid = false;
+        bool dirty = true;          // needs (re-)encoding
+        qint64 linkedTarget = -1;   // label address used for the last encoding
+        quint32 linkedAddress = 0;  // own address used for the last encoding
+        QString errorMessage;
+    };
+
+    struct UpdateResult {
+        int firstChangedLine = -1;      // -1 when the file did not change
+        int removedLines = 0;
+        int insertedLines = 0;
+        int firstChangedInstruction = 0;
+        int removedInstructions = 0;
+        int insertedInstructions = 0;
+        int reencoded = 0;              // changed lines encoded
+        int relinked = 0;               // unchanged lines re-encoded for labels
+        bool layoutChanged = false;     // addresses after the edit moved
+    };
+
+    AssemblyProgram();
+
+    // Full parse of a source file
+    UpdateResult load(const QString& source);
+
+    // Line-diff the new source against the current one and re-encode only what changed
+    UpdateResult update(const QString& source);
+
+    // Map an instruction index from before the last update to the current program
+    int remapIndex(int oldIndex, const UpdateResult& result) const;
+
+    void clear();
+
+    const QVector<Instruction>& instructions() const { return program; }
+    const QStringList& sourceLines() const { return lines; }
+    const QHash<QString, quint32>& labels() const { return labelTable; }
+    int errorCount() const;
+    // Lines that were pseudo-instructions
+    int pseudoInstructionCount() const;
+
+private:
+    struct ParsedLine {
+        QStringList labels;
+        QString instruction;
+        QStringList expansion;      // real instructions; empty without an instruction
+    };
+
+    static ParsedLine parseLine(const QString& line);
+    static QString labelOperand(const QString& instruction);
+    void rebuildLabels();
+    void encode(Instruction& instruction);
+
+    RiscVMachineCodeConverter converter;
+    QStringList lines;
+    QVector<ParsedLine> parsedLines;
+    QVector<Instruction> program;
+    QHash<QString, quint32> labelTable;
+};
+
+#endif // ASSEMBLYPROGRAM_H
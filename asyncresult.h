@@ -0,0 +1,121 @@
+#ifndef ASYNCRESULT_H
+#define ASYNCRESULT_H
+
+#include <QVector>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#include <exception>
+#define RISCV_HAS_COROUTINES 1
+#endif
+
+// Single-threaded future: the producer finishes it from the event loop and
+// continuations run right there, so nothing ever blocks waiting for a value.
+// When built as C++20 it can also be co_await-ed from an AsyncTask.
+template <typename T>
+class AsyncResult
+{
+public:
+    AsyncResult() : state(std::make_shared<State>()) {}
+
+    bool isFinished() const { return state->finished; }
+    const T& result() const { return state->value; }
+
+    // Runs immediately if the result is already available
+    template <typename Function>
+    void then(Function&& function) const
+    {
+        if (state->finished) {
+            function(state->value);
+            return;
+        }
+        state->continuations.emplace_back(std::forward<Function>(function));
+    }
+
+#ifdef RISCV_HAS_COROUTINES
+    bool await_ready() const noexcept { return state->finished; }
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        state->continuations.emplace_back([handle](const T&) { handle.resume(); });
+    }
+    const T& await_resume() const { return state->value; }
+#endif
+
+private:
+    template <typename> friend class AsyncPromise;
+
+    struct State {
+        bool finished = false;
+        T value{};
+        std::vector<std::function<void(const T&)>> continuations;
+    };
+    std::shared_ptr<State> state;
+};
+
+template <typename T>
+class AsyncPromise
+{
+public:
+    AsyncResult<T> future() const { return pending; }
+    bool isFinished() const { return pending.isFinished(); }
+
+    void finish(const T& value)
+    {
+        auto state = pending.state;
+        if (state->finished) {
+            return;
+        }
+        state->value = value;
+        state->finished = true;
+
+        // Continuations may queue further work; detach them first
+        auto continuations = std::move(state->continuations);
+        state->continuations.clear();
+        for (auto& continuation : continuations) {
+            continuation(state->value);
+        }
+    }
+
+private:
+    AsyncResult<T> pending;
+};
+
+// Finishes once every input has finished, with the results in input order
+template <typename T>
+AsyncResult<QVector<T>> whenAll(const QVector<AsyncResult<T>>& results)
+{
+    AsyncPromise<QVector<T>> promise;
+    auto collected = std::make_shared<QVector<T>>(results.size());
+    auto remaining = std::make_shared<int>(results.size());
+
+    if (results.isEmpty()) {
+        promise.finish(QVector<T>());
+    }
+    for (int i = 0; i < results.size(); i++) {
+        results[i].then([promise, collected, remaining, i](const T& value) mutable {
+            (*collected)[i] = value;
+            if (--(*remaining) == 0) {
+                promise.finish(*collected);
+            }
+        });
+    }
+    return promise.future();
+}
+
+#ifdef RISCV_HAS_COROUTINES
+// Fire-and-forget coroutine type for code that drives a session with co_await
+struct AsyncTask {
+    struct promise_type {
+        AsyncTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+#endif
+
+#endif // ASYNCRESULT_H
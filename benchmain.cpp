@@ -0,0 +1,469 @@
+// Host pipeline benchmark: the real host stack (assembly, frame building,
+// receive decoding, memory-model service, reference model, coverage, log
+// formatting) driven against an in-process simulated core with no link
+// pacing, so the numbers are what the host can sustain, not what the UART
+// allows.
+//
+// Each instruction mix is streamed twice: untraced for throughput, then in
+// short traced chunks for the time spent in each stage.
+//
+// With --faults the link runs through a FaultyLink instead, and each mix
+// reports how often framing desynchronised and how long the session took to
+// get back in step.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QMap>
+#include <QStringList>
+#include <QTextStream>
+#include "assemblyprogram.h"
+#include "faultylink.h"
+#include "instructioncoverage.h"
+#include "instructionstreamer.h"
+#include "referencemodel.h"
+#include "riscvsession.h"
+#include "simulatedcore.h"
+#include "tracing.h"
+#include "uartprotocol.h"
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+struct Mix {
+    const char *name;
+    QStringList block;          // repeated until the instruction count is reached
+};
+
+// x10 points at a 4 KiB table preloaded at 0x1000; everything else is arbitrary
+QVector<Mix> mixes()
+{
+    return {
+        {"alu", {"add x5, x6, x7", "sub x6, x7, x5", "xor x7, x5, x6", "or x8, x5, x7",
+                 "and x9, x8, x6", "sll x5, x6, x9", "slt x6, x5, x7", "addi x7, x7, 13",
+                 "xori x8, x8, 255", "slli x9, x5, 3", "srai x5, x9, 2", "lui x6, 74565"}},
+        {"load", {"lw x5, 0(x10)", "lw x6, 4(x10)", "addi x7, x5, 1", "lw x8, 64(x10)",
+                  "lw x9, 128(x10)", "add x5, x6, x8", "lw x6, 1020(x10)", "lw x7, 2048(x10)"}},
+        {"store", {"sw x5, 0(x10)", "sw x6, 4(x10)", "addi x5, x5, 1", "sw x7, 64(x10)",
+                   "sw x8, 128(x10)", "add x6, x5, x7", "sw x5, 1020(x10)", "sw x6, 2044(x10)"}},
+        {"branch", {"beq x5, x6, 8", "bne x5, x6, 12", "addi x5, x5, 1", "blt x5, x6, -8",
+                    "bge x6, x5, 16", "jal x1, 8", "bltu x7, x8, 4", "bgeu x8, x7, -12"}},
+    };
+}
+
+
+// What the GUI formats per frame when it is not streaming
+class LogFormatter : public QObject
+{
+public:
+    explicit LogFormatter(RiscVSession *session)
+    {
+        connect(session, &RiscVSession::storeReceived, this, [this](quint32 address, quint8 flags, quint32 value) {
+            TRACE_ZONE("log.format");
+            append(QString("Address: 0x%1 (%2)").arg(address, 8, 16, QChar('0')).arg(address));
+            append(flags == UartProtocol::WriteFlag ? "Read/Write:Write" : "Read/Write:Read");
+            append(QString("Data Value: 0x%1 (%2)").arg(value, 8, 16, QChar('0')).arg(value));
+        });
+        connect(session, &RiscVSession::loadServed, this, [this](quint32 address, quint8 size, quint32 value) {
+            TRACE_ZONE("log.format");
+            append(QString("Address: 0x%1 (%2)").arg(address, 8, 16, QChar('0')).arg(address));
+            append(QString("Size: 0x%1 (%2)").arg(size, 2, 16, QChar('0')).arg(size));
+            append(QString("Sent data value: 0x%1 for address: 0x%2")
+                       .arg(value, 8, 16, QChar('0')).arg(address, 8, 16, QChar('0')));
+        });
+        connect(session, &RiscVSession::cpuReady, this, [this]() {
+            TRACE_ZONE("log.format");
+            append(QString("8-bit: 0x%1 (%2)").arg(UartProtocol::CpuReady, 2, 16, QChar('0')).arg(UartProtocol::CpuReady));
+            append("*** CPU Ready Confirmation received ***");
+        });
+    }
+
+private:
+    static const int KeptLines = 1000;
+
+    void append(const QString& line)
+    {
+        lines.append(QString("[%1] %2").arg(++lineNumber).arg(line));
+        if (lines.size() > KeptLines) {
+            lines.removeFirst();
+        }
+    }
+
+    QStringList lines;
+    quint64 lineNumber = 0;
+};
+
+// Desynchronisations a session runs into and how long each takes to clear.
+// One starts at an unexpected byte, or when a hung command was sent, and ends
+// at the next ready byte in step or when the watchdog's resets bring the core
+// back; errors in between belong to the same one.
+class DesyncMonitor : public QObject
+{
+public:
+    explicit DesyncMonitor(RiscVSession *session)
+    {
+        clock.start();
+        connect(session, &RiscVSession::protocolError, this, [this]() {
+            protocolErrors++;
+            begin(clock.nsecsElapsed());
+        });
+        connect(session, &RiscVSession::hangDetected, this, [this](const QString&, int deadlineMs) {
+            hangs++;
+            begin(clock.nsecsElapsed() - qint64(deadlineMs) * 1000000);
+        });
+        connect(session, &RiscVSession::cpuReady, this, [this, session]() {
+            if (!session->isRecovering()) {
+                end(true);
+            }
+        });
+        connect(session, &RiscVSession::recovered, this, [this]() { end(true); });
+        connect(session, &RiscVSession::recoveryFailed, this, [this]() { end(false); });
+    }
+
+    quint64 desyncs = 0;
+    quint64 protocolErrors = 0;
+    quint64 hangs = 0;
+    QVector<qint64> recoveryNs;
+
+private:
+    void begin(qint64 startNs)
+    {
+        if (!inDesync) {
+            inDesync = true;
+            desyncs++;
+            desyncStart = startNs;
+        } else {
+            desyncStart = qMin(desyncStart, startNs);
+        }
+    }
+
+    void end(bool recovered)
+    {
+        if (!inDesync) {
+            return;
+        }
+        inDesync = false;
+        if (recovered) {
+            recoveryNs.append(clock.nsecsElapsed() - desyncStart);
+        }
+    }
+
+    QElapsedTimer clock;
+    bool inDesync = false;
+    qint64 desyncStart = 0;
+};
+
+class Bench
+{
+public:
+    explicit Bench(bool logging)
+    {
+        core.open(QIODevice::ReadWrite);
+        session.setDevice(&core);
+        session.setMemory(&memory);
+        session.setReferenceModel(&reference);
+        session.setCoverage(&coverage);
+        if (logging) {
+            formatter.reset(new LogFormatter(&session));
+        }
+    }
+
+    // Puts the fault injector between the session and the core
+    void injectFaults(const FaultyLink::Faults& faults, int deadlineMarginMs)
+    {
+        link.setDevice(&core);
+        link.setFaults(faults);
+        link.open(QIODevice::ReadWrite);
+        session.setDevice(&link);
+        session.setLinkTiming(115200, deadlineMarginMs);
+    }
+
+    // After a failed recovery: a fresh core, a reference model in step with
+    // it, and nothing left on the wire
+    void powerCycle()
+    {
+        core.powerOn();
+        reference.clear();
+        reference.memory() = memory.snapshot();
+        link.close();
+        link.open(QIODevice::ReadWrite);
+    }
+
+    RiscVSession *connection() { return &session; }
+    const FaultyLink::Counts& faultCounts() const { return link.counts(); }
+
+    // Streams words to the core; false with a message on any failure
+    bool stream(const QVector<quint32>& words, QString& errorMessage)
+    {
+        InstructionListSource source(words);
+        InstructionStreamer streamer(&session);
+        QEventLoop loop;
+        bool ok = false;
+        QObject::connect(&streamer, &InstructionStreamer::finished, &loop,
+                         [&](bool finishedOk, const QString& message) {
+            ok = finishedOk;
+            errorMessage = message;
+            loop.quit();
+        });
+        streamer.start(&source);
+        loop.exec();
+        return ok;
+    }
+
+    void preloadTable()
+    {
+        quint32 table[HostMemory::PageWords];
+        for (int i = 0; i < HostMemory::PageWords; i++) {
+            table[i] = quint32(i) * 0x9E3779B9u;
+        }
+        memory.writeWords(TableBase, table, HostMemory::PageWords);
+        reference.memory().writeWords(TableBase, table, HostMemory::PageWords);
+    }
+
+    static const quint32 TableBase = 0x1000;
+
+private:
+    SimulatedCore core;
+    FaultyLink link;
+    HostMemory memory;
+    ReferenceModel reference;
+    InstructionCoverage coverage;
+    RiscVSession session;
+    std::unique_ptr<LogFormatter> formatter;
+};
+
+const int TracedChunk = 2048;   // instructions per trace read-out, well inside the ring
+const int FaultSegment = 4096;  // instructions per stream with faults; a failed recovery loses the rest of one
+
+double percentileMs(QVector<qint64> samples, double fraction)
+{
+    if (samples.isEmpty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[qMin(samples.size() - 1, int(fraction * samples.size()))] / 1e6;
+}
+
+// Streams words through the fault injector and prints its desync and
+// recovery figures
+void runWithFaults(const char *mixName, const QVector<quint32>& words, const FaultyLink::Faults& faults,
+                   int deadlineMarginMs, QTextStream& out)
+{
+    Bench bench(false);
+    bench.preloadTable();
+    bench.injectFaults(faults, deadlineMarginMs);
+    DesyncMonitor monitor(bench.connection());
+
+    int failedSegments = 0;
+    bool powerCycled = false;
+    QString errorMessage;
+    QElapsedTimer wall;
+    wall.start();
+    for (int offset = 0; offset < words.size(); offset += FaultSegment) {
+        QVector<quint32> segment = words.mid(offset, FaultSegment);
+        if (powerCycled) {
+            // The fresh core lost x10: the mix's first word points it at the table again
+            segment.prepend(words.first());
+        }
+        powerCycled = !bench.stream(segment, errorMessage);
+        if (powerCycled) {
+            failedSegments++;
+            bench.powerCycle();
+        }
+    }
+    const double seconds = wall.nsecsElapsed() / 1e9;
+
+    const FaultyLink::Counts& counts = bench.faultCounts();
+    const quint64 injected = counts.dropped + counts.flipped + counts.duplicated + counts.bursts;
+    qint64 totalNs = 0;
+    for (qint64 ns : monitor.recoveryNs) {
+        totalNs += ns;
+    }
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10\n").arg(mixName, -8).arg(words.size(), 12)
+               .arg(injected, 8).arg(monitor.desyncs, 8)
+               .arg(monitor.desyncs * 1000.0 / words.size(), 9, 'f', 2)
+               .arg(monitor.hangs, 6).arg(failedSegments, 7)
+               .arg(monitor.recoveryNs.isEmpty() ? 0.0 : totalNs / 1e6 / monitor.recoveryNs.size(), 9, 'f', 2)
+               .arg(percentileMs(monitor.recoveryNs, 0.99), 9, 'f', 2)
+               .arg(percentileMs(monitor.recoveryNs, 1.0), 9, 'f', 2);
+    out << QString("%1 faults: %2 dropped, %3 flipped, %4 duplicated, %5 bursts (%6 bytes), %7 delayed; "
+                   "%8 unexpected bytes; %9 s\n")
+               .arg("", -8).arg(counts.dropped).arg(counts.flipped).arg(counts.duplicated)
+               .arg(counts.bursts).arg(counts.burstBytes).arg(counts.delayed)
+               .arg(monitor.protocolErrors).arg(seconds, 0, 'f', 1);
+    out.flush();
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("Risc-V-Testing-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures host pipeline throughput against an in-process simulated core.");
+    parser.addHelpOption();
+    QCommandLineOption countOption({"n", "instructions"}, "Instructions per mix (default 100000).", "count", "100000");
+    QCommandLineOption mixOption("mix", "Only run this mix: alu, load, store or branch. Repeatable.", "name");
+    QCommandLineOption noLogOption("no-log", "Leave out per-frame log formatting.");
+    QCommandLineOption faultsOption("faults",
+                                    "Inject link faults, e.g. drop=1e-4,flip=1e-4,dup=1e-4,burst=1e-5:16,jitter=2,"
+                                    "dir=both,seed=1, and report framing desyncs and recovery times instead.", "spec");
+    QCommandLineOption marginOption("deadline-margin",
+                                    "Watchdog slack per command with --faults (default 10).", "ms", "10");
+    parser.addOptions({countOption, mixOption, noLogOption, faultsOption, marginOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    bool countOk;
+    const int count = parser.value(countOption).toInt(&countOk);
+    if (!countOk || count <= 0) {
+        err << "Instruction count must be a positive integer.\n";
+        return 2;
+    }
+    const QStringList selected = parser.values(mixOption);
+    FaultyLink::Faults faults;
+    const bool faultMode = parser.isSet(faultsOption);
+    int deadlineMargin = 0;
+    if (faultMode) {
+        QString errorMessage;
+        bool marginOk;
+        deadlineMargin = parser.value(marginOption).toInt(&marginOk);
+        if (!FaultyLink::parse(parser.value(faultsOption), faults, errorMessage)) {
+            err << errorMessage << "\n";
+            return 2;
+        }
+        if (!marginOk || deadlineMargin < 0) {
+            err << "Deadline margin must be a non-negative integer.\n";
+            return 2;
+        }
+    }
+
+    Tracing::setThreadName("bench");
+    QStringList stageNames;
+    QVector<QMap<QString, quint64>> stageTotals;
+    QStringList mixNames;
+    QVector<quint64> tracedInstructions;
+
+    if (faultMode) {
+        out << "Faults: " << FaultyLink::describe(faults) << "\n";
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10\n").arg("mix", -8).arg("instructions", 12)
+                   .arg("faults", 8).arg("desyncs", 8).arg("per 1k", 9).arg("hangs", 6).arg("failed", 7)
+                   .arg("mean ms", 9).arg("p99 ms", 9).arg("max ms", 9);
+    } else {
+        out << QString("%1 %2 %3 %4\n").arg("mix", -8).arg("instructions", 12).arg("instr/s", 12).arg("us/instr", 10);
+    }
+    for (const Mix& mix : mixes()) {
+        if (!selected.isEmpty() && !selected.contains(mix.name)) {
+            continue;
+        }
+
+        // Assembly is part of the pipeline too: a whole source file, as the loader sees it
+        QStringList lines{QString("lui x10, %1").arg(Bench::TableBase)};
+        while (lines.size() < count) {
+            lines.append(mix.block.mid(0, count - lines.size()));
+        }
+        QElapsedTimer assemblyTimer;
+        assemblyTimer.start();
+        AssemblyProgram program;
+        program.load(lines.join('\n'));
+        const qint64 assemblyNs = assemblyTimer.nsecsElapsed();
+        if (program.errorCount() > 0) {
+            err << QString("%1: the mix does not assemble\n").arg(mix.name);
+            return 2;
+        }
+        QVector<quint32> words;
+        words.reserve(program.instructions().size());
+        for (const AssemblyProgram::Instruction& instruction : program.instructions()) {
+            words.append(instruction.machineCode);
+        }
+        if (faultMode) {
+            runWithFaults(mix.name, words, faults, deadlineMargin, out);
+            mixNames.append(mix.name);
+            continue;
+        }
+
+        // Throughput, untraced
+        Bench bench(!parser.isSet(noLogOption));
+        bench.preloadTable();
+        QString errorMessage;
+        QElapsedTimer wall;
+        wall.start();
+        if (!bench.stream(words, errorMessage)) {
+            err << QString("%1: %2\n").arg(mix.name, errorMessage);
+            return 1;
+        }
+        const double seconds = wall.nsecsElapsed() / 1e9;
+        out << QString("%1 %2 %3 %4\n").arg(mix.name, -8).arg(words.size(), 12)
+                   .arg(words.size() / seconds, 12, 'f', 0).arg(seconds * 1e6 / words.size(), 10, 'f', 2);
+        out.flush();
+
+        // Stages, traced in chunks short enough that no ring wraps
+        QMap<QString, quint64> totals;     // self time per stage
+        totals["assembly"] = quint64(assemblyNs);
+        Tracing::setEnabled(true);
+        quint64 traced = 0;
+        QElapsedTimer tracedWall;
+        quint64 tracedWallNs = 0;
+        for (int offset = 0; offset < words.size(); offset += TracedChunk) {
+            Tracing::clear();
+            tracedWall.start();
+            if (!bench.stream(words.mid(offset, TracedChunk), errorMessage)) {
+                err << QString("%1: %2\n").arg(mix.name, errorMessage);
+                return 1;
+            }
+            tracedWallNs += quint64(tracedWall.nsecsElapsed());
+            traced += quint64(qMin(TracedChunk, words.size() - offset));
+            for (const Tracing::ZoneTotal& zone : Tracing::totals()) {
+                totals[zone.name] += zone.selfNs;
+            }
+        }
+        Tracing::setEnabled(false);
+
+        // Whatever no zone covers: the event loop, signal dispatch, timers
+        quint64 covered = 0;
+        for (auto it = totals.cbegin(); it != totals.cend(); ++it) {
+            covered += it.key() == "assembly" ? 0 : it.value();
+        }
+        totals["other (event loop)"] = tracedWallNs > covered ? tracedWallNs - covered : 0;
+
+        for (const QString& stage : totals.keys()) {
+            if (!stageNames.contains(stage)) {
+                stageNames.append(stage);
+            }
+        }
+        mixNames.append(mix.name);
+        stageTotals.append(totals);
+        tracedInstructions.append(traced);
+    }
+
+    if (mixNames.isEmpty()) {
+        err << "No such mix.\n";
+        return 2;
+    }
+    if (faultMode) {
+        return 0;
+    }
+
+    // Assembly is per instruction of the whole program; the rest per traced instruction
+    out << "\nStage self time, ns per instruction (traced pass):\n";
+    out << QString("%1").arg("stage", -24);
+    for (const QString& name : mixNames) {
+        out << QString("%1").arg(name, 10);
+    }
+    out << "\n";
+    stageNames.sort();
+    for (const QString& stage : stageNames) {
+        out << QString("%1").arg(stage, -24);
+        for (int i = 0; i < mixNames.size(); i++) {
+            const quint64 instructions = stage == "assembly" ? quint64(count) : tracedInstructions[i];
+            out << QString("%1").arg(double(stageTotals[i].value(stage)) / instructions, 10, 'f', 1);
+        }
+        out << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "breakpoints.h"
+#include "hostmemory.h"
+#include <algorithm>
+
+namespace {
+
+QString hex(quint32 value)
+{
+    return QString("0x%1").arg(value, 8, 16, QChar('0'));
+}
+
+}
+
+QString BreakpointSet::Breakpoint::toString() const
+{
+    QString text = kind == Pc ? "pc:" : kind == Store ? "store:" : "load:";
+    text += hex(first);
+    if (last != first) {
+        text += "-" + hex(last);
+    }
+    if (matchValue) {
+        text += "=" + hex(value);
+    }
+    return text;
+}
+
+bool BreakpointSet::parse(const QString& spec, Breakpoint& breakpoint, QString& errorMessage)
+{
+    const int colon = spec.indexOf(':');
+    const QString kind = spec.left(colon).trimmed().toLower();
+    QString rest = spec.mid(colon + 1).trimmed();
+    breakpoint = Breakpoint();
+    if (colon < 0 || (kind != "pc" && kind != "store" && kind != "load")) {
+        errorMessage = QString("'%1': expected pc:, store: or load:").arg(spec);
+        return false;
+    }
+    breakpoint.kind = kind == "pc" ? Pc : kind == "store" ? Store : Load;
+
+    const int equals = rest.indexOf('=');
+    if (equals >= 0) {
+        if (breakpoint.kind == Pc || !HostMemory::parseAddress(rest.mid(equals + 1).trimmed(), breakpoint.value)) {
+            errorMessage = QString("'%1': expected =value after a store or load address").arg(spec);
+            return false;
+        }
+        breakpoint.matchValue = true;
+        rest = rest.left(equals).trimmed();
+    }
+    const int dash = rest.indexOf('-');
+    if (!HostMemory::parseAddress((dash < 0 ? rest : rest.left(dash)).trimmed(), breakpoint.first)
+        || (dash >= 0
+            && (breakpoint.kind == Pc || !HostMemory::parseAddress(rest.mid(dash + 1).trimmed(), breakpoint.last)))) {
+        errorMessage = QString("'%1': expected an address, or first-last for a store or load range").arg(spec);
+        return false;
+    }
+    if (dash < 0) {
+        breakpoint.last = breakpoint.first;
+    }
+    if (breakpoint.last < breakpoint.first) {
+        errorMessage = QString("'%1': the range ends before it starts").arg(spec);
+        return false;
+    }
+    return true;
+}
+
+void BreakpointSet::add(const Breakpoint& breakpoint)
+{
+    entries.append(breakpoint);
+    rebuild();
+}
+
+void BreakpointSet::removePc(quint32 address)
+{
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [address](const Breakpoint& breakpoint) {
+        return breakpoint.kind == Pc && breakpoint.first == address;
+    }), entries.end());
+    rebuild();
+}
+
+void BreakpointSet::clear()
+{
+    entries.clear();
+    rebuild();
+}
+
+void BreakpointSet::clearWatchpoints()
+{
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Breakpoint& breakpoint) {
+        return breakpoint.kind != Pc;
+    }), entries.end());
+    rebuild();
+}
+
+void BreakpointSet::clearPcBreakpoints()
+{
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Breakpoint& breakpoint) {
+        return breakpoint.kind == Pc;
+    }), entries.end());
+    rebuild();
+}
+
+void BreakpointSet::rebuild()
+{
+    // Sized to the highest breakpoint, so a program's worth of words is a few bytes
+    quint32 highest = 0;
+    bool anyPc = false;
+    for (const Breakpoint& breakpoint : entries) {
+        if (breakpoint.kind == Pc) {
+            highest = qMax(highest, breakpoint.first >> 2);
+            anyPc = true;
+        }
+    }
+    pcBits.assign(anyPc ? highest / 64 + 1 : 0, 0);
+    pcLimit = anyPc ? highest + 1 : 0;
+    for (const Breakpoint& breakpoint : entries) {
+        if (breakpoint.kind == Pc) {
+            const quint32 word = breakpoint.first >> 2;
+            pcBits[word >> 6] |= quint64(1) << (word & 63);
+        }
+    }
+
+    buildIndex(Store, storeIndex);
+    buildIndex(Load, loadIndex);
+}
+
+void BreakpointSet::buildIndex(Kind kind, std::vector<Segment>& index) const
+{
+    index.clear();
+
+    // Every range start and end splits the address space; each piece is
+    // covered by the same watchpoints throughout
+    std::vector<quint64> bounds;
+    for (const Breakpoint& breakpoint : entries) {
+        if (breakpoint.kind == kind) {
+            bounds.push_back(breakpoint.first);
+            bounds.push_back(quint64(breakpoint.last) + 1);
+        }
+    }
+    if (bounds.empty()) {
+        return;
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    for (quint64 bound : bounds) {
+        if (bound > 0xFFFFFFFFull) {
+            break;
+        }
+        Segment segment;
+        segment.first = quint32(bound);
+        for (int i = 0; i < entries.size(); i++) {
+            if (entries[i].kind == kind && entries[i].first <= bound && bound <= entries[i].last) {
+                segment.covering.append(i);
+            }
+        }
+        index.push_back(segment);
+    }
+}
+
+const BreakpointSet::Breakpoint *BreakpointSet::find(const std::vector<Segment>& index, quint32 address,
+                                                     quint32 value) const
+{
+    auto it = std::upper_bound(index.begin(), index.end(), address,
+                               [](quint32 target, const Segment& segment) { return target < segment.first; });
+    if (it == index.begin()) {
+        return nullptr;
+    }
+    for (int i : (--it)->covering) {
+        const Breakpoint& breakpoint = entries[i];
+        if (!breakpoint.matchValue || breakpoint.value == value) {
+            return &breakpoint;
+        }
+    }
+    return nullptr;
+}
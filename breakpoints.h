@@ -0,0 +1,75 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include <QString>
+#include <QVector>
+#include <vector>
+
+// PC breakpoints and memory watchpoints for streamed programs. Lookups run
+// once per instruction or bus access, so they are indexed: PC breakpoints in
+// a bitmap over word addresses, watchpoints in sorted disjoint segments with
+// a binary search. An empty set costs one comparison.
+//
+// The host feeds the core a linear stream, so the PC of a streamed word is
+// its address in the program, not whatever a branch on the core computed.
+class BreakpointSet
+{
+public:
+    enum Kind { Pc, Store, Load };
+
+    struct Breakpoint {
+        Kind kind = Pc;
+        quint32 first = 0;
+        quint32 last = 0;           // inclusive; == first for a single address
+        bool matchValue = false;    // only when the stored or loaded word equals value
+        quint32 value = 0;
+
+        QString toString() const;
+    };
+
+    // "pc:address", or "store:" / "load:" followed by address[-last][=value]
+    static bool parse(const QString& spec, Breakpoint& breakpoint, QString& errorMessage);
+
+    void add(const Breakpoint& breakpoint);
+    void removePc(quint32 address);
+    void clear();
+    // Removes the watchpoints and keeps the PC breakpoints, or the other way round
+    void clearWatchpoints();
+    void clearPcBreakpoints();
+
+    const QVector<Breakpoint>& breakpoints() const { return entries; }
+    bool isEmpty() const { return entries.isEmpty(); }
+
+    bool breaksAt(quint32 pc) const
+    {
+        const quint32 word = pc >> 2;
+        return word < pcLimit && (pcBits[word >> 6] >> (word & 63)) & 1;
+    }
+    // The first watchpoint the access triggers, or nullptr
+    const Breakpoint *onStore(quint32 address, quint32 value) const
+    {
+        return storeIndex.empty() ? nullptr : find(storeIndex, address, value);
+    }
+    const Breakpoint *onLoad(quint32 address, quint32 value) const
+    {
+        return loadIndex.empty() ? nullptr : find(loadIndex, address, value);
+    }
+
+private:
+    struct Segment {
+        quint32 first;          // runs up to the next segment's first
+        QVector<int> covering;  // indices into entries; empty in gaps
+    };
+
+    void rebuild();
+    void buildIndex(Kind kind, std::vector<Segment>& index) const;
+    const Breakpoint *find(const std::vector<Segment>& index, quint32 address, quint32 value) const;
+
+    QVector<Breakpoint> entries;
+    std::vector<quint64> pcBits;
+    quint32 pcLimit = 0;        // words covered by pcBits
+    std::vector<Segment> storeIndex;
+    std::vector<Segment> loadIndex;
+};
+
+#endif // BREAKPOINTS_H
@@ -0,0 +1,450 @@
+#include "capturefile.h"
+#include "riscvmachinecodeconverter.h"
+#include <QDateTime>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char CaptureMagic[8] = {'R', 'V', 'C', 'A', 'P', 'T', 'U', 'R'};
+const char IndexMagic[8] = {'R', 'V', 'C', 'A', 'P', 'I', 'D', 'X'};
+const quint32 FormatVersion = 1;
+
+void encode(const CaptureRecord& record, char *bytes)
+{
+    std::memset(bytes, 0, CaptureWriter::RecordSize);
+    qToLittleEndian(record.timeNs, bytes);
+    qToLittleEndian(record.address, bytes + 8);
+    qToLittleEndian(record.value, bytes + 12);
+    bytes[16] = char(record.kind);
+    bytes[17] = char(record.flags);
+}
+
+CaptureRecord decode(const uchar *bytes)
+{
+    CaptureRecord record;
+    record.timeNs = qFromLittleEndian<quint64>(bytes);
+    record.address = qFromLittleEndian<quint32>(bytes + 8);
+    record.value = qFromLittleEndian<quint32>(bytes + 12);
+    record.kind = CaptureRecord::Kind(bytes[16]);
+    record.flags = bytes[17];
+    return record;
+}
+
+QString hex(quint32 value)
+{
+    return QString("0x%1").arg(value, 8, 16, QChar('0'));
+}
+
+}
+
+QString CaptureRecord::toString() const
+{
+    switch (kind) {
+    case Instruction:
+        return QString("instruction %1  %2").arg(hex(value), RiscVMachineCodeConverter::disassemble(value));
+    case Command:
+        return value == quint32(quint8(UartProtocol::ResetCommand)) ? QString("reset")
+               : value == quint32(quint8(UartProtocol::ProgramCounterCommand)) ? QString("PC request")
+                                                                               : QString("command 0x%1").arg(value, 2, 16, QChar('0'));
+    case Store:
+        return QString("store %1 = %2").arg(hex(address), hex(value));
+    case Load:
+        return QString("load %1 -> %2 (size %3)").arg(hex(address), hex(value)).arg(flags);
+    case ProgramCounter:
+        return QString("pc %1").arg(hex(value));
+    case Ready:
+        return "ready";
+    case UnexpectedByte:
+        return QString("unexpected byte 0x%1").arg(value, 2, 16, QChar('0'));
+    }
+    return QString("unknown record %1").arg(int(kind));
+}
+
+void CaptureWriter::IndexBuilder::clear()
+{
+    records = 0;
+    instructions = 0;
+    checkpoints.clear();
+    addresses.clear();
+}
+
+void CaptureWriter::IndexBuilder::add(const CaptureRecord& record, quint64 offset)
+{
+    if (records % IndexStride == 0) {
+        char entry[CheckpointSize];
+        qToLittleEndian(instructions, entry);
+        qToLittleEndian(record.timeNs, entry + 8);
+        qToLittleEndian(offset, entry + 16);
+        checkpoints.append(entry, CheckpointSize);
+    }
+    records++;
+
+    if (record.kind == CaptureRecord::Instruction) {
+        instructions++;
+    } else if (record.kind == CaptureRecord::Store || record.kind == CaptureRecord::Load) {
+        AddressEntry& entry = addresses[record.address & ~3u];
+        if (entry.accesses++ == 0) {
+            entry.first = offset;
+        }
+        entry.last = offset;
+        if (record.kind == CaptureRecord::Store && entry.firstStore == 0) {
+            entry.firstStore = offset;
+        }
+    }
+}
+
+bool CaptureWriter::IndexBuilder::write(const QString& fileName, quint64 dataSize, QString& errorMessage) const
+{
+    QFile out(fileName);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, out.errorString());
+        return false;
+    }
+
+    char header[IndexHeaderSize] = {};
+    std::memcpy(header, IndexMagic, sizeof(IndexMagic));
+    qToLittleEndian(FormatVersion, header + 8);
+    qToLittleEndian(quint32(IndexStride), header + 12);
+    qToLittleEndian(dataSize, header + 16);
+    qToLittleEndian(records, header + 24);
+    qToLittleEndian(instructions, header + 32);
+    qToLittleEndian(quint64(checkpoints.size() / CheckpointSize), header + 40);
+    qToLittleEndian(quint64(addresses.size()), header + 48);
+
+    QVector<quint32> sorted;
+    sorted.reserve(addresses.size());
+    for (auto it = addresses.cbegin(); it != addresses.cend(); ++it) {
+        sorted.append(it.key());
+    }
+    std::sort(sorted.begin(), sorted.end());
+    QByteArray table(int(sorted.size()) * AddressEntrySize, '\0');
+    char *entry = table.data();
+    for (quint32 address : sorted) {
+        const AddressEntry& summary = addresses[address];
+        qToLittleEndian(address, entry);
+        qToLittleEndian(summary.accesses, entry + 8);
+        qToLittleEndian(summary.first, entry + 16);
+        qToLittleEndian(summary.last, entry + 24);
+        qToLittleEndian(summary.firstStore, entry + 32);
+        entry += AddressEntrySize;
+    }
+
+    if (out.write(header, IndexHeaderSize) != IndexHeaderSize || out.write(checkpoints) != checkpoints.size()
+        || out.write(table) != table.size()) {
+        errorMessage = QString("Failed to write %1: %2").arg(fileName, out.errorString());
+        return false;
+    }
+    return true;
+}
+
+CaptureWriter::CaptureWriter()
+    : writeFailed(false)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    QString errorMessage;
+    close(errorMessage);
+}
+
+bool CaptureWriter::open(const QString& fileName, QString& errorMessage)
+{
+    QString closeError;
+    close(closeError);
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    writeFailed = false;
+    index.clear();
+    buffer.clear();
+    buffer.reserve(FlushThreshold + RecordSize);
+
+    char header[HeaderSize] = {};
+    std::memcpy(header, CaptureMagic, sizeof(CaptureMagic));
+    qToLittleEndian(FormatVersion, header + 8);
+    qToLittleEndian(quint32(RecordSize), header + 12);
+    qToLittleEndian(quint64(QDateTime::currentMSecsSinceEpoch()), header + 16);
+    buffer.append(header, HeaderSize);
+    clock.start();
+    return true;
+}
+
+bool CaptureWriter::close(QString& errorMessage)
+{
+    if (!file.isOpen()) {
+        return true;
+    }
+    flush();
+    bool ok = !writeFailed;
+    if (!ok) {
+        errorMessage = QString("Failed to write %1: %2").arg(file.fileName(), file.errorString());
+    }
+    file.close();
+    return ok && index.write(indexFileName(file.fileName()), HeaderSize + index.records * RecordSize, errorMessage);
+}
+
+void CaptureWriter::flush()
+{
+    if (buffer.isEmpty()) {
+        return;
+    }
+    if (file.write(buffer) != buffer.size()) {
+        writeFailed = true;
+    }
+    buffer.clear();
+}
+
+void CaptureWriter::append(CaptureRecord::Kind kind, quint32 address, quint32 value, quint8 flags)
+{
+    CaptureRecord record;
+    record.timeNs = quint64(clock.nsecsElapsed());
+    record.kind = kind;
+    record.address = address;
+    record.value = value;
+    record.flags = flags;
+    index.add(record, HeaderSize + index.records * RecordSize);
+
+    char bytes[RecordSize];
+    encode(record, bytes);
+    buffer.append(bytes, RecordSize);
+    if (buffer.size() >= FlushThreshold) {
+        flush();
+    }
+}
+
+void CaptureWriter::instructionSent(quint32 machineCode)
+{
+    if (file.isOpen()) {
+        append(CaptureRecord::Instruction, 0, machineCode);
+    }
+}
+
+void CaptureWriter::commandSent(char command)
+{
+    if (file.isOpen()) {
+        append(CaptureRecord::Command, 0, quint8(command));
+    }
+}
+
+void CaptureWriter::loadServed(quint32 address, quint8 size, quint32 value)
+{
+    if (file.isOpen()) {
+        append(CaptureRecord::Load, address, value, size);
+    }
+}
+
+void CaptureWriter::eventDecoded(const ProtocolDecoder::Event& event)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    switch (event.type) {
+    case ProtocolDecoder::Event::Store:
+        append(CaptureRecord::Store, event.address, event.value, event.flags);
+        break;
+    case ProtocolDecoder::Event::LoadRequest:
+        break;
+    case ProtocolDecoder::Event::ProgramCounter:
+        append(CaptureRecord::ProgramCounter, 0, event.value);
+        break;
+    case ProtocolDecoder::Event::CpuReady:
+        append(CaptureRecord::Ready, 0, 0);
+        break;
+    case ProtocolDecoder::Event::UnexpectedByte:
+        append(CaptureRecord::UnexpectedByte, 0, event.value);
+        break;
+    }
+}
+
+bool CaptureWriter::rebuildIndex(const QString& fileName, QString& errorMessage)
+{
+    QFile in(fileName);
+    if (!in.open(QIODevice::ReadWrite)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, in.errorString());
+        return false;
+    }
+    const QByteArray header = in.read(HeaderSize);
+    if (header.size() != HeaderSize || std::memcmp(header.constData(), CaptureMagic, sizeof(CaptureMagic)) != 0) {
+        errorMessage = QString("%1 is not a capture file").arg(fileName);
+        return false;
+    }
+    const quint64 records = quint64(in.size() - HeaderSize) / RecordSize;
+    const qint64 dataSize = qint64(HeaderSize + records * RecordSize);
+    if (in.size() != dataSize && !in.resize(dataSize)) {
+        errorMessage = QString("Could not cut the torn record off %1: %2").arg(fileName, in.errorString());
+        return false;
+    }
+
+    IndexBuilder index;
+    const int ChunkRecords = 4096;
+    for (quint64 done = 0; done < records;) {
+        const QByteArray chunk = in.read(qint64(qMin<quint64>(ChunkRecords, records - done)) * RecordSize);
+        if (chunk.isEmpty() || chunk.size() % RecordSize != 0) {
+            errorMessage = QString("Failed to read %1: %2").arg(fileName, in.errorString());
+            return false;
+        }
+        for (int i = 0; i < chunk.size(); i += RecordSize, done++) {
+            index.add(decode(reinterpret_cast<const uchar *>(chunk.constData()) + i), HeaderSize + done * RecordSize);
+        }
+    }
+    return index.write(indexFileName(fileName), quint64(dataSize), errorMessage);
+}
+
+CaptureReader::CaptureReader()
+    : data(nullptr)
+    , index(nullptr)
+    , records(0)
+    , instructions(0)
+    , checkpoints(0)
+    , addresses(0)
+    , startMs(0)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+void CaptureReader::close()
+{
+    dataFile.close();     // also unmaps
+    indexFile.close();
+    data = nullptr;
+    index = nullptr;
+    records = instructions = checkpoints = addresses = 0;
+}
+
+bool CaptureReader::open(const QString& fileName, QString& errorMessage)
+{
+    close();
+    dataFile.setFileName(fileName);
+    indexFile.setFileName(CaptureWriter::indexFileName(fileName));
+    if (!dataFile.open(QIODevice::ReadOnly) || !indexFile.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, dataFile.isOpen() ? indexFile.errorString()
+                                                                                          : dataFile.errorString());
+        close();
+        return false;
+    }
+    if (dataFile.size() < CaptureWriter::HeaderSize || indexFile.size() < CaptureWriter::IndexHeaderSize
+        || !(data = dataFile.map(0, dataFile.size())) || !(index = indexFile.map(0, indexFile.size()))
+        || std::memcmp(data, CaptureMagic, sizeof(CaptureMagic)) != 0
+        || std::memcmp(index, IndexMagic, sizeof(IndexMagic)) != 0
+        || qFromLittleEndian<quint32>(data + 12) != quint32(CaptureWriter::RecordSize)) {
+        errorMessage = QString("%1 is not a capture file with an index").arg(fileName);
+        close();
+        return false;
+    }
+    if (qFromLittleEndian<quint64>(index + 16) != quint64(dataFile.size())) {
+        errorMessage = QString("The index of %1 is out of date; rebuild it").arg(fileName);
+        close();
+        return false;
+    }
+
+    startMs = qint64(qFromLittleEndian<quint64>(data + 16));
+    records = qFromLittleEndian<quint64>(index + 24);
+    instructions = qFromLittleEndian<quint64>(index + 32);
+    checkpoints = qFromLittleEndian<quint64>(index + 40);
+    addresses = qFromLittleEndian<quint64>(index + 48);
+    if (CaptureWriter::IndexHeaderSize + checkpoints * CaptureWriter::CheckpointSize
+            + addresses * CaptureWriter::AddressEntrySize != quint64(indexFile.size())) {
+        errorMessage = QString("The index of %1 is damaged; rebuild it").arg(fileName);
+        close();
+        return false;
+    }
+    return true;
+}
+
+CaptureRecord CaptureReader::record(quint64 index) const
+{
+    return decode(data + CaptureWriter::HeaderSize + index * CaptureWriter::RecordSize);
+}
+
+quint64 CaptureReader::checkpointField(quint64 checkpoint, int field) const
+{
+    return qFromLittleEndian<quint64>(index + CaptureWriter::IndexHeaderSize
+                                      + checkpoint * CaptureWriter::CheckpointSize + field * 8);
+}
+
+quint64 CaptureReader::findInstruction(quint64 instruction) const
+{
+    if (instruction >= instructions) {
+        return records;
+    }
+
+    // Last checkpoint with at most `instruction` instructions before it; the one wanted is at or after it
+    quint64 low = 0;
+    quint64 high = checkpoints;
+    while (high - low > 1) {
+        const quint64 middle = low + (high - low) / 2;
+        if (checkpointField(middle, 0) <= instruction) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    quint64 seen = checkpointField(low, 0);
+    for (quint64 i = recordAt(checkpointField(low, 2)); i < records; i++) {
+        if (record(i).kind == CaptureRecord::Instruction && seen++ == instruction) {
+            return i;
+        }
+    }
+    return records;
+}
+
+quint64 CaptureReader::findTime(quint64 timeNs) const
+{
+    if (checkpoints == 0) {
+        return records;
+    }
+    quint64 low = 0;
+    quint64 high = checkpoints;
+    while (high - low > 1) {
+        const quint64 middle = low + (high - low) / 2;
+        if (checkpointField(middle, 1) <= timeNs) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    for (quint64 i = recordAt(checkpointField(low, 2)); i < records; i++) {
+        if (record(i).timeNs >= timeNs) {
+            return i;
+        }
+    }
+    return records;
+}
+
+bool CaptureReader::findAddress(quint32 address, AddressSummary& summary) const
+{
+    const uchar *table = index + CaptureWriter::IndexHeaderSize + checkpoints * CaptureWriter::CheckpointSize;
+    address &= ~3u;
+    quint64 low = 0;
+    quint64 high = addresses;
+    while (low < high) {
+        const quint64 middle = low + (high - low) / 2;
+        const uchar *entry = table + middle * CaptureWriter::AddressEntrySize;
+        const quint32 entryAddress = qFromLittleEndian<quint32>(entry);
+        if (entryAddress == address) {
+            summary.accesses = qFromLittleEndian<quint64>(entry + 8);
+            summary.firstRecord = recordAt(qFromLittleEndian<quint64>(entry + 16));
+            summary.lastRecord = recordAt(qFromLittleEndian<quint64>(entry + 24));
+            const quint64 firstStore = qFromLittleEndian<quint64>(entry + 32);
+            summary.stored = firstStore != 0;
+            summary.firstStoreRecord = summary.stored ? recordAt(firstStore) : 0;
+            return true;
+        }
+        if (entryAddress < address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
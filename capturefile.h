@@ -0,0 +1,148 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "uartprotocol.h"
+
+// Session captures for long soak runs: every instruction, command and
+// decoded reply as a fixed-size record, plus a side index ("<file>.idx")
+// that is built while recording and written on close.
+//
+// Capture file: a 32-byte header ("RVCAPTUR", version, record size, start
+// time in ms since the epoch), then 24-byte little-endian records:
+//   u64 time (ns since the start), u32 address, u32 value, u8 kind, u8 flags, 6 bytes zero
+//
+// Index file: a 64-byte header ("RVCAPIDX", version, stride, the capture's
+// size, record, instruction, checkpoint and address counts), then
+//   checkpoints  one per IndexStride records: u64 instructions before it, u64 time, u64 offset
+//   addresses    sorted by word address: u32 address, u32 zero, u64 accesses,
+//                u64 first, last and first-store offsets (0: none)
+// Both tables are fixed-size and sorted, so a reader maps the file and
+// binary-searches them in place: instruction number, time and address
+// lookups cost O(log n) plus at most IndexStride records of scanning.
+struct CaptureRecord {
+    enum Kind : quint8 { Instruction, Command, Store, Load, ProgramCounter, Ready, UnexpectedByte };
+
+    quint64 timeNs = 0;
+    quint32 address = 0;    // loads and stores
+    quint32 value = 0;      // instruction word, command byte, data, program counter or the unexpected byte
+    Kind kind = Ready;
+    quint8 flags = 0;       // read/write byte of a store, size of a load
+
+    QString toString() const;
+};
+
+class CaptureWriter
+{
+public:
+    static const int HeaderSize = 32;
+    static const int RecordSize = 24;
+    static const int IndexHeaderSize = 64;
+    static const int CheckpointSize = 24;
+    static const int AddressEntrySize = 40;
+    static const int IndexStride = 1024;
+
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const QString& fileName, QString& errorMessage);
+    // Flushes, writes the index and closes; false if any write failed
+    bool close(QString& errorMessage);
+    bool isOpen() const { return file.isOpen(); }
+    quint64 recordCount() const { return index.records; }
+
+    static QString indexFileName(const QString& fileName) { return fileName + ".idx"; }
+    // Regenerates the index from the records, e.g. after a run that never
+    // closed its capture; a torn last record is cut off
+    static bool rebuildIndex(const QString& fileName, QString& errorMessage);
+
+    // Called by RiscVSession on its event path. Load requests come through
+    // loadServed, with the value the host sent back, not eventDecoded.
+    void instructionSent(quint32 machineCode);
+    void commandSent(char command);
+    void loadServed(quint32 address, quint8 size, quint32 value);
+    void eventDecoded(const ProtocolDecoder::Event& event);
+
+private:
+    struct AddressEntry {
+        quint64 accesses = 0;
+        quint64 first = 0;
+        quint64 last = 0;
+        quint64 firstStore = 0;
+    };
+
+    struct IndexBuilder {
+        void clear();
+        void add(const CaptureRecord& record, quint64 offset);
+        bool write(const QString& fileName, quint64 dataSize, QString& errorMessage) const;
+
+        quint64 records = 0;
+        quint64 instructions = 0;
+        QByteArray checkpoints;
+        QHash<quint32, AddressEntry> addresses;
+    };
+
+    static const int FlushThreshold = 1 << 20;
+
+    void append(CaptureRecord::Kind kind, quint32 address, quint32 value, quint8 flags = 0);
+    void flush();
+
+    QFile file;
+    QByteArray buffer;
+    QElapsedTimer clock;
+    IndexBuilder index;
+    bool writeFailed;
+};
+
+class CaptureReader
+{
+public:
+    struct AddressSummary {
+        quint64 accesses = 0;
+        quint64 firstRecord = 0;
+        quint64 lastRecord = 0;
+        bool stored = false;
+        quint64 firstStoreRecord = 0;
+    };
+
+    CaptureReader();
+    ~CaptureReader();
+
+    // Maps the capture and its index; fails if the index is missing or was
+    // written for a different size of capture
+    bool open(const QString& fileName, QString& errorMessage);
+    void close();
+
+    quint64 recordCount() const { return records; }
+    quint64 instructionCount() const { return instructions; }
+    qint64 startMsSinceEpoch() const { return startMs; }
+    CaptureRecord record(quint64 index) const;
+
+    // Record of the instruction-th instruction sent (from 0), or recordCount()
+    quint64 findInstruction(quint64 instruction) const;
+    // First record at or after timeNs, or recordCount()
+    quint64 findTime(quint64 timeNs) const;
+    // False if the word at address was never loaded or stored
+    bool findAddress(quint32 address, AddressSummary& summary) const;
+
+private:
+    quint64 checkpointField(quint64 checkpoint, int field) const;
+    quint64 recordAt(quint64 offset) const { return (offset - CaptureWriter::HeaderSize) / CaptureWriter::RecordSize; }
+
+    QFile dataFile;
+    QFile indexFile;
+    const uchar *data;
+    const uchar *index;
+    quint64 records;
+    quint64 instructions;
+    quint64 checkpoints;
+    quint64 addresses;
+    qint64 startMs;
+};
+
+#endif // CAPTUREFILE_H
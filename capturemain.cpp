@@ -0,0 +1,133 @@
+// Capture inspector: opens a session capture through its index and prints
+// the records around an instruction number, a point in time or the accesses
+// to an address, without reading the rest of the file.
+//
+// Exit status: 0 found, 1 nothing at that point, 2 usage or file error.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QTextStream>
+#include "capturefile.h"
+#include "hostmemory.h"
+
+namespace {
+
+enum ExitStatus { Found = 0, NotFound = 1, UsageError = 2 };
+
+void printRecords(QTextStream& out, const CaptureReader& capture, quint64 first, int count)
+{
+    for (quint64 i = first; i < capture.recordCount() && i < first + quint64(count); i++) {
+        const CaptureRecord record = capture.record(i);
+        out << QString("#%1 %2 ms  %3\n").arg(i, 10).arg(record.timeNs / 1e6, 12, 'f', 3).arg(record.toString());
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("Risc-V-Testing-capture");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Seeks in an indexed session capture written with the runner's --capture.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "Capture file; its index is the same name plus .idx.", "<run.cap>");
+    QCommandLineOption instructionOption({"i", "instruction"}, "Show the records from this instruction (from 0).", "n");
+    QCommandLineOption timeOption("time", "Show the records from this many ms after the start.", "ms");
+    QCommandLineOption addressOption({"a", "address"},
+                                     "Show the first and last access, and the first store, to this word.", "address");
+    QCommandLineOption countOption({"n", "count"}, "Records to show at each point (default 10).", "count", "10");
+    QCommandLineOption reindexOption("reindex", "Rebuild the index from the records first.");
+    parser.addOptions({instructionOption, timeOption, addressOption, countOption, reindexOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (parser.positionalArguments().size() != 1) {
+        err << "One capture file is required.\n\n" << parser.helpText();
+        return UsageError;
+    }
+    const QString fileName = parser.positionalArguments().first();
+    bool countOk;
+    const int count = parser.value(countOption).toInt(&countOk);
+    if (!countOk || count <= 0) {
+        err << "Count must be a positive integer.\n";
+        return UsageError;
+    }
+
+    QString errorMessage;
+    if (parser.isSet(reindexOption) && !CaptureWriter::rebuildIndex(fileName, errorMessage)) {
+        err << errorMessage << "\n";
+        return UsageError;
+    }
+    CaptureReader capture;
+    if (!capture.open(fileName, errorMessage)) {
+        err << errorMessage << "\n";
+        return UsageError;
+    }
+
+    const quint64 lastTime = capture.recordCount() ? capture.record(capture.recordCount() - 1).timeNs : 0;
+    out << QString("%1: %2 records, %3 instructions over %4 s, started %5\n")
+               .arg(fileName).arg(capture.recordCount()).arg(capture.instructionCount())
+               .arg(lastTime / 1e9, 0, 'f', 3)
+               .arg(QDateTime::fromMSecsSinceEpoch(capture.startMsSinceEpoch()).toString(Qt::ISODate));
+
+    int status = Found;
+    if (parser.isSet(instructionOption)) {
+        bool ok;
+        const quint64 instruction = parser.value(instructionOption).toULongLong(&ok);
+        if (!ok) {
+            err << "Instruction must be a non-negative integer.\n";
+            return UsageError;
+        }
+        const quint64 record = capture.findInstruction(instruction);
+        if (record == capture.recordCount()) {
+            out << QString("Instruction %1 is past the end\n").arg(instruction);
+            status = NotFound;
+        } else {
+            out << QString("\nInstruction %1:\n").arg(instruction);
+            printRecords(out, capture, record, count);
+        }
+    }
+    if (parser.isSet(timeOption)) {
+        bool ok;
+        const double ms = parser.value(timeOption).toDouble(&ok);
+        if (!ok || ms < 0) {
+            err << "Time must be a non-negative number of ms.\n";
+            return UsageError;
+        }
+        const quint64 record = capture.findTime(quint64(ms * 1e6));
+        if (record == capture.recordCount()) {
+            out << QString("Nothing at or after %1 ms\n").arg(ms);
+            status = NotFound;
+        } else {
+            out << QString("\nAt %1 ms:\n").arg(ms);
+            printRecords(out, capture, record, count);
+        }
+    }
+    if (parser.isSet(addressOption)) {
+        quint32 address;
+        if (!HostMemory::parseAddress(parser.value(addressOption), address)) {
+            err << "Address must be a number, 0x for hex.\n";
+            return UsageError;
+        }
+        CaptureReader::AddressSummary summary;
+        if (!capture.findAddress(address, summary)) {
+            out << QString("No access to 0x%1\n").arg(address & ~3u, 8, 16, QChar('0'));
+            status = NotFound;
+        } else {
+            out << QString("\n0x%1: %2 accesses\n").arg(address & ~3u, 8, 16, QChar('0')).arg(summary.accesses);
+            out << "First access:\n";
+            printRecords(out, capture, summary.firstRecord, count);
+            if (summary.stored) {
+                out << "First store:\n";
+                printRecords(out, capture, summary.firstStoreRecord, count);
+            }
+            out << "Last access:\n";
+            printRecords(out, capture, summary.lastRecord, count);
+        }
+    }
+    return status;
+}
@@ -0,0 +1,143 @@
+#include "coveragepanel.h"
+#include "ui_coveragepanel.h"
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QHeaderView>
+
+CoveragePanel::CoveragePanel(InstructionCoverage *coverage, QWidget *parent)
+    : QMainWindow(parent)
+    , ui(new Ui::CoveragePanel)
+    , coverage(coverage)
+{
+    ui->setupUi(this);
+    setupTables();
+
+    connect(ui->exportButton, &QPushButton::clicked, this, &CoveragePanel::exportCoverage);
+    connect(ui->mergeButton, &QPushButton::clicked, this, &CoveragePanel::mergeCoverage);
+    connect(ui->resetButton, &QPushButton::clicked, this, &CoveragePanel::resetCoverage);
+
+    // Coverage is updated on the send path; the panel only polls it
+    connect(&refreshTimer, &QTimer::timeout, this, &CoveragePanel::refresh);
+    refreshTimer.start(500);
+    refresh();
+}
+
+CoveragePanel::~CoveragePanel()
+{
+    delete ui;
+}
+
+void CoveragePanel::setupTables()
+{
+    const QVector<InstructionCoverage::InstructionKind>& kinds = InstructionCoverage::instructionKinds();
+
+    ui->instructionTable->setColumnCount(3);
+    ui->instructionTable->setHorizontalHeaderLabels({"Instruction", "Format", "Hits"});
+    ui->instructionTable->setRowCount(kinds.size());
+    for (int row = 0; row < kinds.size(); row++) {
+        ui->instructionTable->setItem(row, 0, new QTableWidgetItem(kinds[row].name));
+        ui->instructionTable->setItem(row, 1, new QTableWidgetItem(InstructionCoverage::formatName(kinds[row].format)));
+        ui->instructionTable->setItem(row, 2, new QTableWidgetItem("0"));
+    }
+    ui->instructionTable->horizontalHeader()->setStretchLastSection(true);
+
+    // Immediate edge cases per format that has an immediate
+    QStringList classNames;
+    for (int immClass = 0; immClass < InstructionCoverage::ImmClassCount; immClass++) {
+        classNames << InstructionCoverage::immediateClassName(InstructionCoverage::ImmediateClass(immClass));
+    }
+    ui->immediateTable->setColumnCount(InstructionCoverage::ImmClassCount);
+    ui->immediateTable->setHorizontalHeaderLabels(classNames);
+    ui->immediateTable->setRowCount(InstructionCoverage::FormatCount - 1);
+    QStringList formatNames;
+    for (int format = InstructionCoverage::FormatI; format < InstructionCoverage::FormatCount; format++) {
+        formatNames << InstructionCoverage::formatName(InstructionCoverage::Format(format));
+        for (int immClass = 0; immClass < InstructionCoverage::ImmClassCount; immClass++) {
+            ui->immediateTable->setItem(format - 1, immClass, new QTableWidgetItem());
+        }
+    }
+    ui->immediateTable->setVerticalHeaderLabels(formatNames);
+}
+
+void CoveragePanel::refresh()
+{
+    if (!isVisible()) {
+        return;
+    }
+
+    const QColor coveredColor("#d4edda");
+    const QColor missingColor("#f8d7da");
+
+    const QVector<InstructionCoverage::InstructionKind>& kinds = InstructionCoverage::instructionKinds();
+    int coveredKinds = 0;
+    for (int row = 0; row < kinds.size(); row++) {
+        quint64 hits = coverage->hits(kinds[row]);
+        if (hits > 0) {
+            coveredKinds++;
+        }
+        QTableWidgetItem *item = ui->instructionTable->item(row, 2);
+        item->setText(QString::number(hits));
+        for (int column = 0; column < 3; column++) {
+            ui->instructionTable->item(row, column)->setBackground(hits > 0 ? coveredColor : missingColor);
+        }
+    }
+
+    for (int format = InstructionCoverage::FormatI; format < InstructionCoverage::FormatCount; format++) {
+        for (int immClass = 0; immClass < InstructionCoverage::ImmClassCount; immClass++) {
+            bool covered = coverage->hasImmediateClass(InstructionCoverage::Format(format),
+                                                       InstructionCoverage::ImmediateClass(immClass));
+            QTableWidgetItem *item = ui->immediateTable->item(format - 1, immClass);
+            item->setText(covered ? "yes" : "");
+            item->setBackground(covered ? coveredColor : missingColor);
+        }
+    }
+
+    ui->summaryLabel->setText(
+        QString("Instructions sent: %1 | Kinds: %2/%3 | Encodings: %4")
+            .arg(coverage->totalInstructions())
+            .arg(coveredKinds)
+            .arg(kinds.size())
+            .arg(coverage->encodingCount()));
+    ui->registerLabel->setText(
+        QString("rd: %1/32 | rs1: %2/32 | rs2: %3/32 | rs1,rs2 pairs: %4/1024 | rd,rs1 pairs: %5/1024 | shift amounts: %6/32")
+            .arg(coverage->destinationCount())
+            .arg(coverage->source1Count())
+            .arg(coverage->source2Count())
+            .arg(coverage->sourcePairCount())
+            .arg(coverage->destinationSourcePairCount())
+            .arg(coverage->shiftAmountCount()));
+}
+
+void CoveragePanel::exportCoverage()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+        "Export Coverage", "coverage.rvcov", "Coverage Files (*.rvcov);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QString errorMessage;
+    if (!coverage->exportToFile(fileName, errorMessage)) {
+        QMessageBox::warning(this, "Export Error", errorMessage);
+    }
+}
+
+void CoveragePanel::mergeCoverage()
+{
+    QStringList fileNames = QFileDialog::getOpenFileNames(this,
+        "Merge Coverage Files", "", "Coverage Files (*.rvcov);;All Files (*)");
+
+    for (const QString& fileName : fileNames) {
+        QString errorMessage;
+        if (!coverage->importFile(fileName, errorMessage)) {
+            QMessageBox::warning(this, "Merge Error", QString("%1: %2").arg(fileName, errorMessage));
+        }
+    }
+    refresh();
+}
+
+void CoveragePanel::resetCoverage()
+{
+    coverage->reset();
+    refresh();
+}
@@ -0,0 +1,36 @@
+#ifndef COVERAGEPANEL_H
+#define COVERAGEPANEL_H
+
+#include <QMainWindow>
+#include <QTimer>
+#include "instructioncoverage.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+class CoveragePanel;
+}
+QT_END_NAMESPACE
+
+class CoveragePanel : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    explicit CoveragePanel(InstructionCoverage *coverage, QWidget *parent = nullptr);
+    ~CoveragePanel();
+
+private slots:
+    void refresh();
+    void exportCoverage();
+    void mergeCoverage();
+    void resetCoverage();
+
+private:
+    Ui::CoveragePanel *ui;
+    InstructionCoverage *coverage;
+    QTimer refreshTimer;
+
+    void setupTables();
+};
+
+#endif // COVERAGEPANEL_H
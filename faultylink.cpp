@@ -0,0 +1,226 @@
+#include "faultylink.h"
+#include <QStringList>
+#include <cstring>
+
+bool FaultyLink::parse(const QString& spec, Faults& faults, QString& errorMessage)
+{
+    faults = Faults();
+    for (const QString& item : spec.split(',', Qt::SkipEmptyParts)) {
+        const int equals = item.indexOf('=');
+        const QString key = item.left(equals).trimmed().toLower();
+        const QString value = item.mid(equals + 1).trimmed();
+        bool ok = false;
+        if (key == "drop" || key == "flip" || key == "dup") {
+            const double rate = value.toDouble(&ok);
+            ok = ok && rate >= 0 && rate <= 1;
+            (key == "drop" ? faults.dropRate : key == "flip" ? faults.flipRate : faults.duplicateRate) = rate;
+        } else if (key == "burst") {
+            // rate[:length]
+            const int colon = value.indexOf(':');
+            faults.burstRate = value.left(colon).toDouble(&ok);
+            ok = ok && faults.burstRate >= 0 && faults.burstRate <= 1;
+            if (ok && colon >= 0) {
+                faults.burstLength = value.mid(colon + 1).toInt(&ok);
+                ok = ok && faults.burstLength > 0;
+            }
+        } else if (key == "jitter") {
+            faults.jitterMs = value.toInt(&ok);
+            ok = ok && faults.jitterMs >= 0;
+        } else if (key == "dir") {
+            faults.receive = value == "rx" || value == "both";
+            faults.transmit = value == "tx" || value == "both";
+            ok = faults.receive || faults.transmit;
+        } else if (key == "seed") {
+            faults.seed = value.toULongLong(&ok);
+        }
+        if (!ok) {
+            errorMessage = QString("'%1': expected drop=, flip=, dup= (rates 0 to 1), burst=rate[:length], "
+                                   "jitter=ms, dir=rx|tx|both or seed=").arg(item);
+            return false;
+        }
+    }
+    return true;
+}
+
+QString FaultyLink::describe(const Faults& faults)
+{
+    return QString("drop=%1,flip=%2,dup=%3,burst=%4:%5,jitter=%6,dir=%7,seed=%8")
+        .arg(faults.dropRate).arg(faults.flipRate).arg(faults.duplicateRate)
+        .arg(faults.burstRate).arg(faults.burstLength).arg(faults.jitterMs)
+        .arg(faults.receive && faults.transmit ? "both" : faults.receive ? "rx" : "tx")
+        .arg(faults.seed);
+}
+
+FaultyLink::FaultyLink(QObject *parent)
+    : QIODevice(parent)
+    , inner(nullptr)
+    , inputPosition(0)
+{
+    setFaults(Faults());
+    releaseTimer.setSingleShot(true);
+    connect(&releaseTimer, &QTimer::timeout, this, &FaultyLink::releaseHeld);
+    clock.start();
+}
+
+void FaultyLink::setDevice(QIODevice *device)
+{
+    if (inner) {
+        disconnect(inner, nullptr, this, nullptr);
+    }
+    inner = device;
+    if (inner) {
+        connect(inner, &QIODevice::readyRead, this, &FaultyLink::readInner);
+    }
+}
+
+void FaultyLink::setFaults(const Faults& faults)
+{
+    settings = faults;
+    injected = Counts();
+    state = faults.seed;
+    dropThreshold = threshold(faults.dropRate);
+    flipThreshold = threshold(faults.flipRate);
+    duplicateThreshold = threshold(faults.duplicateRate);
+    burstThreshold = threshold(faults.burstRate);
+    receiveBurst = 0;
+    transmitBurst = 0;
+}
+
+quint32 FaultyLink::threshold(double rate)
+{
+    return rate >= 1 ? 0xFFFFFFFFu : rate <= 0 ? 0 : quint32(rate * 4294967296.0);
+}
+
+quint64 FaultyLink::random()
+{
+    // splitmix64, as in InstructionGenerator
+    quint64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+QByteArray FaultyLink::corrupt(const char *data, qint64 size, int& burstRemaining)
+{
+    QByteArray out;
+    out.reserve(int(size));
+    for (qint64 i = 0; i < size; i++) {
+        char byte = data[i];
+        if (burstRemaining > 0) {
+            burstRemaining--;
+            injected.burstBytes++;
+            continue;
+        }
+        if (chance(burstThreshold)) {
+            injected.bursts++;
+            injected.burstBytes++;
+            burstRemaining = settings.burstLength - 1;
+            continue;
+        }
+        if (chance(dropThreshold)) {
+            injected.dropped++;
+            continue;
+        }
+        if (chance(flipThreshold)) {
+            byte = char(quint8(byte) ^ (1u << (random() >> 61)));
+            injected.flipped++;
+        }
+        out.append(byte);
+        if (chance(duplicateThreshold)) {
+            out.append(byte);
+            injected.duplicated++;
+        }
+    }
+    return out;
+}
+
+qint64 FaultyLink::bytesAvailable() const
+{
+    return input.size() - inputPosition + QIODevice::bytesAvailable();
+}
+
+void FaultyLink::close()
+{
+    releaseTimer.stop();
+    held.clear();
+    input.clear();
+    inputPosition = 0;
+    QIODevice::close();
+}
+
+qint64 FaultyLink::readData(char *data, qint64 maxSize)
+{
+    qint64 count = qMin(maxSize, qint64(input.size() - inputPosition));
+    std::memcpy(data, input.constData() + inputPosition, size_t(count));
+    inputPosition += int(count);
+    if (inputPosition == input.size()) {
+        input.clear();
+        inputPosition = 0;
+    }
+    return count;
+}
+
+qint64 FaultyLink::writeData(const char *data, qint64 maxSize)
+{
+    if (!inner) {
+        setErrorString("No device behind the fault injector");
+        return -1;
+    }
+    // Lost bytes are lost on the wire: the writer still sees them all written
+    const QByteArray bytes = settings.transmit ? corrupt(data, maxSize, transmitBurst) : QByteArray(data, int(maxSize));
+    if (!bytes.isEmpty() && inner->write(bytes) != bytes.size()) {
+        setErrorString(inner->errorString());
+        return -1;
+    }
+    emit bytesWritten(maxSize);
+    return maxSize;
+}
+
+void FaultyLink::readInner()
+{
+    if (!inner || !isOpen()) {
+        return;
+    }
+    const QByteArray received = inner->readAll();
+    const QByteArray bytes = settings.receive ? corrupt(received.constData(), received.size(), receiveBurst) : received;
+    if (!bytes.isEmpty()) {
+        deliver(bytes);
+    }
+}
+
+void FaultyLink::deliver(const QByteArray& bytes)
+{
+    if (settings.jitterMs <= 0 || !settings.receive) {
+        input.append(bytes);
+        emit readyRead();
+        return;
+    }
+
+    // Never before anything received earlier: jitter reorders nothing
+    const qint64 now = clock.elapsed();
+    const qint64 delay = qint64(((random() >> 32) * quint64(settings.jitterMs + 1)) >> 32);
+    const qint64 due = qMax(now + delay, held.isEmpty() ? now : held.last().dueMs);
+    if (due > now) {
+        injected.delayed++;
+    }
+    held.enqueue({due, bytes});
+    if (!releaseTimer.isActive()) {
+        releaseTimer.start(int(held.head().dueMs - now));
+    }
+}
+
+void FaultyLink::releaseHeld()
+{
+    const qint64 now = clock.elapsed();
+    bool released = false;
+    while (!held.isEmpty() && held.head().dueMs <= now) {
+        input.append(held.dequeue().bytes);
+        released = true;
+    }
+    if (!held.isEmpty()) {
+        releaseTimer.start(int(held.head().dueMs - now));
+    }
+    if (released && isOpen()) {
+        emit readyRead();
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef FAULTYLINK_H
+#define FAULTYLINK_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Fault-injection shim between a session and its device: a QIODevice that
+// passes bytes through to another one and, at the configured rates, drops,
+// flips or duplicates single bytes, loses bursts of them and delays what the
+// core sends back. The faults are drawn from a seeded generator, so the same
+// seed and the same traffic reproduce the same faults.
+class FaultyLink : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    struct Faults {
+        double dropRate = 0;        // per byte
+        double flipRate = 0;        // per byte; one bit, chosen at random, is inverted
+        double duplicateRate = 0;   // per byte
+        double burstRate = 0;       // per byte: start of burstLength lost bytes
+        int burstLength = 16;
+        int jitterMs = 0;           // with receive: replies held back up to this long, in order
+        bool receive = true;        // faults on core -> host bytes
+        bool transmit = true;       // faults on host -> core bytes
+        quint64 seed = 1;
+    };
+
+    struct Counts {
+        quint64 dropped = 0;
+        quint64 flipped = 0;
+        quint64 duplicated = 0;
+        quint64 bursts = 0;
+        quint64 burstBytes = 0;
+        quint64 delayed = 0;        // received chunks held back by jitter
+    };
+
+    // "drop=1e-4,flip=1e-4,dup=1e-4,burst=1e-5:32,jitter=5,dir=rx,seed=7";
+    // every key is optional, dir is rx, tx or both (the default)
+    static bool parse(const QString& spec, Faults& faults, QString& errorMessage);
+    static QString describe(const Faults& faults);
+
+    explicit FaultyLink(QObject *parent = nullptr);
+
+    // The device is not owned; it must be open for reading and writing
+    void setDevice(QIODevice *device);
+    QIODevice *device() const { return inner; }
+
+    // Restarts the fault sequence from faults.seed
+    void setFaults(const Faults& faults);
+    const Faults& faults() const { return settings; }
+    const Counts& counts() const { return injected; }
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    void close() override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void readInner();
+    void releaseHeld();
+
+private:
+    struct Held {
+        qint64 dueMs;
+        QByteArray bytes;
+    };
+
+    QByteArray corrupt(const char *data, qint64 size, int& burstRemaining);
+    void deliver(const QByteArray& bytes);
+    quint64 random();
+    bool chance(quint32 threshold) { return threshold && (random() >> 32) < threshold; }
+    static quint32 threshold(double rate);
+
+    QIODevice *inner;
+    Faults settings;
+    Counts injected;
+    quint64 state;
+    quint32 dropThreshold;
+    quint32 flipThreshold;
+    quint32 duplicateThreshold;
+    quint32 burstThreshold;
+    int receiveBurst;               // bytes still to lose in each direction's burst
+    int transmitBurst;
+
+    QByteArray input;
+    int inputPosition;
+    QQueue<Held> held;
+    QTimer releaseTimer;
+    QElapsedTimer clock;
+};
+
+#endif // FAULTYLINK_H
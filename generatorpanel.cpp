@@ -0,0 +1,115 @@
+#include "generatorpanel.h"
+#include "ui_generatorpanel.h"
+#include <QMessageBox>
+#include <QRegularExpression>
+
+GeneratorPanel::GeneratorPanel(QWidget *parent)
+    : QMainWindow(parent)
+    , ui(new Ui::GeneratorPanel)
+{
+    ui->setupUi(this);
+
+    connect(ui->startButton, &QPushButton::clicked, this, &GeneratorPanel::start);
+    connect(ui->stopButton, &QPushButton::clicked, this, &GeneratorPanel::stopRequested);
+
+    setStreaming(false);
+}
+
+GeneratorPanel::~GeneratorPanel()
+{
+    delete ui;
+}
+
+void GeneratorPanel::setStreaming(bool active)
+{
+    ui->startButton->setEnabled(!active);
+    ui->stopButton->setEnabled(active);
+    ui->settingsGroupBox->setEnabled(!active);
+}
+
+void GeneratorPanel::setProgress(quint64 sent, double instructionsPerSecond)
+{
+    ui->progressLabel->setText(QString("Sent: %1 instructions (%2 instr/s)")
+                                   .arg(sent)
+                                   .arg(instructionsPerSecond, 0, 'f', 0));
+}
+
+bool GeneratorPanel::parseRegisterPool(const QString& text, quint32& pool, QString& errorMessage)
+{
+    // Comma separated registers or ranges, e.g. "x1-x15, x20"
+    static const QRegularExpression rangePattern(R"(^x(\d+)(?:\s*-\s*x?(\d+))?$)");
+
+    pool = 0;
+    const QStringList parts = text.split(',', Qt::SkipEmptyParts);
+    for (const QString& part : parts) {
+        QRegularExpressionMatch match = rangePattern.match(part.trimmed().toLower());
+        if (!match.hasMatch()) {
+            errorMessage = QString("Invalid register range: '%1'").arg(part.trimmed());
+            return false;
+        }
+
+        int first = match.captured(1).toInt();
+        int last = match.captured(2).isEmpty() ? first : match.captured(2).toInt();
+        if (first > 31 || last > 31 || first > last) {
+            errorMessage = QString("Invalid register range: '%1'").arg(part.trimmed());
+            return false;
+        }
+        for (int reg = first; reg <= last; reg++) {
+            pool |= 1u << reg;
+        }
+    }
+
+    if (pool == 0) {
+        errorMessage = "Register pool is empty";
+        return false;
+    }
+    return true;
+}
+
+bool GeneratorPanel::parseAddress(const QString& text, quint32& value)
+{
+    bool ok;
+    QString clean = text.trimmed().toLower();
+    if (clean.startsWith("0x")) {
+        value = clean.mid(2).toUInt(&ok, 16);
+    } else {
+        value = clean.toUInt(&ok, 10);
+    }
+    return ok;
+}
+
+void GeneratorPanel::start()
+{
+    InstructionGenerator::Constraints constraints;
+    QString errorMessage;
+
+    if (!parseRegisterPool(ui->registerPoolLineEdit->text(), constraints.registerPool, errorMessage)) {
+        QMessageBox::warning(this, "Generator Error", errorMessage);
+        return;
+    }
+
+    if (!parseAddress(ui->windowBaseLineEdit->text(), constraints.windowBase)
+        || !parseAddress(ui->windowSizeLineEdit->text(), constraints.windowSize)
+        || constraints.windowSize < 4) {
+        QMessageBox::warning(this, "Generator Error", "Invalid memory window");
+        return;
+    }
+
+    bool ok;
+    quint64 seed = ui->seedLineEdit->text().trimmed().toULongLong(&ok, 0);
+    if (!ok) {
+        QMessageBox::warning(this, "Generator Error", "Seed must be an unsigned integer");
+        return;
+    }
+
+    constraints.baseRegister = ui->baseRegisterSpinBox->value();
+    constraints.edgeImmediateRate = ui->edgeRateSpinBox->value();
+    constraints.coverageBias = ui->biasSpinBox->value();
+    constraints.allowLoads = ui->loadsCheckBox->isChecked();
+    constraints.allowStores = ui->storesCheckBox->isChecked();
+    constraints.allowBranches = ui->branchesCheckBox->isChecked();
+    constraints.allowJumps = ui->jumpsCheckBox->isChecked();
+    constraints.allowSystem = ui->systemCheckBox->isChecked();
+
+    emit startRequested(constraints, seed, quint64(ui->countSpinBox->value()));
+}
@@ -0,0 +1,38 @@
+#ifndef GENERATORPANEL_H
+#define GENERATORPANEL_H
+
+#include <QMainWindow>
+#include "instructiongenerator.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+class GeneratorPanel;
+}
+QT_END_NAMESPACE
+
+class GeneratorPanel : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    explicit GeneratorPanel(QWidget *parent = nullptr);
+    ~GeneratorPanel();
+
+    void setStreaming(bool active);
+    void setProgress(quint64 sent, double instructionsPerSecond);
+
+signals:
+    void startRequested(const InstructionGenerator::Constraints& constraints, quint64 seed, quint64 count);
+    void stopRequested();
+
+private slots:
+    void start();
+
+private:
+    Ui::GeneratorPanel *ui;
+
+    static bool parseRegisterPool(const QString& text, quint32& pool, QString& errorMessage);
+    static bool parseAddress(const QString& text, quint32& value);
+};
+
+#endif // GENERATORPANEL_H
@@ -0,0 +1,226 @@
+#include "hostmemory.h"
+#include "tracing.h"
+#include <QFile>
+#include <QTextStream>
+#include <cstring>
+
+HostMemory::HostMemory()
+    : pageCount(0)
+    , anyWritten(false)
+    , highestWritten(0)
+    , writes(0)
+{
+}
+
+HostMemory::~HostMemory()
+{
+}
+
+void HostMemory::clear()
+{
+    for (auto& table : directory) {
+        table.reset();
+    }
+    pageCount = 0;
+    anyWritten = false;
+    highestWritten = 0;
+    writes = 0;
+}
+
+HostMemory::Page *HostMemory::touchPage(quint32 pageIndex)
+{
+    // Tables and pages still shared with a snapshot are copied before the first write
+    std::shared_ptr<PageTable>& table = directory[pageIndex >> TableBits];
+    if (!table) {
+        table = std::make_shared<PageTable>();
+    } else if (table.use_count() > 1) {
+        table = std::make_shared<PageTable>(*table);
+    }
+
+    std::shared_ptr<Page>& page = table->pages[pageIndex & ((1 << TableBits) - 1)];
+    if (!page) {
+        page = std::make_shared<Page>();
+        std::memset(page->words, 0, sizeof(page->words));
+        page->digest = 0;
+        pageCount++;
+    } else if (page.use_count() > 1) {
+        page = std::make_shared<Page>(*page);
+    }
+    return page.get();
+}
+
+void HostMemory::writeWords(quint32 address, const quint32 *values, quint32 count)
+{
+    address &= ~quint32(3);
+    while (count > 0) {
+        const int first = (address >> 2) & (PageWords - 1);
+        const quint32 chunk = qMin(count, quint32(PageWords - first));
+        Page *page = touchPage(address >> PageBits);
+        for (quint32 i = 0; i < chunk; i++) {
+            setWord(page, first + int(i), values[i]);
+        }
+
+        const quint32 last = address + (chunk - 1) * 4;
+        if (!anyWritten || last > highestWritten) {
+            highestWritten = last;
+            anyWritten = true;
+        }
+        writes += chunk;
+        values += chunk;
+        count -= chunk;
+        address = last + 4;
+    }
+}
+
+const quint32 *HostMemory::pageData(quint32 pageIndex) const
+{
+    const Page *page = findPage(pageIndex);
+    return page ? page->words : nullptr;
+}
+
+void HostMemory::writePage(quint32 pageIndex, const quint32 *words)
+{
+    Page *page = touchPage(pageIndex);
+    std::memcpy(page->words, words, sizeof(page->words));
+    page->digest = 0;
+    for (int i = 0; i < PageWords; i++) {
+        page->digest += wordDigest(i, words[i]);
+    }
+
+    for (int i = PageWords - 1; i >= 0; i--) {
+        if (words[i] != 0) {
+            quint32 address = (pageIndex << PageBits) | quint32(i * 4);
+            if (!anyWritten || address > highestWritten) {
+                highestWritten = address;
+                anyWritten = true;
+            }
+            break;
+        }
+    }
+}
+
+void HostMemory::releasePage(quint32 pageIndex)
+{
+    std::shared_ptr<PageTable>& table = directory[pageIndex >> TableBits];
+    if (!table) {
+        return;
+    }
+    std::shared_ptr<Page>& page = table->pages[pageIndex & ((1 << TableBits) - 1)];
+    if (!page) {
+        return;
+    }
+    if (table.use_count() > 1) {
+        table = std::make_shared<PageTable>(*table);
+    }
+    table->pages[pageIndex & ((1 << TableBits) - 1)].reset();
+    pageCount--;
+}
+
+bool HostMemory::highestNonZeroWord(quint32& address) const
+{
+    for (int top = int(directory.size()) - 1; top >= 0; top--) {
+        const PageTable *table = directory[top].get();
+        if (!table) {
+            continue;
+        }
+        for (int low = int(table->pages.size()) - 1; low >= 0; low--) {
+            const Page *page = table->pages[low].get();
+            if (!page) {
+                continue;
+            }
+            for (int i = PageWords - 1; i >= 0; i--) {
+                if (page->words[i] != 0) {
+                    address = (((quint32(top) << TableBits) | quint32(low)) << PageBits) | quint32(i * 4);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void HostMemory::restoreRange(const HostMemory& from, quint32 address, int wordCount)
+{
+    address &= ~quint32(3);
+    const quint32 last = address + quint32(qMax(wordCount - 1, 0)) * 4;
+
+    for (int i = 0; i < wordCount; i++) {
+        const quint32 wordAddress = address + quint32(i) * 4;
+        const quint32 pageIndex = wordAddress >> PageBits;
+        if (from.isPageTouched(pageIndex) || isPageTouched(pageIndex)) {
+            setWord(touchPage(pageIndex), (wordAddress >> 2) & (PageWords - 1), from.readWord(wordAddress));
+        }
+    }
+
+    for (quint32 pageIndex = address >> PageBits; ; pageIndex++) {
+        const Page *page = findPage(pageIndex);
+        if (page && !from.isPageTouched(pageIndex)) {
+            bool empty = true;
+            for (int i = 0; i < PageWords && empty; i++) {
+                empty = page->words[i] == 0;
+            }
+            if (empty) {
+                releasePage(pageIndex);
+            }
+        }
+        if (pageIndex == last >> PageBits) {
+            break;
+        }
+    }
+
+    // Only writes inside the range can have moved the watermark there
+    if (anyWritten && highestWritten >= address && highestWritten <= last) {
+        quint32 highest;
+        anyWritten = from.anyWritten;
+        highestWritten = from.highestWritten;
+        if (highestNonZeroWord(highest) && (!anyWritten || highest > highestWritten)) {
+            highestWritten = highest;
+            anyWritten = true;
+        }
+    }
+}
+
+QVector<quint32> HostMemory::touchedPages() const
+{
+    QVector<quint32> pages;
+    pages.reserve(pageCount);
+    for (quint32 top = 0; top < directory.size(); top++) {
+        const PageTable *table = directory[top].get();
+        if (!table) {
+            continue;
+        }
+        for (quint32 low = 0; low < table->pages.size(); low++) {
+            if (table->pages[low]) {
+                pages.append((top << TableBits) | low);
+            }
+        }
+    }
+    return pages;
+}
+
+bool HostMemory::exportCsv(const QString& fileName, QString& errorMessage) const
+{
+    TRACE_ZONE("memory.exportCsv");
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        errorMessage = QString("Failed to create CSV file: %1").arg(file.errorString());
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "DataValue\n";
+    if (anyWritten) {
+        for (quint64 address = 0; address <= highestWritten; address += 4) {
+            out << QString("0x%1").arg(readWord(quint32(address)), 8, 16, QChar('0')) << "\n";
+        }
+    }
+    out.flush();
+    return true;
+}
+
+bool HostMemory::parseAddress(const QString& text, quint32& address)
+{
+    bool ok;
+    address = text.startsWith("0x", Qt::CaseInsensitive) ? text.mid(2).toUInt(&ok, 16) : text.toUInt(&ok, 10);
+    return ok;
+}
@@ -0,0 +1,128 @@
+#ifndef HOSTMEMORY_H
+#define HOSTMEMORY_H
+
+#include <QString>
+#include <QVector>
+#include <array>
+#include <memory>
+
+// Word-addressed memory served to the core over UART. The 32-bit address
+// space is split into 4 KiB pages held in a two-level table; only pages
+// that have been written are allocated, and reads of untouched memory
+// return zero without allocating anything.
+//
+// Copies are copy-on-write: copying shares every table and page, and a
+// write copies only the page (and table) it lands in. Taking a snapshot of
+// a large memory therefore costs a few thousand pointer copies, and the
+// original keeps serving loads and stores at full speed.
+//
+// Every page also keeps a digest of its contents, updated on each write,
+// so two images can be compared page by page without reading the words.
+class HostMemory
+{
+public:
+    static const int PageBits = 12;
+    static const quint32 PageSize = 1u << PageBits;
+    static const int PageWords = PageSize / 4;
+    static const int TableBits = 10;
+
+    HostMemory();
+    ~HostMemory();
+
+    // Addresses are byte addresses; the low two bits are ignored
+    quint32 readWord(quint32 address) const
+    {
+        const Page *page = findPage(address >> PageBits);
+        return page ? page->words[(address >> 2) & (PageWords - 1)] : 0;
+    }
+
+    void writeWord(quint32 address, quint32 value)
+    {
+        Page *page = touchPage(address >> PageBits);
+        setWord(page, (address >> 2) & (PageWords - 1), value);
+        writes++;
+        if (!anyWritten || address > highestWritten) {
+            highestWritten = address & ~quint32(3);
+            anyWritten = true;
+        }
+    }
+
+    // Bulk fill, a page at a time; the range must not wrap past 0xFFFFFFFC
+    void writeWords(quint32 address, const quint32 *values, quint32 count);
+
+    void clear();
+
+    // Cheap copy-on-write copy of the current contents
+    HostMemory snapshot() const { return *this; }
+
+    // Page-level access for exporters and viewers; pageIndex is address >> PageBits
+    bool isPageTouched(quint32 pageIndex) const { return findPage(pageIndex) != nullptr; }
+    const quint32 *pageData(quint32 pageIndex) const;
+    void writePage(quint32 pageIndex, const quint32 *words);
+
+    // Puts wordCount words from address back to what they are in `from`
+    // (usually an earlier snapshot), dropping pages that only exist because
+    // of writes in the range, so borrowed scratch space leaves no trace
+    void restoreRange(const HostMemory& from, quint32 address, int wordCount);
+    QVector<quint32> touchedPages() const;
+    int touchedPageCount() const { return pageCount; }
+
+    bool hasWrites() const { return anyWritten; }
+    quint32 highestWrittenAddress() const { return highestWritten; }
+    quint64 writeCount() const { return writes; }
+
+    // memory_map.csv layout: a "DataValue" header, then one hex word per row (row = address / 4)
+    bool exportCsv(const QString& fileName, QString& errorMessage) const;
+
+    // Address as written in specs and on command lines: 0x-prefixed hex or decimal
+    static bool parseAddress(const QString& text, quint32& address);
+
+private:
+    friend struct MemoryComparison;
+
+    struct Page {
+        quint32 words[PageWords];
+        quint64 digest;     // sum of wordDigest() over the words; 0 when all zero
+    };
+    struct PageTable {
+        std::array<std::shared_ptr<Page>, 1 << TableBits> pages;
+    };
+
+    const Page *findPage(quint32 pageIndex) const
+    {
+        const PageTable *table = directory[pageIndex >> TableBits].get();
+        return table ? table->pages[pageIndex & ((1 << TableBits) - 1)].get() : nullptr;
+    }
+    Page *touchPage(quint32 pageIndex);
+
+    // Position-dependent hash of one word, summed so a write only swaps its own
+    // term; zero words contribute nothing, matching untouched pages
+    static quint64 wordDigest(int index, quint32 value)
+    {
+        if (value == 0) {
+            return 0;
+        }
+        quint64 x = (quint64(index) << 32) | value;
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x;
+    }
+    static void setWord(Page *page, int index, quint32 value)
+    {
+        page->digest += wordDigest(index, value) - wordDigest(index, page->words[index]);
+        page->words[index] = value;
+    }
+    void releasePage(quint32 pageIndex);
+    bool highestNonZeroWord(quint32& address) const;
+
+    std::array<std::shared_ptr<PageTable>, 1 << (32 - PageBits - TableBits)> directory;
+    int pageCount;
+    bool anyWritten;
+    quint32 highestWritten;
+    quint64 writes;
+};
+
+#endif // HOSTMEMORY_H
@@ -0,0 +1,252 @@
+#include "instructioncoverage.h"
+#include <QFile>
+#include <QDataStream>
+#include <QtAlgorithms>
+
+namespace {
+
+const quint32 CoverageFileMagic = 0x56435652; // "RVCV"
+const quint32 CoverageFileVersion = 1;
+
+template <size_t N>
+void writeArray(QDataStream& out, const std::array<quint64, N>& values)
+{
+    for (quint64 value : values) {
+        out << value;
+    }
+}
+
+template <size_t N>
+void readArray(QDataStream& in, std::array<quint64, N>& values)
+{
+    for (quint64& value : values) {
+        in >> value;
+    }
+}
+
+template <size_t N>
+int countBits(const std::array<quint64, N>& values)
+{
+    int count = 0;
+    for (quint64 value : values) {
+        count += qPopulationCount(value);
+    }
+    return count;
+}
+
+}
+
+// Instruction format by opcode[6:0]; anything not listed is not RV32I
+const quint8 InstructionCoverage::formatTable[128] = {
+    /* 0x00 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatI, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x08 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatI,
+    /* 0x10 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatI, FormatInvalid, FormatInvalid, FormatInvalid, FormatU,
+    /* 0x18 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x20 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatS, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x28 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x30 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatR, FormatInvalid, FormatInvalid, FormatInvalid, FormatU,
+    /* 0x38 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x40 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x48 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x50 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x58 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x60 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatB, FormatInvalid, FormatInvalid, FormatInvalid, FormatI,
+    /* 0x68 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatJ,
+    /* 0x70 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatI, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+    /* 0x78 */ FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid, FormatInvalid,
+};
+
+InstructionCoverage::InstructionCoverage()
+{
+    reset();
+}
+
+void InstructionCoverage::reset()
+{
+    total = 0;
+    opcodeBits.fill(0);
+    opcodeFunct3Bits.fill(0);
+    encodingBits.fill(0);
+    rdBits = 0;
+    rs1Bits = 0;
+    rs2Bits = 0;
+    sourcePairBits.fill(0);
+    destinationPairBits.fill(0);
+    shiftAmountBits = 0;
+    immediateBits = 0;
+    counters.fill(0);
+}
+
+void InstructionCoverage::merge(const InstructionCoverage& other)
+{
+    total += other.total;
+    for (size_t i = 0; i < opcodeBits.size(); i++) opcodeBits[i] |= other.opcodeBits[i];
+    for (size_t i = 0; i < opcodeFunct3Bits.size(); i++) opcodeFunct3Bits[i] |= other.opcodeFunct3Bits[i];
+    for (size_t i = 0; i < encodingBits.size(); i++) encodingBits[i] |= other.encodingBits[i];
+    rdBits |= other.rdBits;
+    rs1Bits |= other.rs1Bits;
+    rs2Bits |= other.rs2Bits;
+    for (size_t i = 0; i < sourcePairBits.size(); i++) sourcePairBits[i] |= other.sourcePairBits[i];
+    for (size_t i = 0; i < destinationPairBits.size(); i++) destinationPairBits[i] |= other.destinationPairBits[i];
+    shiftAmountBits |= other.shiftAmountBits;
+    immediateBits |= other.immediateBits;
+    for (size_t i = 0; i < counters.size(); i++) counters[i] += other.counters[i];
+}
+
+bool InstructionCoverage::exportToFile(const QString& fileName, QString& errorMessage) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = QString("Failed to create coverage file: %1").arg(file.errorString());
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << CoverageFileMagic << CoverageFileVersion << total;
+    writeArray(out, opcodeBits);
+    writeArray(out, opcodeFunct3Bits);
+    writeArray(out, encodingBits);
+    out << rdBits << rs1Bits << rs2Bits;
+    writeArray(out, sourcePairBits);
+    writeArray(out, destinationPairBits);
+    out << shiftAmountBits << immediateBits;
+    writeArray(out, counters);
+
+    if (out.status() != QDataStream::Ok) {
+        errorMessage = QString("Failed to write coverage file: %1").arg(file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool InstructionCoverage::importFile(const QString& fileName, QString& errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("Failed to open coverage file: %1").arg(file.errorString());
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != CoverageFileMagic || version != CoverageFileVersion) {
+        errorMessage = "Not a coverage file or unsupported version";
+        return false;
+    }
+
+    InstructionCoverage loaded;
+    in >> loaded.total;
+    readArray(in, loaded.opcodeBits);
+    readArray(in, loaded.opcodeFunct3Bits);
+    readArray(in, loaded.encodingBits);
+    in >> loaded.rdBits >> loaded.rs1Bits >> loaded.rs2Bits;
+    readArray(in, loaded.sourcePairBits);
+    readArray(in, loaded.destinationPairBits);
+    in >> loaded.shiftAmountBits >> loaded.immediateBits;
+    readArray(in, loaded.counters);
+
+    if (in.status() != QDataStream::Ok) {
+        errorMessage = "Coverage file is truncated";
+        return false;
+    }
+
+    merge(loaded);
+    return true;
+}
+
+const QVector<InstructionCoverage::InstructionKind>& InstructionCoverage::instructionKinds()
+{
+    static const QVector<InstructionKind> kinds = {
+        {"lui",    0x37, 0, -1, FormatU},
+        {"auipc",  0x17, 0, -1, FormatU},
+        {"jal",    0x6f, 0, -1, FormatJ},
+        {"jalr",   0x67, 0, -1, FormatI},
+        {"beq",    0x63, 0, -1, FormatB},
+        {"bne",    0x63, 1, -1, FormatB},
+        {"blt",    0x63, 4, -1, FormatB},
+        {"bge",    0x63, 5, -1, FormatB},
+        {"bltu",   0x63, 6, -1, FormatB},
+        {"bgeu",   0x63, 7, -1, FormatB},
+        {"lb",     0x03, 0, -1, FormatI},
+        {"lh",     0x03, 1, -1, FormatI},
+        {"lw",     0x03, 2, -1, FormatI},
+        {"lbu",    0x03, 4, -1, FormatI},
+        {"lhu",    0x03, 5, -1, FormatI},
+        {"sb",     0x23, 0, -1, FormatS},
+        {"sh",     0x23, 1, -1, FormatS},
+        {"sw",     0x23, 2, -1, FormatS},
+        {"addi",   0x13, 0, -1, FormatI},
+        {"slti",   0x13, 2, -1, FormatI},
+        {"sltiu",  0x13, 3, -1, FormatI},
+        {"xori",   0x13, 4, -1, FormatI},
+        {"ori",    0x13, 6, -1, FormatI},
+        {"andi",   0x13, 7, -1, FormatI},
+        {"slli",   0x13, 1, 0x00, FormatI},
+        {"srli",   0x13, 5, 0x00, FormatI},
+        {"srai",   0x13, 5, 0x20, FormatI},
+        {"add",    0x33, 0, 0x00, FormatR},
+        {"sub",    0x33, 0, 0x20, FormatR},
+        {"sll",    0x33, 1, 0x00, FormatR},
+        {"slt",    0x33, 2, 0x00, FormatR},
+        {"sltu",   0x33, 3, 0x00, FormatR},
+        {"xor",    0x33, 4, 0x00, FormatR},
+        {"srl",    0x33, 5, 0x00, FormatR},
+        {"sra",    0x33, 5, 0x20, FormatR},
+        {"or",     0x33, 6, 0x00, FormatR},
+        {"and",    0x33, 7, 0x00, FormatR},
+        {"fence",  0x0f, 0, -1, FormatI},
+        {"ecall/ebreak", 0x73, 0, -1, FormatI},
+        {"csrrw",  0x73, 1, -1, FormatI},
+        {"csrrs",  0x73, 2, -1, FormatI},
+        {"csrrc",  0x73, 3, -1, FormatI},
+        {"csrrwi", 0x73, 5, -1, FormatI},
+        {"csrrsi", 0x73, 6, -1, FormatI},
+        {"csrrci", 0x73, 7, -1, FormatI},
+    };
+    return kinds;
+}
+
+const char *InstructionCoverage::immediateClassName(ImmediateClass immClass)
+{
+    static const char *names[ImmClassCount] = {
+        "zero", "+1", "-1", "max", "min", "positive", "negative"
+    };
+    return immClass < ImmClassCount ? names[immClass] : "?";
+}
+
+const char *InstructionCoverage::formatName(Format format)
+{
+    static const char *names[FormatCount] = {"R", "I", "S", "B", "U", "J"};
+    return format < FormatCount ? names[format] : "?";
+}
+
+quint64 InstructionCoverage::hits(const InstructionKind& kind) const
+{
+    const quint32 key = (quint32(kind.opcode) << 3) | kind.funct3;
+
+    // U and J formats have no funct3: those bits belong to the immediate
+    if (kind.format == FormatU || kind.format == FormatJ) {
+        quint64 sum = 0;
+        for (quint32 funct3 = 0; funct3 < 8; funct3++) {
+            sum += counters[((quint32(kind.opcode) << 3) | funct3) << 1];
+        }
+        return sum;
+    }
+
+    const quint32 alternate = kind.funct7 >= 0 ? (quint32(kind.funct7) >> 5) & 1 : 0;
+    return counters[(key << 1) | alternate];
+}
+
+int InstructionCoverage::destinationCount() const { return qPopulationCount(rdBits); }
+int InstructionCoverage::source1Count() const { return qPopulationCount(rs1Bits); }
+int InstructionCoverage::source2Count() const { return qPopulationCount(rs2Bits); }
+int InstructionCoverage::sourcePairCount() const { return countBits(sourcePairBits); }
+int InstructionCoverage::destinationSourcePairCount() const { return countBits(destinationPairBits); }
+int InstructionCoverage::shiftAmountCount() const { return qPopulationCount(shiftAmountBits); }
+int InstructionCoverage::immediateClassCount() const { return qPopulationCount(immediateBits); }
+int InstructionCoverage::opcodeFunct3Count() const { return countBits(opcodeFunct3Bits); }
+int InstructionCoverage::encodingCount() const { return countBits(encodingBits); }
@@ -0,0 +1,192 @@
+#ifndef INSTRUCTIONCOVERAGE_H
+#define INSTRUCTIONCOVERAGE_H
+
+#include <QString>
+#include <QVector>
+#include <array>
+
+// Encoding-space coverage of the instruction words sent to the core.
+// Everything is stored in fixed-size bitmaps and counters so that record()
+// is a handful of shifts and ORs; coverage files from different runs or
+// boards are combined by OR-ing bitmaps and adding counters.
+class InstructionCoverage
+{
+public:
+    enum Format { FormatR, FormatI, FormatS, FormatB, FormatU, FormatJ, FormatCount, FormatInvalid = FormatCount };
+
+    enum ImmediateClass {
+        ImmZero, ImmOne, ImmMinusOne, ImmMax, ImmMin, ImmPositive, ImmNegative, ImmClassCount
+    };
+
+    struct InstructionKind {
+        const char *name;
+        quint8 opcode;
+        quint8 funct3;
+        qint8 funct7;   // -1 when the format has no funct7 field
+        Format format;
+    };
+
+    InstructionCoverage();
+
+    // Hot path: called for every transmitted instruction word
+    inline void record(quint32 word);
+
+    void reset();
+    void merge(const InstructionCoverage& other);
+
+    // Binary export; importing merges the file into the current coverage
+    bool exportToFile(const QString& fileName, QString& errorMessage) const;
+    bool importFile(const QString& fileName, QString& errorMessage);
+
+    // RV32I instructions the core understands, used for reporting
+    static const QVector<InstructionKind>& instructionKinds();
+    static Format formatOf(quint32 opcode) { return Format(formatTable[opcode & 0x7F]); }
+    static const char *immediateClassName(ImmediateClass immClass);
+    static const char *formatName(Format format);
+
+    quint64 totalInstructions() const { return total; }
+    quint64 hits(const InstructionKind& kind) const;
+    bool covers(const InstructionKind& kind) const { return hits(kind) > 0; }
+    bool hasDestination(int rd) const { return (rdBits >> rd) & 1; }
+    bool hasSource1(int rs1) const { return (rs1Bits >> rs1) & 1; }
+    bool hasSource2(int rs2) const { return (rs2Bits >> rs2) & 1; }
+    bool hasSourcePair(int rs1, int rs2) const { return testBit(sourcePairBits.data(), (rs1 << 5) | rs2); }
+    quint32 destinationMask() const { return rdBits; }
+    quint32 source1Mask() const { return rs1Bits; }
+    quint32 source2Mask() const { return rs2Bits; }
+    bool hasShiftAmount(int shamt) const { return (shiftAmountBits >> shamt) & 1; }
+    bool hasImmediateClass(Format format, ImmediateClass immClass) const
+    {
+        return (immediateBits >> (format * ImmClassCount + immClass)) & 1;
+    }
+
+    int destinationCount() const;
+    int source1Count() const;
+    int source2Count() const;
+    int sourcePairCount() const;
+    int destinationSourcePairCount() const;
+    int shiftAmountCount() const;
+    int immediateClassCount() const;
+    int opcodeFunct3Count() const;
+    int encodingCount() const;
+
+private:
+    static const quint8 formatTable[128];
+
+    static void setBit(quint64 *bits, quint32 index) { bits[index >> 6] |= quint64(1) << (index & 63); }
+    static bool testBit(const quint64 *bits, quint32 index) { return (bits[index >> 6] >> (index & 63)) & 1; }
+    static inline quint32 immediateClass(Format format, quint32 word);
+
+    quint64 total;
+    std::array<quint64, 2> opcodeBits;               // opcode[6:0]
+    std::array<quint64, 16> opcodeFunct3Bits;        // opcode, funct3
+    std::array<quint64, 2048> encodingBits;          // opcode, funct3, funct7
+    quint32 rdBits;
+    quint32 rs1Bits;
+    quint32 rs2Bits;
+    std::array<quint64, 16> sourcePairBits;          // rs1 x rs2
+    std::array<quint64, 16> destinationPairBits;     // rd x rs1
+    quint32 shiftAmountBits;                         // slli/srli/srai shamt
+    quint64 immediateBits;                           // format x immediate class
+    std::array<quint64, 2048> counters;              // opcode, funct3, funct7[5]
+};
+
+quint32 InstructionCoverage::immediateClass(Format format, quint32 word)
+{
+    qint32 imm;
+    qint32 step = 1;
+    qint32 maxValue;
+    switch (format) {
+    case FormatI:
+        imm = qint32(word) >> 20;
+        maxValue = 2047;
+        break;
+    case FormatS:
+        imm = ((qint32(word) >> 25) << 5) | ((word >> 7) & 0x1F);
+        maxValue = 2047;
+        break;
+    case FormatB:
+        imm = ((qint32(word) >> 31) << 12) | ((word & 0x80) << 4)
+              | ((word >> 20) & 0x7E0) | ((word >> 7) & 0x1E);
+        maxValue = 4094;
+        step = 2;
+        break;
+    case FormatU:
+        imm = qint32(word) >> 12;
+        maxValue = 0x7FFFF;
+        break;
+    case FormatJ:
+        imm = ((qint32(word) >> 31) << 20) | (word & 0xFF000)
+              | ((word >> 9) & 0x800) | ((word >> 20) & 0x7FE);
+        maxValue = 0xFFFFE;
+        step = 2;
+        break;
+    default:
+        return ImmClassCount;
+    }
+
+    const qint32 minValue = -maxValue - step;
+    if (imm == 0) return ImmZero;
+    if (imm == step) return ImmOne;
+    if (imm == -step) return ImmMinusOne;
+    if (imm == maxValue) return ImmMax;
+    if (imm == minValue) return ImmMin;
+    return imm > 0 ? ImmPositive : ImmNegative;
+}
+
+void InstructionCoverage::record(quint32 word)
+{
+    const quint32 opcode = word & 0x7F;
+    const quint32 funct3 = (word >> 12) & 0x7;
+    const quint32 rd = (word >> 7) & 0x1F;
+    const quint32 rs1 = (word >> 15) & 0x1F;
+    const quint32 rs2 = (word >> 20) & 0x1F;
+    const Format format = Format(formatTable[opcode]);
+
+    // Only R-type and the shift immediates carry a real funct7
+    const bool hasFunct7 = format == FormatR || (opcode == 0x13 && (funct3 & 0x3) == 0x1);
+    const quint32 funct7 = hasFunct7 ? (word >> 25) : 0;
+    const quint32 key = (opcode << 3) | funct3;
+
+    total++;
+    setBit(opcodeBits.data(), opcode);
+    setBit(opcodeFunct3Bits.data(), key);
+    setBit(encodingBits.data(), (key << 7) | funct7);
+    counters[(key << 1) | ((funct7 >> 5) & 1)]++;
+
+    switch (format) {
+    case FormatR:
+        rdBits |= 1u << rd;
+        rs1Bits |= 1u << rs1;
+        rs2Bits |= 1u << rs2;
+        setBit(sourcePairBits.data(), (rs1 << 5) | rs2);
+        setBit(destinationPairBits.data(), (rd << 5) | rs1);
+        return;
+    case FormatI:
+        rdBits |= 1u << rd;
+        rs1Bits |= 1u << rs1;
+        setBit(destinationPairBits.data(), (rd << 5) | rs1);
+        if (hasFunct7) {
+            // Shift amount lives in the rs2 field
+            shiftAmountBits |= 1u << rs2;
+            return;
+        }
+        break;
+    case FormatS:
+    case FormatB:
+        rs1Bits |= 1u << rs1;
+        rs2Bits |= 1u << rs2;
+        setBit(sourcePairBits.data(), (rs1 << 5) | rs2);
+        break;
+    case FormatU:
+    case FormatJ:
+        rdBits |= 1u << rd;
+        break;
+    default:
+        return;
+    }
+
+    immediateBits |= quint64(1) << (format * ImmClassCount + immediateClass(format, word));
+}
+
+#endif // INSTRUCTIONCOVERAGE_H
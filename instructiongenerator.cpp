@@ -0,0 +1,321 @@
+#include "instructiongenerator.h"
+#include <QtAlgorithms>
+#include <algorithm>
+
+InstructionGenerator::InstructionGenerator(const Constraints& constraints, quint64 seed,
+                                           const InstructionCoverage *coverage)
+    : limits(constraints)
+    , coverage(coverage)
+{
+    // Loads and stores need at least one aligned word inside the window
+    limits.baseRegister = qBound(1, limits.baseRegister, 31);
+    limits.windowBase &= ~quint32(3);
+    limits.windowSize = qMax(limits.windowSize & ~quint32(3), quint32(4));
+
+    destinationPool = limits.registerPool & ~(1u << limits.baseRegister);
+    if (destinationPool == 0) {
+        destinationPool = 1;  // only x0 left: writes are discarded
+    }
+    sourcePool = limits.registerPool | 1;
+
+    edgeThreshold = quint32(qBound(0.0, limits.edgeImmediateRate, 1.0) * 4294967295.0);
+    biasThreshold = coverage ? quint32(qBound(0.0, limits.coverageBias, 1.0) * 4294967295.0) : 0;
+
+    buildCandidates();
+    restart(seed);
+}
+
+void InstructionGenerator::restart(quint64 seed)
+{
+    state = seed;
+    count = 0;
+    pending.clear();
+    baseValue = limits.windowBase + (limits.windowSize > 2048 ? 2048 : 0);
+    queueBaseSetup();
+    refreshWeights();
+}
+
+quint64 InstructionGenerator::random()
+{
+    // splitmix64: one add and three multiply/xor-shift rounds per draw
+    quint64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void InstructionGenerator::buildCandidates()
+{
+    candidates.clear();
+    for (const InstructionCoverage::InstructionKind& kind : InstructionCoverage::instructionKinds()) {
+        Candidate candidate;
+        candidate.kind = kind;
+        candidate.memorySize = 0;
+        candidate.cumulativeWeight = 0;
+
+        switch (kind.opcode) {
+        case 0x03: // Loads
+            if (!limits.allowLoads) continue;
+            candidate.memorySize = 1 << (kind.funct3 & 0x3);
+            break;
+        case 0x23: // Stores
+            if (!limits.allowStores) continue;
+            candidate.memorySize = 1 << (kind.funct3 & 0x3);
+            break;
+        case 0x63: // Branches
+            if (!limits.allowBranches) continue;
+            break;
+        case 0x6f: // JAL
+        case 0x67: // JALR
+            if (!limits.allowJumps) continue;
+            break;
+        case 0x73: // SYSTEM
+        case 0x0f: // FENCE
+            if (!limits.allowSystem) continue;
+            break;
+        default:
+            break;
+        }
+        candidates.append(candidate);
+    }
+}
+
+void InstructionGenerator::refreshWeights()
+{
+    // Rarely hit instructions get proportionally more weight
+    double total = 0;
+    for (Candidate& candidate : candidates) {
+        double weight = 1.0;
+        if (coverage) {
+            weight += limits.coverageBias * 64.0 / (1.0 + double(coverage->hits(candidate.kind)));
+        }
+        total += weight;
+        candidate.cumulativeWeight = total;
+    }
+
+    // Large windows are covered by moving the base register between 4 KiB pages
+    if (count > 0 && limits.windowSize > 4096) {
+        // The last page may be partial: its base is pulled back so the offsets still reach the window's end
+        const quint32 page = uniform(quint32((quint64(limits.windowSize) + 4095) / 4096));
+        const quint64 tailBase = (quint64(limits.windowBase) + limits.windowSize - 2048) & ~quint64(3);
+        baseValue = quint32(qMin(quint64(limits.windowBase) + 4096 * quint64(page) + 2048, tailBase));
+        queueBaseSetup();
+    }
+}
+
+const InstructionGenerator::Candidate& InstructionGenerator::pickCandidate()
+{
+    const double total = candidates.last().cumulativeWeight;
+    const double target = double(random() >> 11) * (1.0 / 9007199254740992.0) * total;
+    auto it = std::upper_bound(candidates.cbegin(), candidates.cend(), target,
+                               [](double value, const Candidate& candidate) {
+                                   return value < candidate.cumulativeWeight;
+                               });
+    return it == candidates.cend() ? candidates.last() : *it;
+}
+
+int InstructionGenerator::pickRegister(quint32 pool, quint32 coveredMask)
+{
+    if (biasThreshold && chance(biasThreshold) && (pool & ~coveredMask)) {
+        pool &= ~coveredMask;
+    }
+
+    // Select the n-th set bit of the pool
+    quint32 n = uniform(quint32(qPopulationCount(pool)));
+    while (n--) {
+        pool &= pool - 1;
+    }
+    for (int reg = 0; reg < 32; reg++) {
+        if (pool & (1u << reg)) {
+            return reg;
+        }
+    }
+    return 0;
+}
+
+qint32 InstructionGenerator::pickImmediate(InstructionCoverage::Format format)
+{
+    qint32 maxValue = 2047;
+    qint32 step = 1;
+    switch (format) {
+    case InstructionCoverage::FormatB: maxValue = 4094;    step = 2; break;
+    case InstructionCoverage::FormatU: maxValue = 0x7FFFF; break;
+    case InstructionCoverage::FormatJ: maxValue = 0xFFFFE; step = 2; break;
+    default: break;
+    }
+    const qint32 minValue = -maxValue - step;
+
+    if (chance(edgeThreshold)) {
+        // Prefer edge classes this format has not produced yet
+        int edgeClass = int(uniform(InstructionCoverage::ImmPositive));
+        if (biasThreshold && chance(biasThreshold)) {
+            for (int i = 0; i < InstructionCoverage::ImmPositive; i++) {
+                int candidate = (edgeClass + i) % InstructionCoverage::ImmPositive;
+                if (!coverage->hasImmediateClass(format, InstructionCoverage::ImmediateClass(candidate))) {
+                    edgeClass = candidate;
+                    break;
+                }
+            }
+        }
+        switch (edgeClass) {
+        case InstructionCoverage::ImmZero:     return 0;
+        case InstructionCoverage::ImmOne:      return step;
+        case InstructionCoverage::ImmMinusOne: return -step;
+        case InstructionCoverage::ImmMax:      return maxValue;
+        default:                               return minValue;
+        }
+    }
+
+    return minValue + step * qint32(uniform(quint32((maxValue - minValue) / step + 1)));
+}
+
+qint32 InstructionGenerator::pickMemoryOffset(int size)
+{
+    // baseValue is 4-aligned, so an aligned offset gives an aligned address
+    const qint64 windowEnd = qint64(limits.windowBase) + limits.windowSize;
+    const qint32 low = qint32(qMax<qint64>(-2048, qint64(limits.windowBase) - baseValue));
+    qint32 high = qint32(qMin<qint64>(2047, windowEnd - size - baseValue));
+    high -= high % size;
+    if (high < low) {
+        return low;
+    }
+
+    if (chance(edgeThreshold)) {
+        switch (uniform(3)) {
+        case 0:  return low;
+        case 1:  return high;
+        default: return (low <= 0 && high >= 0) ? 0 : low;
+        }
+    }
+    return low + size * qint32(uniform(quint32((high - low) / size + 1)));
+}
+
+void InstructionGenerator::queueBaseSetup()
+{
+    // li base, baseValue as lui + addi with the %hi/%lo carry correction
+    const quint32 rd = quint32(limits.baseRegister);
+    const qint32 low = qint32(baseValue << 20) >> 20;
+    const quint32 high = (baseValue - quint32(low)) & 0xFFFFF000;
+
+    if (high != 0) {
+        pending.append(high | (rd << 7) | 0x37);
+        pending.append((quint32(low & 0xFFF) << 20) | (rd << 15) | (rd << 7) | 0x13);
+    } else {
+        pending.append((quint32(low & 0xFFF) << 20) | (rd << 7) | 0x13);
+    }
+}
+
+quint32 InstructionGenerator::encode(const Candidate& candidate)
+{
+    const InstructionCoverage::InstructionKind& kind = candidate.kind;
+    const quint32 opcode = kind.opcode;
+    const quint32 funct3 = quint32(kind.funct3) << 12;
+    const quint32 rdMask = coverage ? coverage->destinationMask() : 0;
+    const quint32 rs1Mask = coverage ? coverage->source1Mask() : 0;
+    const quint32 rs2Mask = coverage ? coverage->source2Mask() : 0;
+
+    switch (kind.format) {
+    case InstructionCoverage::FormatR: {
+        quint32 rd = pickRegister(destinationPool, rdMask);
+        quint32 rs1 = pickRegister(sourcePool, rs1Mask);
+        quint32 rs2 = pickRegister(sourcePool, rs2Mask);
+        return (quint32(kind.funct7) << 25) | (rs2 << 20) | (rs1 << 15) | funct3 | (rd << 7) | opcode;
+    }
+    case InstructionCoverage::FormatI: {
+        if (opcode == 0x0f) {
+            return 0x0ff0000f; // fence iorw, iorw
+        }
+        if (opcode == 0x73 && kind.funct3 == 0) {
+            return (uniform(2) << 20) | opcode; // ecall / ebreak
+        }
+
+        quint32 rd = pickRegister(destinationPool, rdMask);
+        if (opcode == 0x73) {
+            // cycle, time and instret are read-only: writing them traps, so
+            // they are only read (set or clear with x0 or 0). csrrw and csrrwi
+            // always write and go to mscratch, which needs M-mode and Zicsr.
+            static const quint32 csrs[] = {0xC00, 0xC01, 0xC02, 0x340};
+            const quint32 Mscratch = 0x340;
+            const quint32 csr = (kind.funct3 & 0x3) == 1 ? Mscratch : csrs[uniform(4)];
+            quint32 source = 0;
+            if (csr == Mscratch) {
+                source = (kind.funct3 & 0x4) ? uniform(32) : quint32(pickRegister(sourcePool, rs1Mask));
+            }
+            return (csr << 20) | (source << 15) | funct3 | (rd << 7) | opcode;
+        }
+        if (candidate.memorySize) {
+            qint32 offset = pickMemoryOffset(candidate.memorySize);
+            return (quint32(offset & 0xFFF) << 20) | (quint32(limits.baseRegister) << 15) | funct3 | (rd << 7) | opcode;
+        }
+
+        quint32 rs1 = pickRegister(sourcePool, rs1Mask);
+        if (kind.funct7 >= 0) {
+            // Shifts: steer toward shift amounts not yet seen
+            quint32 amounts = 0xFFFFFFFF;
+            if (biasThreshold && chance(biasThreshold)) {
+                for (int shamt = 0; shamt < 32; shamt++) {
+                    if (coverage->hasShiftAmount(shamt)) {
+                        amounts &= ~(1u << shamt);
+                    }
+                }
+            }
+            quint32 shamt = quint32(pickRegister(amounts ? amounts : 0xFFFFFFFF, 0));
+            return (quint32(kind.funct7) << 25) | (shamt << 20) | (rs1 << 15) | funct3 | (rd << 7) | opcode;
+        }
+
+        qint32 imm = pickImmediate(InstructionCoverage::FormatI);
+        return (quint32(imm & 0xFFF) << 20) | (rs1 << 15) | funct3 | (rd << 7) | opcode;
+    }
+    case InstructionCoverage::FormatS: {
+        quint32 rs2 = pickRegister(sourcePool, rs2Mask);
+        quint32 rs1 = quint32(limits.baseRegister);
+        qint32 offset = pickMemoryOffset(candidate.memorySize);
+        return (quint32((offset >> 5) & 0x7F) << 25) | (rs2 << 20) | (rs1 << 15) | funct3
+               | (quint32(offset & 0x1F) << 7) | opcode;
+    }
+    case InstructionCoverage::FormatB: {
+        quint32 rs1 = pickRegister(sourcePool, rs1Mask);
+        quint32 rs2 = pickRegister(sourcePool, rs2Mask);
+        qint32 imm = pickImmediate(InstructionCoverage::FormatB);
+        return (quint32((imm >> 12) & 0x1) << 31) | (quint32((imm >> 5) & 0x3F) << 25)
+               | (rs2 << 20) | (rs1 << 15) | funct3
+               | (quint32((imm >> 1) & 0xF) << 8) | (quint32((imm >> 11) & 0x1) << 7) | opcode;
+    }
+    case InstructionCoverage::FormatU: {
+        quint32 rd = pickRegister(destinationPool, rdMask);
+        qint32 imm = pickImmediate(InstructionCoverage::FormatU);
+        return (quint32(imm & 0xFFFFF) << 12) | (rd << 7) | opcode;
+    }
+    case InstructionCoverage::FormatJ: {
+        quint32 rd = pickRegister(destinationPool, rdMask);
+        qint32 imm = pickImmediate(InstructionCoverage::FormatJ);
+        return (quint32((imm >> 20) & 0x1) << 31) | (quint32((imm >> 1) & 0x3FF) << 21)
+               | (quint32((imm >> 11) & 0x1) << 20) | (quint32((imm >> 12) & 0xFF) << 12)
+               | (rd << 7) | opcode;
+    }
+    default:
+        return 0x00000013; // nop
+    }
+}
+
+bool InstructionGenerator::next(quint32& machineCode)
+{
+    if (!pending.isEmpty()) {
+        machineCode = pending.takeFirst();
+        count++;
+        return true;
+    }
+
+    if (count % WeightRefreshInterval == 0) {
+        refreshWeights();
+        if (!pending.isEmpty()) {
+            machineCode = pending.takeFirst();
+            count++;
+            return true;
+        }
+    }
+
+    machineCode = encode(pickCandidate());
+    count++;
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef INSTRUCTIONGENERATOR_H
+#define INSTRUCTIONGENERATOR_H
+
+#include <QVector>
+#include "instructionsource.h"
+#include "instructioncoverage.h"
+
+// Seedable constrained-random RV32I instruction stream. Words are encoded
+// directly (no text round trip) and, when a coverage collector is given,
+// instruction kinds, registers and immediate edge values are biased toward
+// what has not been exercised yet.
+class InstructionGenerator : public InstructionSource
+{
+public:
+    struct Constraints {
+        quint32 registerPool = 0xFFFFFFFF;  // bit N set: xN may be used
+        int baseRegister = 31;              // holds the memory window base, never overwritten
+        quint32 windowBase = 0;             // loads and stores stay inside [base, base + size)
+        quint32 windowSize = 4096;
+        double edgeImmediateRate = 0.25;    // probability of an immediate edge value
+        double coverageBias = 0.75;         // probability of steering a choice to uncovered space
+        bool allowLoads = true;
+        bool allowStores = true;
+        bool allowBranches = true;
+        bool allowJumps = true;
+        bool allowSystem = false;           // fence, ecall/ebreak and CSR access
+    };
+
+    InstructionGenerator(const Constraints& constraints, quint64 seed,
+                         const InstructionCoverage *coverage = nullptr);
+
+    bool next(quint32& machineCode) override;
+
+    // Restart the stream; the same seed reproduces the same words
+    void restart(quint64 seed);
+
+    quint64 generated() const { return count; }
+    const Constraints& constraints() const { return limits; }
+
+private:
+    struct Candidate {
+        InstructionCoverage::InstructionKind kind;
+        int memorySize;         // bytes accessed by loads and stores, 0 otherwise
+        double cumulativeWeight;
+    };
+
+    static const int WeightRefreshInterval = 4096;
+
+    quint64 random();
+    quint32 uniform(quint32 range) { return quint32(((random() >> 32) * quint64(range)) >> 32); }
+    bool chance(quint32 threshold) { return (random() >> 32) < threshold; }
+
+    void buildCandidates();
+    void refreshWeights();
+    const Candidate& pickCandidate();
+    int pickRegister(quint32 pool, quint32 coveredMask);
+    qint32 pickImmediate(InstructionCoverage::Format format);
+    qint32 pickMemoryOffset(int size);
+    void queueBaseSetup();
+    quint32 encode(const Candidate& candidate);
+
+    Constraints limits;
+    const InstructionCoverage *coverage;
+    quint64 state;
+    quint64 count;
+    QVector<Candidate> candidates;
+    QVector<quint32> pending;           // setup words emitted before the random stream
+    quint32 destinationPool;
+    quint32 sourcePool;
+    quint32 baseValue;
+    quint32 edgeThreshold;
+    quint32 biasThreshold;
+};
+
+#endif // INSTRUCTIONGENERATOR_H
@@ -0,0 +1,40 @@
+#ifndef INSTRUCTIONSOURCE_H
+#define INSTRUCTIONSOURCE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+// Supplies already-encoded instruction words to the streaming sender
+class InstructionSource
+{
+public:
+    virtual ~InstructionSource() = default;
+
+    // Returns false when the source is exhausted
+    virtual bool next(quint32& machineCode) = 0;
+};
+
+// Streams a fixed, already-assembled program once
+class InstructionListSource : public InstructionSource
+{
+public:
+    explicit InstructionListSource(const QVector<quint32>& words = QVector<quint32>())
+        : words(words), position(0) {}
+
+    void reset(const QVector<quint32>& newWords) { words = newWords; position = 0; }
+
+    bool next(quint32& machineCode) override
+    {
+        if (position >= words.size()) {
+            return false;
+        }
+        machineCode = words[position++];
+        return true;
+    }
+
+private:
+    QVector<quint32> words;
+    int position;
+};
+
+#endif // INSTRUCTIONSOURCE_H
@@ -0,0 +1,113 @@
+#include "instructionstreamer.h"
+#include "tracing.h"
+#include <QPointer>
+
+InstructionStreamer::InstructionStreamer(RiscVSession *session, QObject *parent)
+    : QObject(parent)
+    , session(session)
+    , source(nullptr)
+    , limit(0)
+    , sentCount(0)
+    , completedCount(0)
+    , generation(0)
+    , sourceExhausted(false)
+    , breakpoints(nullptr)
+    , firstAddress(0)
+    , breakHit(false)
+    , breakWord(0)
+{
+    connect(session, &RiscVSession::watchpointHit, this, &InstructionStreamer::watchpointHit);
+}
+
+void InstructionStreamer::setBreakpoints(const BreakpointSet *set, quint32 address)
+{
+    breakpoints = set;
+    firstAddress = address;
+}
+
+void InstructionStreamer::start(InstructionSource *newSource, quint64 newLimit)
+{
+    source = newSource;
+    limit = newLimit;
+    sentCount = 0;
+    completedCount = 0;
+    sourceExhausted = false;
+    breakHit = false;
+    breakDescription.clear();
+    generation++;
+    elapsed.start();
+    fill();
+}
+
+void InstructionStreamer::stop()
+{
+    if (source) {
+        finish(true, QString());
+    }
+}
+
+double InstructionStreamer::instructionsPerSecond() const
+{
+    qint64 milliseconds = elapsed.isValid() ? elapsed.elapsed() : 0;
+    return milliseconds > 0 ? completedCount * 1000.0 / milliseconds : 0;
+}
+
+void InstructionStreamer::fill()
+{
+    TRACE_ZONE("streamer.fill");
+    while (source && !sourceExhausted && sentCount - completedCount < quint64(QueueDepth)) {
+        if (breakpoints && sentCount > 0 && breakpoints->breaksAt(firstAddress + quint32(sentCount) * 4)) {
+            breakHit = true;
+            breakWord = sentCount;
+            breakDescription = QString("breakpoint at 0x%1")
+                                   .arg(firstAddress + quint32(sentCount) * 4, 8, 16, QChar('0'));
+            sourceExhausted = true;
+            break;
+        }
+        quint32 machineCode;
+        if ((limit && sentCount >= limit) || !source->next(machineCode)) {
+            sourceExhausted = true;
+            break;
+        }
+        sentCount++;
+
+        QPointer<InstructionStreamer> self(this);
+        const quint64 startedGeneration = generation;
+        session->execute(machineCode).then([self, startedGeneration](const SessionResult& result) {
+            if (!self || self->generation != startedGeneration || !self->source) {
+                return;
+            }
+            self->completedCount++;
+            if (!result.ok) {
+                self->finish(false, result.errorMessage);
+                return;
+            }
+            self->fill();
+        });
+    }
+
+    if (source && sourceExhausted && completedCount == sentCount) {
+        finish(true, QString());
+    }
+}
+
+void InstructionStreamer::watchpointHit(const QString& watchpoint, quint32 address, quint32 value)
+{
+    if (!source || breakHit) {
+        return;
+    }
+
+    // The access belongs to the oldest word still in flight; what is queued behind it drains
+    breakHit = true;
+    breakWord = completedCount;
+    breakDescription = QString("%1 hit: 0x%2 at 0x%3").arg(watchpoint)
+                           .arg(value, 8, 16, QChar('0')).arg(address, 8, 16, QChar('0'));
+    sourceExhausted = true;
+}
+
+void InstructionStreamer::finish(bool ok, const QString& errorMessage)
+{
+    source = nullptr;
+    generation++;
+    emit finished(ok, errorMessage);
+}
@@ -0,0 +1,65 @@
+#ifndef INSTRUCTIONSTREAMER_H
+#define INSTRUCTIONSTREAMER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include "riscvsession.h"
+#include "instructionsource.h"
+
+// Pulls words from an InstructionSource and keeps the session's queue
+// topped up, so the next frame leaves as soon as CPU_READY arrives.
+//
+// With breakpoints set, the stream stops before sending a word whose
+// address is a PC breakpoint, or after a watchpoint fires; words already
+// queued still complete, and completed() tells where to continue.
+class InstructionStreamer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InstructionStreamer(RiscVSession *session, QObject *parent = nullptr);
+
+    // limit == 0 streams until the source is exhausted or stop() is called
+    void start(InstructionSource *source, quint64 limit = 0);
+    void stop();
+
+    // Not owned. Word n of the stream is at firstAddress + 4 * n; the first
+    // word is sent even if it has a breakpoint, so a stopped run can continue.
+    void setBreakpoints(const BreakpointSet *set, quint32 firstAddress = 0);
+    bool stoppedAtBreakpoint() const { return breakHit; }
+    QString breakReason() const { return breakDescription; }
+    quint64 breakIndex() const { return breakWord; }    // word that hit, from the start of the stream
+
+    bool isActive() const { return source != nullptr; }
+    quint64 sent() const { return sentCount; }
+    quint64 completed() const { return completedCount; }
+    double instructionsPerSecond() const;
+
+signals:
+    void finished(bool ok, const QString& errorMessage);
+
+private slots:
+    void watchpointHit(const QString& watchpoint, quint32 address, quint32 value);
+
+private:
+    static const int QueueDepth = 2;
+
+    void fill();
+    void finish(bool ok, const QString& errorMessage);
+
+    RiscVSession *session;
+    InstructionSource *source;
+    quint64 limit;
+    quint64 sentCount;
+    quint64 completedCount;
+    quint64 generation;
+    bool sourceExhausted;
+    const BreakpointSet *breakpoints;
+    quint32 firstAddress;
+    bool breakHit;
+    quint64 breakWord;
+    QString breakDescription;
+    QElapsedTimer elapsed;
+};
+
+#endif // INSTRUCTIONSTREAMER_H
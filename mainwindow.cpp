@@ -4,31 +4,73 @@
 #include <QDebug>
 #include <QDateTime>
 #include <QScrollBar>
-#include <QThread>
 #include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QInputDialog>
+#include <QThreadPool>
+#include <QPointer>
+#include "sessioncheckpoint.h"
+#include "memorypreload.h"
+#include "tracing.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , serialPort(nullptr)
+    , device(nullptr)
     , riscvConverter()
-    , csvStream(&csvFile)
+    , session(nullptr)
+    , streamer(nullptr)
+    , metricsServer(nullptr)
     , assemblyLoader(nullptr)  // Initialize pointer
+    , coveragePanel(nullptr)
+    , generatorPanel(nullptr)
+    , memoryInspector(nullptr)
+    , registerPanel(nullptr)
+    , programFirstIndex(-1)
 {
     ui->setupUi(this);
 
     // Initialize CSV file
     initializeCsvFile();
 
-    // Initialize serial port
-    serialPort = new QSerialPort(this);
+    // The session speaks the UART protocol over whichever transport is connected
+    session = new RiscVSession(this);
+    session->setMemory(&memory);
+    session->setCoverage(&coverage);
+
+    // Console, timer, exit and FIFO devices at 0xFFFF0000 and up
+    for (const MemoryMap::Region& region : MemoryMap::defaultLayout()) {
+        QString errorMessage;
+        devices.addRegion(region, errorMessage);
+    }
+    session->setMemoryMap(&devices);
+    session->setReferenceModel(&reference);
+    streamer = new InstructionStreamer(session, this);
+
+    // Docked on the right, hidden until asked for; it tracks stores either way
+    memoryInspector = new MemoryInspector(&memory, this);
+    addDockWidget(Qt::RightDockWidgetArea, memoryInspector);
+    memoryInspector->hide();
+    connect(session, &RiscVSession::storeReceived, memoryInspector,
+            [this](quint32 address) { memoryInspector->noteWrite(address); });
 
     // Connect signals and slots
-    connect(ui->refreshButton, &QPushButton::clicked, this, &MainWindow::refreshSerialPorts);
-    connect(ui->connectButton, &QPushButton::clicked, this, &MainWindow::connectSerialPort);
-    connect(ui->disconnectButton, &QPushButton::clicked, this, &MainWindow::disconnectSerialPort);
-    connect(serialPort, &QSerialPort::errorOccurred, this, &MainWindow::handleSerialError);
-    connect(serialPort, &QSerialPort::readyRead, this, &MainWindow::readData);
+    connect(ui->refreshButton, &QPushButton::clicked, this, &MainWindow::refreshPorts);
+    connect(&portWatcher, &PortWatcher::portAdded, this, &MainWindow::addPort);
+    connect(&portWatcher, &PortWatcher::portRemoved, this, &MainWindow::removePort);
+    connect(ui->connectButton, &QPushButton::clicked, this, &MainWindow::connectPort);
+    connect(ui->disconnectButton, &QPushButton::clicked, this, &MainWindow::disconnectPort);
+    connect(session, &RiscVSession::storeReceived, this, &MainWindow::logStore);
+    connect(session, &RiscVSession::loadServed, this, &MainWindow::logLoad);
+    connect(session, &RiscVSession::cpuReady, this, &MainWindow::logCpuReady);
+    connect(session, &RiscVSession::protocolError, this, &MainWindow::logProtocolError);
+    connect(session, &RiscVSession::hangDetected, this, &MainWindow::logHang);
+    connect(session, &RiscVSession::recovered, this, &MainWindow::logRecovery);
+    connect(session, &RiscVSession::recoveryFailed, this, &MainWindow::logRecoveryFailure);
+    connect(streamer, &InstructionStreamer::finished, this, &MainWindow::streamFinished);
+    connect(&devices, &MemoryMap::consoleLine, this, &MainWindow::logConsole);
+    connect(&devices, &MemoryMap::exitRequested, this, &MainWindow::logExit);
 
     // New connections for log/send functionality
     connect(ui->getPC, &QPushButton::clicked, this, &MainWindow::getPC);
@@ -38,13 +80,33 @@ MainWindow::MainWindow(QWidget *parent)
 
     // For now, let's add it programmatically or you can add it in Qt Designer
     connect(ui->openAssemblyLoaderButton, &QPushButton::clicked, this, &MainWindow::openAssemblyLoader);
-
-    // Initial refresh of available ports
-    refreshSerialPorts();
+    connect(ui->openCoverageButton, &QPushButton::clicked, this, &MainWindow::openCoveragePanel);
+    connect(ui->openGeneratorButton, &QPushButton::clicked, this, &MainWindow::openGeneratorPanel);
+    connect(ui->openMemoryButton, &QPushButton::clicked, this, &MainWindow::openMemoryInspector);
+    connect(ui->openRegistersButton, &QPushButton::clicked, this, &MainWindow::openRegisterPanel);
+    connect(ui->saveCheckpointButton, &QPushButton::clicked, this, &MainWindow::saveCheckpoint);
+    connect(ui->restoreCheckpointButton, &QPushButton::clicked, this, &MainWindow::restoreCheckpoint);
+    connect(ui->preloadButton, &QPushButton::clicked, this, &MainWindow::preloadData);
+    connect(ui->traceButton, &QPushButton::toggled, this, &MainWindow::toggleTracing);
+    connect(ui->waveformButton, &QPushButton::toggled, this, &MainWindow::toggleWaveform);
+    connect(&streamProgressTimer, &QTimer::timeout, this, &MainWindow::reportStreamProgress);
+
+    // memory_map.csv is rewritten at most a few times per second, not per store
+    csvExportTimer.setSingleShot(true);
+    csvExportTimer.setInterval(250);
+    connect(&csvExportTimer, &QTimer::timeout, this, &MainWindow::exportMemoryMap);
+
+    startMetricsServer();
+
+    // The built-in transports are listed right away; serial ports are found
+    // off the GUI thread and follow hot-plugging from then on
+    for (const Transport& builtIn : Transport::builtIn()) {
+        addPort(builtIn);
+    }
+    portWatcher.start();
 
     // Set initial state
     updateStatus("Status: Disconnected", false);
-    PC_counter=false;
     // Update placeholder text for RISC-V instructions
     ui->sendLineEdit->setPlaceholderText("Enter RISC-V instruction (e.g., add x5, x6, x7)...");
 }
@@ -55,6 +117,8 @@ void MainWindow::openAssemblyLoader()
         assemblyLoader = new AssemblyLoader(this);
         connect(assemblyLoader, &AssemblyLoader::instructionSelected,
                 this, &MainWindow::handleInstructionFromLoader);
+        connect(assemblyLoader, &AssemblyLoader::runRequested, this, &MainWindow::runAssembly);
+        connect(assemblyLoader, &AssemblyLoader::stopRequested, this, &MainWindow::stopStream);
     }
 
     assemblyLoader->show();
@@ -62,6 +126,146 @@ void MainWindow::openAssemblyLoader()
     assemblyLoader->activateWindow();
 }
 
+void MainWindow::openCoveragePanel()
+{
+    if (!coveragePanel) {
+        coveragePanel = new CoveragePanel(&coverage, this);
+    }
+
+    coveragePanel->show();
+    coveragePanel->raise();
+    coveragePanel->activateWindow();
+}
+
+void MainWindow::openGeneratorPanel()
+{
+    if (!generatorPanel) {
+        generatorPanel = new GeneratorPanel(this);
+        connect(generatorPanel, &GeneratorPanel::startRequested, this, &MainWindow::startRandomStream);
+        connect(generatorPanel, &GeneratorPanel::stopRequested, this, &MainWindow::stopStream);
+    }
+
+    generatorPanel->show();
+    generatorPanel->raise();
+    generatorPanel->activateWindow();
+}
+
+void MainWindow::openMemoryInspector()
+{
+    memoryInspector->show();
+    memoryInspector->raise();
+}
+
+void MainWindow::openRegisterPanel()
+{
+    if (!registerPanel) {
+        registerPanel = new RegisterPanel(session, this);
+        connect(registerPanel, &RegisterPanel::dumpFinished, this, &MainWindow::registerDumpFinished);
+    }
+
+    registerPanel->show();
+    registerPanel->raise();
+    registerPanel->activateWindow();
+}
+
+void MainWindow::registerDumpFinished(bool ok, const QString& errorMessage)
+{
+    // The scratch stores were undone behind the views' backs
+    memoryInspector->reload();
+    scheduleMemoryMapExport();
+
+    appendToLog(ok ? QString("Register dump complete, scratch memory restored")
+                   : QString("Register dump failed: %1").arg(errorMessage), false);
+}
+
+void MainWindow::startRandomStream(const InstructionGenerator::Constraints& constraints, quint64 seed, quint64 count)
+{
+    if (!isConnected()) {
+        QMessageBox::warning(this, "Send Error", "Not connected.");
+        return;
+    }
+
+    stopStream();
+
+    // Bias the stream toward what this session has not covered yet
+    generator.reset(new InstructionGenerator(constraints, seed, &coverage));
+    appendToLog(QString("Random stream started: seed %1, %2 instructions")
+                    .arg(seed)
+                    .arg(count ? QString::number(count) : QString("unlimited")), true);
+    startStream(generator.get(), count);
+}
+
+void MainWindow::runAssembly(const QVector<quint32>& words, int firstIndex)
+{
+    if (!isConnected()) {
+        QMessageBox::warning(this, "Send Error", "Not connected.");
+        return;
+    }
+
+    stopStream();
+
+    // AssemblyProgram places instruction n at address n * 4
+    programSource.reset(words);
+    programFirstIndex = firstIndex;
+    assemblyLoader->setRunning(true);
+    appendToLog(QString("Running %1 instructions from the assembly loader").arg(words.size()), true);
+    startStream(&programSource, 0, assemblyLoader->breakpoints(), quint32(firstIndex) * 4);
+}
+
+void MainWindow::startStream(InstructionSource *source, quint64 limit, const BreakpointSet *breakpoints,
+                             quint32 firstAddress)
+{
+    session->setBreakpoints(breakpoints);
+    streamer->setBreakpoints(breakpoints, firstAddress);
+    streamProgressTimer.start(1000);
+    if (generatorPanel) {
+        generatorPanel->setStreaming(true);
+    }
+
+    // The streamer keeps the session queue topped up; each word goes out on the next ready byte
+    streamer->start(source, limit);
+}
+
+void MainWindow::stopStream()
+{
+    streamer->stop();
+}
+
+void MainWindow::streamFinished(bool ok, const QString& errorMessage)
+{
+    streamProgressTimer.stop();
+    reportStreamProgress();
+    if (!ok) {
+        QMessageBox::critical(this, "Send Error",
+                              QString("Failed to send instruction: %1").arg(errorMessage));
+    }
+    appendToLog(QString("Stream stopped after %1 instructions").arg(streamer->completed()), true);
+    if (generatorPanel) {
+        generatorPanel->setStreaming(false);
+    }
+    session->setBreakpoints(nullptr);
+
+    if (programFirstIndex >= 0 && assemblyLoader) {
+        const int lastExecuted = programFirstIndex + int(streamer->completed()) - 1;
+        assemblyLoader->setRunning(false);
+        if (streamer->stoppedAtBreakpoint()) {
+            appendToLog(QString("Stopped at %1").arg(streamer->breakReason()), false);
+            assemblyLoader->showBreak(programFirstIndex + int(streamer->breakIndex()), lastExecuted,
+                                      streamer->breakReason());
+        } else {
+            assemblyLoader->setCurrentIndex(lastExecuted);
+        }
+    }
+    programFirstIndex = -1;
+}
+
+void MainWindow::reportStreamProgress()
+{
+    if (generatorPanel) {
+        generatorPanel->setProgress(streamer->completed(), streamer->instructionsPerSecond());
+    }
+}
+
 void MainWindow::handleInstructionFromLoader(const QString& instruction)
 {
     // Set the instruction in the send line edit and send it
@@ -73,145 +277,399 @@ void MainWindow::handleInstructionFromLoader(const QString& instruction)
 void MainWindow::initializeCsvFile()
 {
     QString fileName = "memory_map.csv";
-    QString filePath = QDir::current().filePath(fileName);
+    csvFilePath = QDir::current().filePath(fileName);
 
-    csvFile.setFileName(filePath);
+    QString errorMessage;
+    if (memory.exportCsv(csvFilePath, errorMessage)) {
+        appendToLog(QString("Memory map CSV created: %1").arg(csvFilePath));
+        qDebug() << "Memory map CSV created:" << csvFilePath;
+    } else {
+        QMessageBox::warning(this, "File Error", errorMessage);
+        qDebug() << errorMessage;
+    }
+}
 
-    if (csvFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
-        csvStream << "DataValue\n";
-        csvStream.flush();
+void MainWindow::startMetricsServer()
+{
+    // One port per running instance; RISCV_METRICS_PORT=0 turns the listener off
+    quint16 port = DefaultMetricsPort;
+    if (qEnvironmentVariableIsSet("RISCV_METRICS_PORT")) {
+        port = quint16(qEnvironmentVariableIntValue("RISCV_METRICS_PORT"));
+        if (port == 0) {
+            return;
+        }
+    }
 
-        appendToLog(QString("Memory map CSV created: %1").arg(filePath));
-        qDebug() << "Memory map CSV created:" << filePath;
+    metricsServer = new MetricsServer(&metrics, this);
+    QString errorMessage;
+    if (metricsServer->listen(port, errorMessage)) {
+        appendToLog(QString("Metrics at http://127.0.0.1:%1/metrics").arg(metricsServer->port()), false);
     } else {
-        QMessageBox::warning(this, "File Error",
-                             QString("Failed to create CSV file: %1").arg(csvFile.errorString()));
-        qDebug() << "Failed to create CSV file:" << csvFile.errorString();
+        appendToLog(errorMessage, false);
     }
 }
 
-
-void MainWindow::writeToCsv(quint32 address, quint32 dataValue)
+void MainWindow::toggleTracing(bool enabled)
 {
-    if (!csvFile.isOpen()) {
-        qDebug() << "CSV file not open!";
+    if (enabled) {
+        Tracing::clear();
+        Tracing::setThreadName("GUI");
+        Tracing::setEnabled(true);
+        appendToLog("Tracing started", false);
         return;
     }
 
-    // Calculate target row (address / 4)
-    int targetRow = address / 4;
-
-    // Read current file content to find where we are
-    csvFile.close();
+    Tracing::setEnabled(false);
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Trace", "trace.json",
+                                                    "Chrome Trace (*.json);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
 
-    QVector<QString> lines;
-    if (csvFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&csvFile);
-        while (!in.atEnd()) {
-            lines.append(in.readLine());
-        }
-        csvFile.close();
+    QString errorMessage;
+    if (Tracing::writeChromeTrace(fileName, errorMessage)) {
+        appendToLog(QString("Trace saved to %1 (open in ui.perfetto.dev or chrome://tracing)").arg(fileName), false);
+    } else {
+        QMessageBox::warning(this, "Trace Error", errorMessage);
     }
+}
 
-    // Ensure we have enough rows (including header)
-    while (lines.size() <= targetRow + 1) {  // +1 for header
-        if (lines.isEmpty()) {
-            lines.append("DataValue");  // Header
+void MainWindow::toggleWaveform(bool enabled)
+{
+    QString errorMessage;
+    if (!enabled) {
+        session->setWaveform(nullptr);
+        if (!waveform.isOpen()) {
+            return;
+        }
+        if (waveform.close(errorMessage)) {
+            appendToLog(QString("Waveform stopped after %1 changes").arg(waveform.changeCount()), false);
         } else {
-            lines.append("0x00000000");  // Default value
+            QMessageBox::warning(this, "Waveform Error", errorMessage);
         }
+        return;
     }
 
-    // Update the specific row
-    lines[targetRow + 1] = QString("0x%1").arg(dataValue, 8, 16, QChar('0'));
-
-    // Write back
-    if (csvFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
-        for (const QString& line : lines) {
-            csvStream << line << "\n";
+    // The file is written while recording, so it is chosen up front
+    QString fileName = QFileDialog::getSaveFileName(this, "Record Waveform", "link.vcd",
+                                                    "Value Change Dump (*.vcd);;All Files (*)");
+    if (fileName.isEmpty() || !waveform.open(fileName, errorMessage)) {
+        if (!fileName.isEmpty()) {
+            QMessageBox::warning(this, "Waveform Error", errorMessage);
         }
-        csvStream.flush();
+        ui->waveformButton->setChecked(false);
+        return;
+    }
+    session->setWaveform(&waveform);
+    appendToLog(QString("Recording waveform to %1 (open in GTKWave)").arg(fileName), false);
+}
+
+void MainWindow::scheduleMemoryMapExport()
+{
+    if (!csvExportTimer.isActive()) {
+        csvExportTimer.start();
+    }
+}
 
-        qDebug() << "Memory updated - Address:" << QString("0x%1").arg(address, 8, 16, QChar('0'))
-                 << "-> Row:" << (targetRow + 1) << "Data:" << lines[targetRow + 1];
+void MainWindow::exportMemoryMap()
+{
+    TRACE_ZONE("gui.exportMemoryMap");
+    // Loads are served from the in-memory model; the CSV is only a snapshot of it
+    QString errorMessage;
+    if (!memory.exportCsv(csvFilePath, errorMessage)) {
+        qDebug() << errorMessage;
     }
 }
+
 MainWindow::~MainWindow()
 {
-    if (serialPort && serialPort->isOpen()) {
-        serialPort->close();
+    if (isConnected()) {
+        device->close();
     }
+    session->cancelAll("Application closed");
+
+    // The session is a child and outlives these members
+    session->setMetrics(nullptr);
+    session->setReferenceModel(nullptr);
+    session->setMemoryMap(nullptr);
+    session->setWaveform(nullptr);
 
-    // Close CSV file
-    if (csvFile.isOpen()) {
-        csvFile.close();
+    // Flush the last stores to the memory map
+    if (csvExportTimer.isActive()) {
+        exportMemoryMap();
     }
 
     delete ui;
 }
 
-void MainWindow::refreshSerialPorts()
+void MainWindow::saveCheckpoint()
 {
-    ui->serialPortComboBox->clear();
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Checkpoint", "",
+                                                    "Checkpoints (*.rvcp);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
 
-    // Get available serial ports
-    QList<QSerialPortInfo> ports = QSerialPortInfo::availablePorts();
+    // Taking the snapshot is cheap; compressing and writing it happens on a
+    // worker thread so a running stream is not held up
+    SessionCheckpoint checkpoint = SessionCheckpoint::capture(*session);
+    if (assemblyLoader && !assemblyLoader->currentFile().isEmpty()) {
+        checkpoint.programName = assemblyLoader->currentFile();
+        checkpoint.programPosition = assemblyLoader->currentIndex();
+    }
 
-    if (ports.isEmpty()) {
-        ui->serialPortComboBox->addItem("No serial ports found");
-        ui->connectButton->setEnabled(false);
-    } else {
-        for (const QSerialPortInfo &port : ports) {
-            QString portInfo = QString("%1 - %2").arg(port.portName()).arg(port.description());
-            ui->serialPortComboBox->addItem(portInfo, port.portName());
+    QPointer<MainWindow> window(this);
+    QThreadPool::globalInstance()->start([window, checkpoint, fileName]() {
+        QString errorMessage;
+        bool ok = checkpoint.save(fileName, errorMessage);
+        QMetaObject::invokeMethod(window, [window, ok, fileName, errorMessage]() {
+            if (!window) {
+                return;
+            }
+            if (ok) {
+                window->appendToLog(QString("Checkpoint saved to %1").arg(fileName), false);
+            } else {
+                QMessageBox::warning(window, "Checkpoint Error", errorMessage);
+            }
+        });
+    });
+}
+
+void MainWindow::restoreCheckpoint()
+{
+    if (!isConnected()) {
+        QMessageBox::warning(this, "Not Connected", "Connect to a board before restoring a checkpoint.");
+        return;
+    }
+    if (streamer->isActive()) {
+        QMessageBox::warning(this, "Stream Running", "Stop the running stream before restoring a checkpoint.");
+        return;
+    }
+
+    QString fileName = QFileDialog::getOpenFileName(this, "Restore Checkpoint", "",
+                                                    "Checkpoints (*.rvcp);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    SessionCheckpoint checkpoint;
+    QString errorMessage;
+    if (!checkpoint.load(fileName, errorMessage)) {
+        QMessageBox::warning(this, "Checkpoint Error", errorMessage);
+        return;
+    }
+
+    appendToLog(QString("Restoring checkpoint %1...").arg(fileName), false);
+    reference.clear();
+
+    QPointer<MainWindow> window(this);
+    checkpoint.restore(session).then([window](const SessionResult& result) {
+        if (!window) {
+            return;
+        }
+        if (!result.ok) {
+            window->appendToLog(QString("Checkpoint restore failed: %1").arg(result.errorMessage), false);
+            QMessageBox::warning(window, "Checkpoint Error", result.errorMessage);
+            return;
+        }
+        if (!result.errorMessage.isEmpty()) {
+            window->appendToLog(QString("Warning: %1").arg(result.errorMessage), false);
+        }
+        window->appendToLog("Checkpoint restored", false);
+    });
+
+    // The memory map changed wholesale
+    memoryInspector->reload();
+    scheduleMemoryMapExport();
+
+    if (!checkpoint.programName.isEmpty()) {
+        openAssemblyLoader();
+        if (assemblyLoader->openFile(checkpoint.programName)) {
+            assemblyLoader->setCurrentIndex(int(checkpoint.programPosition));
         }
-        ui->connectButton->setEnabled(true);
     }
 }
 
-void MainWindow::connectSerialPort()
+void MainWindow::preloadData()
 {
-    if (serialPort->isOpen()) {
-        serialPort->close();
+    if (streamer->isActive()) {
+        QMessageBox::warning(this, "Stream Running", "Stop the running stream before preloading data.");
+        return;
+    }
+
+    QString fileName = QFileDialog::getOpenFileName(this, "Preload Data", "",
+                                                    "Data files (*.bin *.hex *.ihex *.csv *.txt);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    bool ok;
+    QString address = QInputDialog::getText(this, "Preload Data", "Base address:", QLineEdit::Normal, "0x00000000", &ok);
+    if (!ok) {
+        return;
+    }
+
+    MemoryPreload preload;
+    quint64 words = 0;
+    QString errorMessage;
+    if (!MemoryPreload::parse(fileName + "@" + address.trimmed(), preload, errorMessage)
+        || !preload.load(memory, errorMessage, &words)) {
+        QMessageBox::warning(this, "Preload Error", errorMessage);
+        return;
+    }
+
+    // The reference model must see the same data when the core loads it
+    QString referenceError;
+    if (!preload.load(reference.memory(), referenceError)) {
+        QMessageBox::warning(this, "Preload Error", referenceError);
     }
 
-    QString selectedPort = ui->serialPortComboBox->currentData().toString();
+    memoryInspector->reload();
+    scheduleMemoryMapExport();
+    appendToLog(QString("Preloaded %1 words from %2").arg(words).arg(preload.describe()), false);
+}
+
+void MainWindow::refreshPorts()
+{
+    portWatcher.rescan();
+}
 
-    if (selectedPort.isEmpty()) {
-        QMessageBox::warning(this, "Connection Error", "Please select a valid serial port.");
+void MainWindow::addPort(const Transport& port)
+{
+    QComboBox *ports = ui->serialPortComboBox;
+    if (ports->findData(port.toString()) >= 0) {
         return;
     }
 
-    serialPort->setPortName(selectedPort);
+    // Serial ports sorted by name, then the simulated core and the TCP
+    // default; anything else can be typed in
+    int row = ports->count();
+    if (port.kind == Transport::Serial) {
+        for (int i = 0; i < ports->count(); i++) {
+            Transport listed;
+            QString errorMessage;
+            if (!Transport::parse(ports->itemData(i).toString(), listed, errorMessage)
+                || listed.kind != Transport::Serial || listed.address > port.address) {
+                row = i;
+                break;
+            }
+        }
+    }
+    QString portInfo = port.description.isEmpty() ? port.toString()
+                                                  : QString("%1 - %2").arg(port.toString(), port.description);
+    ports->insertItem(row, portInfo, port.toString());
+
+    if (port.kind == Transport::Serial && port.address == reconnectAddress && !device
+        && ui->autoReconnectCheckBox->isChecked()) {
+        ports->setCurrentIndex(row);
+        QString errorMessage;
+        transport = port;
+        if (openConnection(errorMessage)) {
+            appendToLog(QString("Reconnected to %1").arg(transport.toString()), false);
+        } else {
+            // Usually udev has not set the permissions yet; the next change retries
+            appendToLog(QString("Reconnect to %1 failed: %2").arg(port.toString(), errorMessage), false);
+        }
+    }
+}
+
+void MainWindow::removePort(const Transport& port)
+{
+    const int row = ui->serialPortComboBox->findData(port.toString());
+    if (row >= 0) {
+        ui->serialPortComboBox->removeItem(row);
+    }
+
+    // The read error usually comes first, but not on every platform
+    if (device && transport.kind == Transport::Serial && QFileInfo(transport.address).fileName() == port.address
+        && ui->autoReconnectCheckBox->isChecked()) {
+        boardLost("adapter unplugged");
+    }
+}
 
-    // Set common serial port settings
-    serialPort->setBaudRate(QSerialPort::Baud115200);
-    serialPort->setDataBits(QSerialPort::Data8);
-    serialPort->setParity(QSerialPort::NoParity);
-    serialPort->setStopBits(QSerialPort::OneStop);
-    serialPort->setFlowControl(QSerialPort::NoFlowControl);
+void MainWindow::boardLost(const QString& reason)
+{
+    const QString address = QFileInfo(transport.address).fileName();
+    appendToLog(QString("Lost %1 (%2); reconnecting when it comes back").arg(transport.toString(), reason), false);
+    disconnectPort();
+    reconnectAddress = address;
+}
 
-    if (serialPort->open(QIODevice::ReadWrite)) {
-        updateStatus(QString("Status: Connected to %1").arg(selectedPort), true);
-        ui->connectButton->setEnabled(false);
-        ui->disconnectButton->setEnabled(true);
-        ui->refreshButton->setEnabled(false);
-        ui->serialPortComboBox->setEnabled(false);
+void MainWindow::connectPort()
+{
+    if (device) {
+        disconnectPort();
+    }
 
-        // Log connection
-        appendToLog(QString("Connected to %1").arg(selectedPort));
-    } else {
-        QMessageBox::critical(this, "Connection Error",
-                              QString("Failed to connect to %1: %2").arg(selectedPort).arg(serialPort->errorString()));
+    // A listed entry carries its transport; typed text is parsed as one
+    const int index = ui->serialPortComboBox->currentIndex();
+    const QString text = ui->serialPortComboBox->currentText();
+    QString spec = index >= 0 && ui->serialPortComboBox->itemText(index) == text
+                       ? ui->serialPortComboBox->itemData(index).toString()
+                       : text;
+
+    QString errorMessage;
+    if (!Transport::parse(spec, transport, errorMessage)) {
+        QMessageBox::warning(this, "Connection Error", errorMessage);
+        return;
+    }
+    if (!openConnection(errorMessage)) {
+        QMessageBox::critical(this, "Connection Error", errorMessage);
         updateStatus("Status: Connection failed", false);
     }
 }
 
-void MainWindow::disconnectSerialPort()
+bool MainWindow::openConnection(QString& errorMessage)
+{
+    device = transport.open(QSerialPort::Baud115200, this, errorMessage);
+    if (!device) {
+        return false;
+    }
+    reconnectAddress.clear();
+    if (QSerialPort *serialPort = qobject_cast<QSerialPort *>(device)) {
+        connect(serialPort, &QSerialPort::errorOccurred, this, &MainWindow::handleSerialError);
+    } else if (QAbstractSocket *socket = qobject_cast<QAbstractSocket *>(device)) {
+        connect(socket, &QAbstractSocket::errorOccurred, this, &MainWindow::handleSocketError);
+    }
+    session->setDevice(device);
+
+    updateStatus(QString("Status: Connected to %1").arg(transport.toString()), true);
+    ui->connectButton->setEnabled(false);
+    ui->disconnectButton->setEnabled(true);
+    ui->refreshButton->setEnabled(false);
+    ui->serialPortComboBox->setEnabled(false);
+
+    // A different board may be on the other end; start the mirror from
+    // power-on, seeing the same (possibly preloaded) memory as the board
+    reference.clear();
+    reference.memory() = memory.snapshot();
+    devices.reset();
+
+    // Counters are per port, so a reconnect continues the same series
+    sessionMetrics = SessionMetrics::registerTarget(metrics, transport.name());
+    session->setMetrics(&sessionMetrics);
+
+    // Log connection
+    appendToLog(QString("Connected to %1").arg(transport.toString()));
+    return true;
+}
+
+void MainWindow::disconnectPort()
 {
-    if (serialPort->isOpen()) {
-        appendToLog("Disconnected from serial port");
-        serialPort->close();
+    reconnectAddress.clear();
+    stopStream();
+
+    if (isConnected()) {
+        appendToLog(QString("Disconnected from %1").arg(transport.toString()));
+        device->close();
+    }
+
+    // Anything still queued can no longer complete
+    session->cancelAll("Disconnected");
+    session->setDevice(nullptr);
+    if (device) {
+        // May be called from the device's own error signal
+        device->deleteLater();
+        device = nullptr;
     }
 
     updateStatus("Status: Disconnected", false);
@@ -223,10 +681,32 @@ void MainWindow::disconnectSerialPort()
 
 void MainWindow::handleSerialError(QSerialPort::SerialPortError error)
 {
+    if (error != QSerialPort::NoError && sessionMetrics.serialErrors) {
+        sessionMetrics.serialErrors->add();
+    }
+
     if (error == QSerialPort::ResourceError) {
+        if (ui->autoReconnectCheckBox->isChecked() && transport.kind == Transport::Serial) {
+            boardLost(device->errorString());
+            return;
+        }
         QMessageBox::critical(this, "Serial Port Error",
-                              QString("Serial port error: %1").arg(serialPort->errorString()));
-        disconnectSerialPort();
+                              QString("Serial port error: %1").arg(device->errorString()));
+        disconnectPort();
+    }
+}
+
+void MainWindow::handleSocketError(QAbstractSocket::SocketError error)
+{
+    if (sessionMetrics.serialErrors) {
+        sessionMetrics.serialErrors->add();
+    }
+
+    // The simulation went away; there is nothing to retry on this socket
+    if (error == QAbstractSocket::RemoteHostClosedError || error == QAbstractSocket::NetworkError) {
+        QMessageBox::critical(this, "Connection Error",
+                              QString("%1: %2").arg(transport.toString(), device->errorString()));
+        disconnectPort();
     }
 }
 
@@ -246,8 +726,9 @@ void MainWindow::updateStatus(const QString &message, bool isConnected)
 
 void MainWindow::sendData()
 {
-    if (!serialPort || !serialPort->isOpen()) {
-        QMessageBox::warning(this, "Send Error", "Not connected to any serial port.");
+    TRACE_ZONE("gui.sendData");
+    if (!isConnected()) {
+        QMessageBox::warning(this, "Send Error", "Not connected.");
         return;
     }
 
@@ -256,216 +737,138 @@ void MainWindow::sendData()
         return;
     }
 
-    // Convert RISC-V instruction to machine code using our private converter
-    quint32 machineCode;
+    // A pseudo-instruction may take more than one word; all are checked before any is sent
+    QStringList expansion;
+    QVector<quint32> machineCodes;
     QString errorMessage;
-
-    if (!riscvConverter.convertToMachineCode(instruction, machineCode, errorMessage)) {
+    bool valid = RiscVMachineCodeConverter::expandPseudoInstruction(instruction, expansion, errorMessage);
+    for (int i = 0; valid && i < expansion.size(); i++) {
+        quint32 machineCode;
+        valid = riscvConverter.convertToMachineCode(expansion[i], machineCode, errorMessage);
+        machineCodes.append(machineCode);
+    }
+    if (!valid) {
         QMessageBox::warning(this, "Instruction Error",
                              QString("Invalid RISC-V instruction: %1").arg(errorMessage));
         return;
     }
 
-    // Send protocol: first send byte 3 to trigger wait_for_inst state
-    QByteArray protocolByte;
-    protocolByte.resize(1);
-    protocolByte[0] = 0x03;  // Trigger wait_for_inst state
-
-    // Send instruction as 32-bit little-endian
-    QByteArray instructionData;
-    instructionData.resize(4);
-    instructionData[0] = (machineCode >> 0) & 0xFF;   // LSB
-    instructionData[1] = (machineCode >> 8) & 0xFF;
-    instructionData[2] = (machineCode >> 16) & 0xFF;
-    instructionData[3] = (machineCode >> 24) & 0xFF;  // MSB
-
-    // Send protocol byte first
-    qint64 protocolBytesWritten = serialPort->write(protocolByte);
-    if (protocolBytesWritten == -1) {
-        QMessageBox::critical(this, "Send Error",
-                              QString("Failed to send protocol byte: %1").arg(serialPort->errorString()));
-        return;
-    }
-
-    // Small delay to ensure protocol byte is processed
-    QThread::msleep(10);
-
-    // Send instruction data
-    qint64 instructionBytesWritten = serialPort->write(instructionData);
+    for (int i = 0; i < machineCodes.size(); i++) {
+        // Queued behind anything still in flight; sent as one frame when the core is ready
+        session->execute(machineCodes[i]).then([this](const SessionResult& result) {
+            if (!result.ok && isConnected()) {
+                QMessageBox::critical(this, "Send Error", result.errorMessage);
+            }
+        });
 
-    if (instructionBytesWritten == -1) {
-        QMessageBox::critical(this, "Send Error",
-                              QString("Failed to send instruction: %1").arg(serialPort->errorString()));
-    } else if (instructionBytesWritten != 4) {
-        QMessageBox::warning(this, "Send Error",
-                             QString("Only sent %1 out of 4 instruction bytes").arg(instructionBytesWritten));
-    } else {
         // Log both protocol and instruction
-        QString displayInstruction = QString("32-bit: %1 - %2").arg(riscvConverter.formatMachineCode(machineCode)).arg(instruction);
-
-        appendToLog(displayInstruction, true);
-
-        // Clear the input field after sending
-        ui->sendLineEdit->clear();
+        const QString text = expansion.size() == 1 ? instruction : QString("%1 (%2)").arg(expansion[i], instruction);
+        appendToLog(QString("32-bit: %1 - %2").arg(riscvConverter.formatMachineCode(machineCodes[i]), text), true);
     }
+
+    // Clear the input field after sending
+    ui->sendLineEdit->clear();
 }
 
 void MainWindow::getPC()
 {
-    if (!serialPort || !serialPort->isOpen()) {
-        QMessageBox::warning(this, "Send Error", "Not connected to any serial port.");
+    if (!isConnected()) {
+        QMessageBox::warning(this, "Send Error", "Not connected.");
         return;
     }
 
     // According to README: Send byte 2 to request Program Counter
-    quint8 pcRequest = 2;
-    QByteArray data;
-    data.resize(1);
-    data[0] = pcRequest;
-
+    quint8 pcRequest = quint8(UartProtocol::ProgramCounterCommand);
     QString displayData = QString("8-bit: 0x%1 (%2) - PC Request").arg(pcRequest, 2, 16, QChar('0')).arg(pcRequest);
+    appendToLog(displayData, true);
 
-    PC_counter=true;
-    qint64 bytesWritten = serialPort->write(data);
-
-    if (bytesWritten == -1) {
-        QMessageBox::critical(this, "Send Error",
-                              QString("Failed to send data: %1").arg(serialPort->errorString()));
-    } else if (bytesWritten != data.size()) {
-        QMessageBox::warning(this, "Send Error",
-                             QString("Only sent %1 out of %2 bytes").arg(bytesWritten).arg(data.size()));
-    } else {
-        // Log sent data
-        appendToLog(displayData, true);
-    }
+    session->readPC().then([this](const SessionResult& result) {
+        if (!result.ok) {
+            if (isConnected()) {
+                QMessageBox::critical(this, "Send Error", result.errorMessage);
+            }
+            return;
+        }
+        QString receivedData = QString("Program counter: 0x%1 (%2)").arg(result.value, 8, 16, QChar('0')).arg(result.value);
+        appendToLog(receivedData, false);
+    });
 }
 
-void MainWindow::readData()
+void MainWindow::logStore(quint32 address, quint8 flags, quint32 value)
 {
-    if (!serialPort || !serialPort->isOpen()) {
+    scheduleMemoryMapExport();
+
+    // Per-frame logging would dominate a stream; the panel reports progress instead
+    if (streamer->isActive()) {
         return;
     }
 
-    // Accumulate received bytes
-    receiveBuffer += serialPort->readAll();
-
-    // Process data based on buffer content
-    while (!receiveBuffer.isEmpty()) {
-        // Sw instruction
-        if (receiveBuffer.size() >= 10) {
-            // Try to process as 32-bit data first
-            QByteArray chunk = receiveBuffer.left(4);
-
-            // Convert from little-endian bytes to 32-bit integer
-            quint32 Address = (quint32)((unsigned char)chunk[0]) |
-                              ((quint32)((unsigned char)chunk[1]) << 8) |
-                              ((quint32)((unsigned char)chunk[2]) << 16) |
-                              ((quint32)((unsigned char)chunk[3]) << 24);
-
-            receiveBuffer.remove(0, 4);
-            QString receivedData = QString("Address: 0x%1 (%2)").arg(Address, 8, 16, QChar('0')).arg(Address);
-            appendToLog(receivedData, false);
-
-            quint32 readWriteValue = (quint8)receiveBuffer[0];
-            receiveBuffer.remove(0, 1);
-            if(readWriteValue==65){
-                appendToLog("Read/Write:Write", false);
-            } else {
-                appendToLog("Read/Write:Read", false);
-            }
-
+    appendToLog(QString("Address: 0x%1 (%2)").arg(address, 8, 16, QChar('0')).arg(address), false);
+    appendToLog(flags == UartProtocol::WriteFlag ? "Read/Write:Write" : "Read/Write:Read", false);
+    appendToLog(QString("Data Value: 0x%1 (%2)").arg(value, 8, 16, QChar('0')).arg(value), false);
+}
 
-            chunk = receiveBuffer.left(4);
+void MainWindow::logLoad(quint32 address, quint8 size, quint32 value)
+{
+    if (streamer->isActive()) {
+        return;
+    }
 
-            // Convert from little-endian bytes to 32-bit integer
-            quint32 dataValue = (quint32)((unsigned char)chunk[0]) |
-                                ((quint32)((unsigned char)chunk[1]) << 8) |
-                                ((quint32)((unsigned char)chunk[2]) << 16) |
-                                ((quint32)((unsigned char)chunk[3]) << 24);
+    appendToLog(QString("Address: 0x%1 (%2)").arg(address, 8, 16, QChar('0')).arg(address), false);
+    appendToLog(QString("Size: 0x%1 (%2)").arg(size, 2, 16, QChar('0')).arg(size), false);
+    appendToLog(QString("Sent data value: 0x%1 for address: 0x%2")
+                    .arg(value, 8, 16, QChar('0'))
+                    .arg(address, 8, 16, QChar('0')), true);
+}
 
-            receiveBuffer.remove(0, 4);
-            receivedData = QString("Data Value: 0x%1 (%2)").arg(dataValue, 8, 16, QChar('0')).arg(dataValue);
-            appendToLog(receivedData, false);
+void MainWindow::logCpuReady()
+{
+    if (streamer->isActive()) {
+        return;
+    }
 
-            // Write to CSV - address and data value only
-            writeToCsv(Address, dataValue);
-        }
-        // lw instruction
-        if (receiveBuffer.size() >= 4) {
-            if (PC_counter) { //Program counter Request
-                // Try to process as 32-bit data first
-                QByteArray chunk = receiveBuffer.left(4);
-
-                // Convert from little-endian bytes to 32-bit integer
-                quint32 value = (quint32)((unsigned char)chunk[0]) |
-                                ((quint32)((unsigned char)chunk[1]) << 8) |
-                                ((quint32)((unsigned char)chunk[2]) << 16) |
-                                ((quint32)((unsigned char)chunk[3]) << 24);
-
-                receiveBuffer.remove(0, 4);
-                QString receivedData = QString("Program counter: 0x%1 (%2)").arg(value, 8, 16, QChar('0')).arg(value);
-                appendToLog(receivedData, false);
-                PC_counter=false;
-                continue; // Continue processing next chunk
-            } else
-                {
-                QByteArray chunk = receiveBuffer.left(4);
-
-                // Convert from little-endian bytes to 32-bit integer
-                quint32 address = (quint32)((unsigned char)chunk[0]) |
-                                ((quint32)((unsigned char)chunk[1]) << 8) |
-                                ((quint32)((unsigned char)chunk[2]) << 16) |
-                                ((quint32)((unsigned char)chunk[3]) << 24);
-
-
-                receiveBuffer.remove(0, 4);
-                QString receivedData = QString("Address: 0x%1 (%2)").arg(address, 8, 16, QChar('0')).arg(address);
-                appendToLog(receivedData, false);
-
-                // Read value from CSV and send it back
-                quint32 dataValue = readFromCsv(address);
-
-                // Send the data value back through serial port
-                QByteArray responseData;
-                responseData.resize(4);
-                responseData[0] = (dataValue >> 0) & 0xFF;   // LSB
-                responseData[1] = (dataValue >> 8) & 0xFF;
-                responseData[2] = (dataValue >> 16) & 0xFF;
-                responseData[3] = (dataValue >> 24) & 0xFF;  // MSB
-
-                quint32  size = (quint8)receiveBuffer[0];
-                receiveBuffer.remove(0, 1);
-
-                receivedData = QString("Size: 0x%1 (%2)").arg(size, 2, 16, QChar('0')).arg(size);
-                appendToLog(receivedData, false);
-                serialPort->write(responseData);
-
-                QString responseLog = QString("Sent data value: 0x%1 for address: 0x%2")
-                                          .arg(dataValue, 8, 16, QChar('0'))
-                                          .arg(address, 8, 16, QChar('0'));
-                appendToLog(responseLog, true);
-                }
-        }
+    appendToLog(QString("8-bit: 0x%1 (%2)").arg(UartProtocol::CpuReady, 2, 16, QChar('0')).arg(UartProtocol::CpuReady), false);
+    appendToLog("*** CPU Ready Confirmation received ***", false);
+}
 
+void MainWindow::logProtocolError(const QString& message)
+{
+    appendToLog(message, false);
+}
 
+void MainWindow::logHang(const QString& operation, int deadlineMs)
+{
+    // Logged even while streaming: recoveries are rare and worth seeing
+    appendToLog(QString("*** Watchdog: no CPU_READY for %1 within %2 ms, resetting ***").arg(operation).arg(deadlineMs),
+                false);
+}
 
-        // If we get here, process as 8-bit data
-        quint8 value = (quint8)receiveBuffer[0];
-        receiveBuffer.remove(0, 1);
+void MainWindow::logRecovery(int resetAttempts)
+{
+    appendToLog(QString("*** Watchdog: core ready again after %1 reset(s), resuming (recovery #%2) ***")
+                    .arg(resetAttempts).arg(session->recoveryCount()), false);
+}
 
-        QString receivedData = QString("8-bit: 0x%1 (%2)").arg(value, 2, 16, QChar('0')).arg(value);
-        appendToLog(receivedData, false);
+void MainWindow::logRecoveryFailure(const QString& message)
+{
+    appendToLog(QString("*** Watchdog: %1 ***").arg(message), false);
+    QMessageBox::critical(this, "Core Not Responding", message);
+}
 
-        // Special handling for reset confirmation (8'b1 = 0x01)
-        if (value == 0x01) {
-            appendToLog("*** CPU Ready Confirmation received ***", false);
+void MainWindow::logConsole(const QString& line)
+{
+    appendToLog(QString("Console: %1").arg(line), false);
+}
 
-        }
-    }
+void MainWindow::logExit(quint32 code)
+{
+    appendToLog(code == 0 ? QString("*** Program exited: pass ***")
+                          : QString("*** Program exited with code %1 ***").arg(code), false);
 }
 
 void MainWindow::appendToLog(const QString &data, bool isSent)
 {
+    TRACE_ZONE("gui.appendToLog");
     QDateTime timestamp = QDateTime::currentDateTime();
     QString timeStr = timestamp.toString("hh:mm:ss.zzz");
 
@@ -487,50 +890,3 @@ void MainWindow::clearLog()
 {
     ui->logTextEdit->clear();
 }
-
-quint32 MainWindow::readFromCsv(quint32 address)
-{
-    if (!csvFile.isOpen()) {
-        qDebug() << "CSV file not open!";
-        return 0;
-    }
-
-    // Calculate target row (address / 4)
-    int targetRow = address / 4;
-
-    // Read current file content
-    csvFile.close();
-
-    quint32 dataValue = 0;
-
-    if (csvFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&csvFile);
-        int currentRow = 0;
-
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-
-            // Skip header row and check if we're at the target row
-            if (currentRow == targetRow + 1 && currentRow > 0) {
-                // Parse the hex value
-                bool ok;
-                dataValue = line.toUInt(&ok, 16);
-                if (!ok) {
-                    qDebug() << "Failed to parse CSV value:" << line;
-                    dataValue = 0;
-                }
-                break;
-            }
-            currentRow++;
-        }
-        csvFile.close();
-
-        // Reopen for writing if needed later
-        csvFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Append);
-    }
-
-    qDebug() << "Read from CSV - Address:" << QString("0x%1").arg(address, 8, 16, QChar('0'))
-             << "-> Row:" << (targetRow + 1) << "Data:" << QString("0x%1").arg(dataValue, 8, 16, QChar('0'));
-
-    return dataValue;
-}
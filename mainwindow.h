@@ -3,11 +3,28 @@
 
 #include <QMainWindow>
 #include <QSerialPort>
-#include <QSerialPortInfo>
+#include <QAbstractSocket>
 #include <QFile>
 #include <QTextStream>
+#include <QTimer>
+#include <memory>
 #include "riscvmachinecodeconverter.h"
+#include "riscvsession.h"
+#include "transport.h"
+#include "portwatcher.h"
+#include "hostmemory.h"
+#include "memorymap.h"
+#include "referencemodel.h"
+#include "metricsserver.h"
+#include "sessionmetrics.h"
+#include "instructionstreamer.h"
 #include "assemblyloader.h"  // Add this include
+#include "instructioncoverage.h"
+#include "coveragepanel.h"
+#include "instructiongenerator.h"
+#include "generatorpanel.h"
+#include "memoryinspector.h"
+#include "registerpanel.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -24,31 +41,84 @@ public:
     ~MainWindow();
 
 private slots:
-    void refreshSerialPorts();
-    void connectSerialPort();
-    void disconnectSerialPort();
+    void refreshPorts();
+    void addPort(const Transport& port);
+    void removePort(const Transport& port);
+    void connectPort();
+    void disconnectPort();
     void handleSerialError(QSerialPort::SerialPortError error);
+    void handleSocketError(QAbstractSocket::SocketError error);
     void sendData();
-    void readData();
     void clearLog();
     void getPC();
     void openAssemblyLoader();  // Add this slot
     void handleInstructionFromLoader(const QString& instruction);  // Add this slot
-    quint32 readFromCsv(quint32 address);  // Add this line
+    void runAssembly(const QVector<quint32>& words, int firstIndex);
+    void openCoveragePanel();
+    void openGeneratorPanel();
+    void openMemoryInspector();
+    void openRegisterPanel();
+    void registerDumpFinished(bool ok, const QString& errorMessage);
+    void startRandomStream(const InstructionGenerator::Constraints& constraints, quint64 seed, quint64 count);
+    void stopStream();
+    void streamFinished(bool ok, const QString& errorMessage);
+    void reportStreamProgress();
+    void logStore(quint32 address, quint8 flags, quint32 value);
+    void logLoad(quint32 address, quint8 size, quint32 value);
+    void logCpuReady();
+    void logProtocolError(const QString& message);
+    void logHang(const QString& operation, int deadlineMs);
+    void logRecovery(int resetAttempts);
+    void logRecoveryFailure(const QString& message);
+    void logConsole(const QString& line);
+    void logExit(quint32 code);
+    void exportMemoryMap();
+    void saveCheckpoint();
+    void restoreCheckpoint();
+    void preloadData();
+    void toggleTracing(bool enabled);
+    void toggleWaveform(bool enabled);
 
 private:
     Ui::MainWindow *ui;
-    QSerialPort *serialPort;
-    QByteArray receiveBuffer;
+    QIODevice *device;              // open while connected, whatever the transport
+    Transport transport;
+    PortWatcher portWatcher;
+    QString reconnectAddress;       // serial port to reconnect to when it comes back
     RiscVMachineCodeConverter riscvConverter;
-    QFile csvFile;
-    QTextStream csvStream;
+    HostMemory memory;
+    MemoryMap devices;
+    VcdWriter waveform;
+    ReferenceModel reference;
+    MetricsRegistry metrics;
+    SessionMetrics sessionMetrics;
+    MetricsServer *metricsServer;
+    RiscVSession *session;
+    InstructionStreamer *streamer;
+    QString csvFilePath;
+    QTimer csvExportTimer;
     AssemblyLoader *assemblyLoader;  // Add this member
-    bool PC_counter;
+    InstructionCoverage coverage;
+    CoveragePanel *coveragePanel;
+    GeneratorPanel *generatorPanel;
+    MemoryInspector *memoryInspector;
+    RegisterPanel *registerPanel;
+    std::unique_ptr<InstructionGenerator> generator;
+    InstructionListSource programSource;
+    int programFirstIndex;          // first loader instruction being streamed, -1 otherwise
+    QTimer streamProgressTimer;
+    bool isConnected() const { return device && device->isOpen(); }
+    bool openConnection(QString& errorMessage);
+    void boardLost(const QString& reason);
     void updateStatus(const QString &message, bool isConnected = false);
     void appendToLog(const QString &data, bool isSent = false);
-    void writeToCsv(quint32 address, quint32 dataValue); // Simplified method
     void initializeCsvFile();
+    void startMetricsServer();
+    void scheduleMemoryMapExport();
+    void startStream(InstructionSource *source, quint64 limit, const BreakpointSet *breakpoints = nullptr,
+                     quint32 firstAddress = 0);
+
+    static const quint16 DefaultMetricsPort = 9464;
 };
 
 #endif // MAINWINDOW_H
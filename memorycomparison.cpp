@@ -0,0 +1,167 @@
+#include "memorycomparison.h"
+#include "programrunner.h"
+#include "sessioncheckpoint.h"
+#include "tracing.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MEMORYCOMPARISON_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+const int PageWords = HostMemory::PageWords;
+const int BlockWords = 16;      // 64 bytes per step
+
+// Index of the first word at or after `from` where the pages differ, or PageWords
+int firstDifference(const quint32 *a, const quint32 *b, int from)
+{
+    int i = from;
+    while (i < PageWords && i % BlockWords != 0) {
+        if (a[i] != b[i]) {
+            return i;
+        }
+        i++;
+    }
+
+    // Whole blocks while they match; the scalar loop below finds the word
+#if defined(MEMORYCOMPARISON_SSE2)
+    for (; i < PageWords; i += BlockWords) {
+        const __m128i *x = reinterpret_cast<const __m128i *>(a + i);
+        const __m128i *y = reinterpret_cast<const __m128i *>(b + i);
+        const __m128i low = _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(x), _mm_loadu_si128(y)),
+                                          _mm_cmpeq_epi32(_mm_loadu_si128(x + 1), _mm_loadu_si128(y + 1)));
+        const __m128i high = _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(x + 2), _mm_loadu_si128(y + 2)),
+                                           _mm_cmpeq_epi32(_mm_loadu_si128(x + 3), _mm_loadu_si128(y + 3)));
+        if (_mm_movemask_epi8(_mm_and_si128(low, high)) != 0xFFFF) {
+            break;
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; i < PageWords; i += BlockWords) {
+        const uint32x4_t low = vandq_u32(vceqq_u32(vld1q_u32(a + i), vld1q_u32(b + i)),
+                                         vceqq_u32(vld1q_u32(a + i + 4), vld1q_u32(b + i + 4)));
+        const uint32x4_t high = vandq_u32(vceqq_u32(vld1q_u32(a + i + 8), vld1q_u32(b + i + 8)),
+                                          vceqq_u32(vld1q_u32(a + i + 12), vld1q_u32(b + i + 12)));
+        const uint32x4_t equal = vandq_u32(low, high);
+        const uint32x2_t folded = vand_u32(vget_low_u32(equal), vget_high_u32(equal));
+        if ((vget_lane_u32(folded, 0) & vget_lane_u32(folded, 1)) != 0xFFFFFFFFu) {
+            break;
+        }
+    }
+#endif
+
+    for (; i < PageWords; i++) {
+        if (a[i] != b[i]) {
+            return i;
+        }
+    }
+    return PageWords;
+}
+
+}
+
+void MemoryComparison::addRange(quint32 address, quint32 words, int maxRanges)
+{
+    differingWords += words;
+    if (!ranges.isEmpty()) {
+        MemoryRange& last = ranges.last();
+        if (last.address + last.words * 4 == address) {
+            last.words += words;
+            return;
+        }
+    }
+    if (ranges.size() >= maxRanges) {
+        truncated = true;
+        return;
+    }
+    ranges.append({address, words});
+}
+
+void MemoryComparison::comparePage(quint32 pageIndex, const quint32 *actual, const quint32 *expected, int maxRanges)
+{
+    pagesCompared++;
+    const quint32 base = pageIndex << HostMemory::PageBits;
+    int i = firstDifference(actual, expected, 0);
+    while (i < PageWords) {
+        int end = i + 1;
+        while (end < PageWords && actual[end] != expected[end]) {
+            end++;
+        }
+        addRange(base + quint32(i) * 4, quint32(end - i), maxRanges);
+        i = firstDifference(actual, expected, end);
+    }
+}
+
+MemoryComparison MemoryComparison::compare(const HostMemory& actual, const HostMemory& expected, int maxRanges)
+{
+    TRACE_ZONE("memory.compare");
+    static const quint32 zeros[PageWords] = {};
+    const int tableSize = 1 << HostMemory::TableBits;
+    MemoryComparison result;
+
+    for (quint32 top = 0; top < actual.directory.size(); top++) {
+        const HostMemory::PageTable *actualTable = actual.directory[top].get();
+        const HostMemory::PageTable *expectedTable = expected.directory[top].get();
+        if (actualTable == expectedTable) {
+            // Both empty, or a table neither side has written to since they were copied
+            if (actualTable) {
+                for (const auto& page : actualTable->pages) {
+                    result.pagesSkipped += page ? 1 : 0;
+                }
+            }
+            continue;
+        }
+
+        for (int low = 0; low < tableSize; low++) {
+            const HostMemory::Page *actualPage = actualTable ? actualTable->pages[low].get() : nullptr;
+            const HostMemory::Page *expectedPage = expectedTable ? expectedTable->pages[low].get() : nullptr;
+            if (actualPage == expectedPage) {
+                result.pagesSkipped += actualPage ? 1 : 0;
+                continue;
+            }
+
+            // A missing page reads as zeros, whose digest is 0
+            const quint64 actualDigest = actualPage ? actualPage->digest : 0;
+            const quint64 expectedDigest = expectedPage ? expectedPage->digest : 0;
+            if (actualDigest == expectedDigest) {
+                result.pagesSkipped++;
+                continue;
+            }
+
+            result.comparePage((top << HostMemory::TableBits) | quint32(low),
+                               actualPage ? actualPage->words : zeros,
+                               expectedPage ? expectedPage->words : zeros, maxRanges);
+        }
+    }
+    return result;
+}
+
+bool MemoryComparison::loadImage(const QString& fileName, HostMemory& image, QString& errorMessage)
+{
+    image.clear();
+    if (SessionCheckpoint::isCheckpointFile(fileName)) {
+        SessionCheckpoint checkpoint;
+        if (!checkpoint.load(fileName, errorMessage)) {
+            return false;
+        }
+        image = checkpoint.memory;
+        return true;
+    }
+
+    QVector<MemoryExpectation> words;
+    if (!ProgramRunner::loadExpectedMemory(fileName, words, errorMessage)) {
+        return false;
+    }
+    for (const MemoryExpectation& word : words) {
+        image.writeWord(word.address, word.value);
+    }
+    return true;
+}
+
+QString MemoryComparison::describe(const MemoryRange& range)
+{
+    return QString("0x%1 (%2 word%3)").arg(range.address, 8, 16, QChar('0'))
+                                      .arg(range.words).arg(range.words == 1 ? "" : "s");
+}
@@ -0,0 +1,43 @@
+#ifndef MEMORYCOMPARISON_H
+#define MEMORYCOMPARISON_H
+
+#include <QString>
+#include <QVector>
+#include "hostmemory.h"
+
+struct MemoryRange {
+    quint32 address = 0;    // first differing word
+    quint32 words = 0;
+};
+
+// Difference between two memory images, as ranges of consecutive words.
+//
+// Pages are walked in address order and most are never read: pages (and
+// whole tables) still shared between copy-on-write copies are skipped by
+// pointer, and pages whose running digests match are skipped by hash. Only
+// pages that really differ are compared with SIMD, 64 bytes at a time,
+// against the other image's page or zeros, to find the differing words.
+struct MemoryComparison {
+    QVector<MemoryRange> ranges;    // ascending, adjacent ranges merged
+    quint64 differingWords = 0;
+    bool truncated = false;         // more ranges than asked for; differingWords still counts all
+    int pagesCompared = 0;          // compared word by word
+    int pagesSkipped = 0;           // shared, or equal by digest
+
+    bool identical() const { return differingWords == 0; }
+
+    static MemoryComparison compare(const HostMemory& actual, const HostMemory& expected, int maxRanges = 256);
+
+    // A session checkpoint (its host memory), memory_map.csv, or
+    // "address value" lines as accepted by ProgramRunner::loadExpectedMemory
+    static bool loadImage(const QString& fileName, HostMemory& image, QString& errorMessage);
+
+    // "0x00001000 (4 words)", for logs and failure messages
+    static QString describe(const MemoryRange& range);
+
+private:
+    void addRange(quint32 address, quint32 words, int maxRanges);
+    void comparePage(quint32 pageIndex, const quint32 *actual, const quint32 *expected, int maxRanges);
+};
+
+#endif // MEMORYCOMPARISON_H
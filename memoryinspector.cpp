@@ -0,0 +1,153 @@
+#include "memoryinspector.h"
+#include "ui_memoryinspector.h"
+#include <QFileDialog>
+#include <QFontDatabase>
+#include <QHeaderView>
+#include <QMessageBox>
+
+MemoryInspector::MemoryInspector(const HostMemory *memory, QWidget *parent)
+    : QDockWidget(parent)
+    , ui(new Ui::MemoryInspector)
+    , memory(memory)
+    , model(new MemoryTableModel(memory, this))
+    , latestWrite(0)
+{
+    ui->setupUi(this);
+
+    ui->memoryView->setModel(model);
+    ui->memoryView->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    // Fixed row heights keep scrolling independent of the row count
+    QHeaderView *rows = ui->memoryView->verticalHeader();
+    rows->setSectionResizeMode(QHeaderView::Fixed);
+    rows->setDefaultSectionSize(ui->memoryView->fontMetrics().height() + 4);
+    rows->hide();
+    ui->memoryView->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    ui->memoryView->horizontalHeader()->setStretchLastSection(true);
+    ui->memoryView->resizeColumnToContents(MemoryTableModel::AddressColumn);
+
+    connect(ui->goButton, &QPushButton::clicked, this, &MemoryInspector::jumpToAddress);
+    connect(ui->addressEdit, &QLineEdit::returnPressed, this, &MemoryInspector::jumpToAddress);
+    connect(ui->compareButton, &QPushButton::clicked, this, &MemoryInspector::compareWithImage);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &MemoryInspector::updateStatus);
+    connect(model, &QAbstractItemModel::modelReset, this, &MemoryInspector::updateStatus);
+
+    // Following is throttled like the model's own updates
+    followTimer.setSingleShot(true);
+    followTimer.setInterval(100);
+    connect(&followTimer, &QTimer::timeout, this, &MemoryInspector::followLatestWrite);
+
+    updateStatus();
+}
+
+MemoryInspector::~MemoryInspector()
+{
+    delete ui;
+}
+
+void MemoryInspector::noteWrite(quint32 address)
+{
+    model->noteWrite(address);
+    latestWrite = address;
+    if (ui->followCheckBox->isChecked() && isVisible() && !followTimer.isActive()) {
+        followTimer.start();
+    }
+}
+
+void MemoryInspector::reload()
+{
+    model->reload();
+}
+
+void MemoryInspector::followLatestWrite()
+{
+    bool exact;
+    int row = model->rowForAddress(latestWrite, &exact);
+    if (exact) {
+        showRow(row);
+    } else {
+        // The page only gets rows on the model's next flush
+        followTimer.start();
+    }
+}
+
+void MemoryInspector::jumpToAddress()
+{
+    QString text = ui->addressEdit->text().trimmed();
+    if (text.startsWith("0x", Qt::CaseInsensitive)) {
+        text = text.mid(2);
+    }
+
+    bool ok;
+    const quint32 address = text.toUInt(&ok, 16);
+    if (!ok) {
+        ui->statusLabel->setText(QString("'%1' is not a hex address").arg(ui->addressEdit->text()));
+        return;
+    }
+
+    bool exact;
+    const int row = model->rowForAddress(address, &exact);
+    if (row < 0) {
+        ui->statusLabel->setText(QString("Nothing written at or after 0x%1").arg(address, 8, 16, QChar('0')));
+        return;
+    }
+    showRow(row);
+    if (!exact) {
+        ui->statusLabel->setText(QString("0x%1 was never written (reads as 0); showing the next written page")
+                                     .arg(address, 8, 16, QChar('0')));
+    } else {
+        updateStatus();
+    }
+}
+
+void MemoryInspector::showRow(int row)
+{
+    const QModelIndex index = model->index(row, MemoryTableModel::HexColumn);
+    ui->memoryView->scrollTo(index, QAbstractItemView::PositionAtCenter);
+    ui->memoryView->setCurrentIndex(index);
+}
+
+void MemoryInspector::updateStatus()
+{
+    if (memory->touchedPageCount() == 0) {
+        ui->statusLabel->setText("No memory written yet");
+        return;
+    }
+    ui->statusLabel->setText(QString("%1 written page(s), %2 words shown")
+                                 .arg(memory->touchedPageCount())
+                                 .arg(model->rowCount()));
+}
+
+void MemoryInspector::compareWithImage()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, "Compare With Image", QString(),
+                                                          "Memory images (*.rvcp *.csv *.txt *.expected);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    HostMemory image;
+    QString errorMessage;
+    if (!MemoryComparison::loadImage(fileName, image, errorMessage)) {
+        QMessageBox::warning(this, "Compare With Image", errorMessage);
+        return;
+    }
+
+    const MemoryComparison comparison = MemoryComparison::compare(*memory, image, MaxHighlightedRanges);
+    model->setMismatches(comparison.ranges);
+    if (comparison.identical()) {
+        ui->statusLabel->setText("Memory matches the image");
+        return;
+    }
+
+    // Differences in pages the core never wrote have no rows to show
+    const int row = model->rowForAddress(comparison.ranges.first().address);
+    if (row >= 0) {
+        showRow(row);
+    }
+    ui->statusLabel->setText(QString("%1 word(s) differ in %2%3 range(s), first at %4")
+                                 .arg(comparison.differingWords)
+                                 .arg(comparison.truncated ? "over " : "")
+                                 .arg(comparison.ranges.size())
+                                 .arg(MemoryComparison::describe(comparison.ranges.first())));
+}
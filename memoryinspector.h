@@ -0,0 +1,46 @@
+#ifndef MEMORYINSPECTOR_H
+#define MEMORYINSPECTOR_H
+
+#include <QDockWidget>
+#include <QTimer>
+#include "memorytablemodel.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+class MemoryInspector;
+}
+QT_END_NAMESPACE
+
+// Dockable live view of the host memory model: every touched word with
+// hex, decimal, ASCII and disassembly, jump-to-address, highlighting of
+// the latest stores and of differences from an expected image.
+class MemoryInspector : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MemoryInspector(const HostMemory *memory, QWidget *parent = nullptr);
+    ~MemoryInspector();
+
+    void noteWrite(quint32 address);
+    void reload();
+
+private slots:
+    void jumpToAddress();
+    void followLatestWrite();
+    void updateStatus();
+    void compareWithImage();
+
+private:
+    static const int MaxHighlightedRanges = 4096;
+
+    void showRow(int row);
+
+    Ui::MemoryInspector *ui;
+    const HostMemory *memory;
+    MemoryTableModel *model;
+    quint32 latestWrite;
+    QTimer followTimer;
+};
+
+#endif // MEMORYINSPECTOR_H
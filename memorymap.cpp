@@ -0,0 +1,172 @@
+#include "memorymap.h"
+
+namespace {
+
+const quint32 DefaultBase = 0xFFFF0000;
+
+}
+
+MemoryMap::MemoryMap(QObject *parent)
+    : QObject(parent)
+    , latchedMicroseconds(0)
+    , exited(false)
+    , code(0)
+    , fifoDropped(0)
+{
+    clock.start();
+}
+
+MemoryMap::~MemoryMap()
+{
+}
+
+QVector<MemoryMap::Region> MemoryMap::defaultLayout()
+{
+    QVector<Region> layout;
+    for (Device device : {Console, Timer, Exit, Fifo}) {
+        Region region;
+        region.device = device;
+        region.base = DefaultBase + quint32(device) * HostMemory::PageSize;
+        layout.append(region);
+    }
+    return layout;
+}
+
+QString MemoryMap::deviceName(Device device)
+{
+    switch (device) {
+    case Console: return "console";
+    case Timer:   return "timer";
+    case Exit:    return "exit";
+    case Fifo:    return "fifo";
+    }
+    return QString();
+}
+
+bool MemoryMap::parse(const QString& spec, Region& region, QString& errorMessage)
+{
+    const int at = spec.indexOf('@');
+    const QString name = (at < 0 ? spec : spec.left(at)).trimmed().toLower();
+
+    bool known = false;
+    for (const Region& candidate : defaultLayout()) {
+        if (deviceName(candidate.device) == name) {
+            region = candidate;
+            known = true;
+        }
+    }
+    if (!known) {
+        errorMessage = QString("'%1': the device must be console, timer, exit or fifo").arg(spec);
+        return false;
+    }
+    if (at >= 0 && !HostMemory::parseAddress(spec.mid(at + 1).trimmed(), region.base)) {
+        errorMessage = QString("'%1': expected device@address").arg(spec);
+        return false;
+    }
+    return true;
+}
+
+bool MemoryMap::addRegion(const Region& region, QString& errorMessage)
+{
+    if (region.base & (HostMemory::PageSize - 1)) {
+        errorMessage = QString("%1 at 0x%2: devices must start on a 4 KiB boundary")
+                           .arg(deviceName(region.device)).arg(region.base, 8, 16, QChar('0'));
+        return false;
+    }
+    if (contains(region.base)) {
+        errorMessage = QString("%1 at 0x%2: the page is already mapped to %3")
+                           .arg(deviceName(region.device)).arg(region.base, 8, 16, QChar('0'))
+                           .arg(deviceName(regionAt(region.base).device));
+        return false;
+    }
+    if (mapped.size() >= 255) {
+        errorMessage = "Too many device regions";
+        return false;
+    }
+
+    const quint32 pageIndex = region.base >> HostMemory::PageBits;
+    std::unique_ptr<PageTable>& table = directory[pageIndex >> HostMemory::TableBits];
+    if (!table) {
+        table.reset(new PageTable());
+    }
+    mapped.append(region);
+    (*table)[pageIndex & ((1 << HostMemory::TableBits) - 1)] = quint8(mapped.size());
+    return true;
+}
+
+const MemoryMap::Region& MemoryMap::regionAt(quint32 address) const
+{
+    const quint32 pageIndex = address >> HostMemory::PageBits;
+    const PageTable& table = *directory[pageIndex >> HostMemory::TableBits];
+    return mapped[table[pageIndex & ((1 << HostMemory::TableBits) - 1)] - 1];
+}
+
+quint32 MemoryMap::load(quint32 address)
+{
+    const quint32 offset = address & (HostMemory::PageSize - 1) & ~quint32(3);
+    switch (regionAt(address).device) {
+    case Timer:
+        if (offset == 0) {
+            latchedMicroseconds = quint64(clock.nsecsElapsed() / 1000);
+            return quint32(latchedMicroseconds);
+        }
+        return offset == 4 ? quint32(latchedMicroseconds >> 32) : 0;
+    case Exit:
+        return offset == 0 ? code : 0;
+    case Fifo:
+        return offset == 4 ? quint32(fifo.size()) : 0;
+    case Console:
+        break;
+    }
+    return 0;
+}
+
+void MemoryMap::store(quint32 address, quint32 value)
+{
+    const quint32 offset = address & (HostMemory::PageSize - 1) & ~quint32(3);
+    if (offset != 0) {
+        return;
+    }
+
+    switch (regionAt(address).device) {
+    case Console: {
+        const char c = char(value & 0xFF);
+        if (console.size() < MaxConsoleBytes) {
+            console.append(c);
+        }
+        if (c == '\n') {
+            emit consoleLine(QString::fromUtf8(consoleLineBuffer));
+            consoleLineBuffer.clear();
+        } else if (consoleLineBuffer.size() < MaxConsoleBytes) {
+            consoleLineBuffer.append(c);
+        }
+        break;
+    }
+    case Exit:
+        exited = true;
+        code = value;
+        emit exitRequested(value);
+        break;
+    case Fifo:
+        if (fifo.size() < MaxFifoWords) {
+            fifo.append(value);
+        } else {
+            fifoDropped++;
+        }
+        break;
+    case Timer:
+        break;
+    }
+}
+
+void MemoryMap::reset()
+{
+    console.clear();
+    consoleLineBuffer.clear();
+    clock.restart();
+    latchedMicroseconds = 0;
+    exited = false;
+    code = 0;
+    fifo.clear();
+    fifoDropped = 0;
+}
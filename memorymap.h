@@ -0,0 +1,99 @@
+#ifndef MEMORYMAP_H
+#define MEMORYMAP_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QVector>
+#include <array>
+#include <memory>
+#include "hostmemory.h"
+
+// Host-side devices on the core's memory bus. The host serves every load and
+// store anyway, so an address range can be bound to a device instead of RAM
+// and a test can report its result with a single store.
+//
+// Each device takes one 4 KiB page; its registers are word offsets in it:
+//   console  +0  store: the low byte is output text, lines are emitted on '\n'
+//   timer    +0  load: microseconds since the run started, low word (latches)
+//            +4  load: high word of the value latched by the last low read
+//   exit     +0  store: ends the run; 0 passes, anything else is the failure code
+//   fifo     +0  store: appends the word to the result list
+//            +4  load: number of words appended so far
+// Other offsets read as zero and ignore stores.
+//
+// Lookup is one two-level table index per access, so plain RAM stays as fast
+// as with no devices mapped.
+class MemoryMap : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Device { Console, Timer, Exit, Fifo };
+
+    struct Region {
+        Device device = Console;
+        quint32 base = 0;
+    };
+
+    static const int MaxConsoleBytes = 1 << 16;
+    static const int MaxFifoWords = 1 << 16;
+
+    explicit MemoryMap(QObject *parent = nullptr);
+    ~MemoryMap();
+
+    // "device" or "device@address"; without an address the device goes at
+    // its place in defaultLayout()
+    static bool parse(const QString& spec, Region& region, QString& errorMessage);
+    // console, timer, exit and fifo on consecutive pages from 0xFFFF0000
+    static QVector<Region> defaultLayout();
+    static QString deviceName(Device device);
+
+    // The base must be page-aligned and the page not already mapped
+    bool addRegion(const Region& region, QString& errorMessage);
+    const QVector<Region>& regions() const { return mapped; }
+
+    bool contains(quint32 address) const
+    {
+        const quint32 pageIndex = address >> HostMemory::PageBits;
+        const PageTable *table = directory[pageIndex >> HostMemory::TableBits].get();
+        return table && (*table)[pageIndex & ((1 << HostMemory::TableBits) - 1)] != 0;
+    }
+
+    // Only for addresses contains() accepts
+    quint32 load(quint32 address);
+    void store(quint32 address, quint32 value);
+
+    // Clears what the devices collected and restarts the timer; once per run
+    void reset();
+
+    QByteArray consoleOutput() const { return console; }
+    bool hasExited() const { return exited; }
+    quint32 exitCode() const { return code; }
+    const QVector<quint32>& results() const { return fifo; }
+    quint64 droppedResults() const { return fifoDropped; }
+
+signals:
+    void consoleLine(const QString& line);
+    void exitRequested(quint32 code);
+
+private:
+    // One byte per page, 4 MiB per table: 0 for RAM, else region index + 1
+    using PageTable = std::array<quint8, 1 << HostMemory::TableBits>;
+
+    const Region& regionAt(quint32 address) const;
+
+    std::array<std::unique_ptr<PageTable>, 1 << (32 - HostMemory::PageBits - HostMemory::TableBits)> directory;
+    QVector<Region> mapped;
+
+    QByteArray console;
+    QByteArray consoleLineBuffer;
+    QElapsedTimer clock;
+    quint64 latchedMicroseconds;
+    bool exited;
+    quint32 code;
+    QVector<quint32> fifo;
+    quint64 fifoDropped;
+};
+
+#endif // MEMORYMAP_H
@@ -0,0 +1,236 @@
+#include "memorypreload.h"
+#include "programrunner.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+namespace {
+
+const quint64 AddressSpace = quint64(1) << 32;
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+}
+
+bool MemoryPreload::parse(const QString& spec, MemoryPreload& preload, QString& errorMessage)
+{
+    const int at = spec.lastIndexOf('@');
+    preload.fileName = at < 0 ? spec : spec.left(at);
+    preload.base = 0;
+    if (at >= 0 && !HostMemory::parseAddress(spec.mid(at + 1).trimmed(), preload.base)) {
+        errorMessage = QString("'%1': expected file@address").arg(spec);
+        return false;
+    }
+    if (preload.fileName.isEmpty() || (preload.base & 3) != 0) {
+        errorMessage = QString("'%1': a file and a word-aligned address are required").arg(spec);
+        return false;
+    }
+    return true;
+}
+
+QString MemoryPreload::describe() const
+{
+    return QString("%1 at 0x%2").arg(QFileInfo(fileName).fileName()).arg(base, 8, 16, QChar('0'));
+}
+
+bool MemoryPreload::load(HostMemory& memory, QString& errorMessage, quint64 *wordCount) const
+{
+    quint64 words = 0;
+    bool ok;
+    if (fileName.endsWith(".bin", Qt::CaseInsensitive)) {
+        ok = loadBinary(memory, errorMessage, words);
+    } else {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            errorMessage = QString("Could not open %1: %2").arg(fileName, file.errorString());
+            return false;
+        }
+        const QByteArray text = file.readAll();
+        if (text.trimmed().startsWith(':')) {
+            ok = loadIntelHex(text, memory, errorMessage, words);
+        } else if (fileName.endsWith(".hex", Qt::CaseInsensitive)) {
+            ok = loadHexWords(text, memory, errorMessage, words);
+        } else {
+            ok = loadWordList(memory, errorMessage, words);
+        }
+    }
+
+    if (ok && wordCount) {
+        *wordCount = words;
+    }
+    return ok;
+}
+
+bool MemoryPreload::loadBinary(HostMemory& memory, QString& errorMessage, quint64& wordCount) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    if (quint64(base) + quint64(file.size()) > AddressSpace) {
+        errorMessage = QString("%1 (%2 bytes) does not fit above 0x%3")
+                           .arg(fileName).arg(file.size()).arg(base, 8, 16, QChar('0'));
+        return false;
+    }
+
+    // A page at a time; a short last word is padded with zeros
+    QByteArray chunk;
+    quint32 words[HostMemory::PageWords];
+    quint32 address = base;
+    while (!file.atEnd()) {
+        chunk = file.read(HostMemory::PageSize);
+        if (chunk.isEmpty()) {
+            errorMessage = QString("Failed to read %1: %2").arg(fileName, file.errorString());
+            return false;
+        }
+        const int count = (chunk.size() + 3) / 4;
+        chunk.append(QByteArray(count * 4 - chunk.size(), '\0'));
+        for (int i = 0; i < count; i++) {
+            words[i] = qFromLittleEndian<quint32>(chunk.constData() + i * 4);
+        }
+        memory.writeWords(address, words, quint32(count));
+        address += quint32(count) * 4;
+        wordCount += quint32(count);
+    }
+    return true;
+}
+
+bool MemoryPreload::loadIntelHex(const QByteArray& text, HostMemory& memory, QString& errorMessage,
+                                 quint64& wordCount) const
+{
+    quint32 upper = 0;          // from extended segment / linear address records
+    quint64 bytes = 0;
+    int lineNumber = 0;
+
+    for (QByteArray line : text.split('\n')) {
+        lineNumber++;
+        line = line.trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        // :LLAAAATT<data>CC, checked by summing every byte to zero
+        QByteArray record;
+        bool valid = line.startsWith(':') && line.size() % 2 == 1 && line.size() >= 11;
+        for (int i = 1; valid && i < line.size(); i += 2) {
+            const int high = hexDigit(line[i]);
+            const int low = hexDigit(line[i + 1]);
+            valid = high >= 0 && low >= 0;
+            record.append(char((high << 4) | low));
+        }
+        quint8 sum = 0;
+        for (char byte : record) {
+            sum += quint8(byte);
+        }
+        valid = valid && sum == 0 && record.size() == quint8(record[0]) + 5;
+        if (!valid) {
+            errorMessage = QString("%1:%2: malformed Intel HEX record").arg(fileName).arg(lineNumber);
+            return false;
+        }
+
+        const int length = quint8(record[0]);
+        const quint32 offset = (quint32(quint8(record[1])) << 8) | quint8(record[2]);
+        const quint8 type = quint8(record[3]);
+        const uchar *data = reinterpret_cast<const uchar *>(record.constData()) + 4;
+
+        if (type == 0x01) {
+            break;
+        } else if (type == 0x02 && length == 2) {
+            upper = ((quint32(data[0]) << 8) | data[1]) << 4;
+        } else if (type == 0x04 && length == 2) {
+            upper = ((quint32(data[0]) << 8) | data[1]) << 16;
+        } else if (type == 0x00) {
+            const quint64 start = quint64(base) + upper + offset;
+            if (start + length > AddressSpace) {
+                errorMessage = QString("%1:%2: data past the end of the address space").arg(fileName).arg(lineNumber);
+                return false;
+            }
+            for (int i = 0; i < length; i++) {
+                const quint32 address = quint32(start) + quint32(i);
+                const int shift = int(address & 3) * 8;
+                const quint32 word = memory.readWord(address);
+                memory.writeWord(address, (word & ~(0xFFu << shift)) | (quint32(data[i]) << shift));
+            }
+            bytes += length;
+        }
+        // Start address records (03, 05) mean nothing to the host
+    }
+
+    wordCount = (bytes + 3) / 4;
+    return true;
+}
+
+bool MemoryPreload::loadHexWords(const QByteArray& text, HostMemory& memory, QString& errorMessage,
+                                 quint64& wordCount) const
+{
+    quint64 offset = 0;         // in words from base
+    int lineNumber = 0;
+
+    for (QByteArray line : text.split('\n')) {
+        lineNumber++;
+        const int comment = line.indexOf("//");
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        const int hash = line.indexOf('#');
+        if (hash >= 0) {
+            line.truncate(hash);
+        }
+
+        for (const QByteArray& token : line.simplified().split(' ')) {
+            if (token.isEmpty()) {
+                continue;
+            }
+            bool ok;
+            if (token.startsWith('@')) {
+                offset = token.mid(1).toULongLong(&ok, 16);
+            } else {
+                const quint32 value = token.toUInt(&ok, 16);
+                const quint64 address = quint64(base) + offset * 4;
+                ok = ok && address < AddressSpace;
+                if (ok) {
+                    memory.writeWord(quint32(address), value);
+                    offset++;
+                    wordCount++;
+                }
+            }
+            if (!ok) {
+                errorMessage = QString("%1:%2: '%3' is not a hex word or @offset inside the address space")
+                                   .arg(fileName).arg(lineNumber).arg(QString::fromLatin1(token));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool MemoryPreload::loadWordList(HostMemory& memory, QString& errorMessage, quint64& wordCount) const
+{
+    QVector<MemoryExpectation> words;
+    if (!ProgramRunner::loadExpectedMemory(fileName, words, errorMessage)) {
+        return false;
+    }
+    for (const MemoryExpectation& word : words) {
+        if (quint64(base) + word.address >= AddressSpace) {
+            errorMessage = QString("%1: 0x%2 plus the base is past the end of the address space")
+                               .arg(fileName).arg(word.address, 8, 16, QChar('0'));
+            return false;
+        }
+        memory.writeWord(base + word.address, word.value);
+    }
+    wordCount = quint64(words.size());
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef MEMORYPRELOAD_H
+#define MEMORYPRELOAD_H
+
+#include <QByteArray>
+#include <QString>
+#include "hostmemory.h"
+
+// A data file mapped into the host memory model before a run, so lookup
+// tables and input data are there for the core's loads without a single
+// store going over the link.
+//
+// Formats, by content and suffix:
+//   *.bin   raw bytes, little-endian words from base
+//   Intel HEX (first line starts with ':'), record addresses offset by base
+//   *.hex   otherwise $readmemh style: hex words, "@offset" in words from base
+//   other   memory_map.csv layout or "address value" lines, offset by base
+struct MemoryPreload {
+    QString fileName;
+    quint32 base = 0;
+
+    // "file" or "file@address"; the address is hex with 0x or decimal
+    static bool parse(const QString& spec, MemoryPreload& preload, QString& errorMessage);
+
+    // Writes the file's contents into memory; wordCount, if given, receives
+    // how many words were written
+    bool load(HostMemory& memory, QString& errorMessage, quint64 *wordCount = nullptr) const;
+
+    QString describe() const;
+
+private:
+    bool loadBinary(HostMemory& memory, QString& errorMessage, quint64& wordCount) const;
+    bool loadIntelHex(const QByteArray& text, HostMemory& memory, QString& errorMessage, quint64& wordCount) const;
+    bool loadHexWords(const QByteArray& text, HostMemory& memory, QString& errorMessage, quint64& wordCount) const;
+    bool loadWordList(HostMemory& memory, QString& errorMessage, quint64& wordCount) const;
+};
+
+#endif // MEMORYPRELOAD_H
@@ -0,0 +1,234 @@
+#include "memorytablemodel.h"
+#include "riscvmachinecodeconverter.h"
+#include "tracing.h"
+#include <QColor>
+#include <algorithm>
+
+MemoryTableModel::MemoryTableModel(const HostMemory *memory, QObject *parent)
+    : QAbstractTableModel(parent)
+    , memory(memory)
+    , allPending(false)
+{
+    pages = memory->touchedPages();
+
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(FlushIntervalMs);
+    connect(&flushTimer, &QTimer::timeout, this, &MemoryTableModel::flush);
+}
+
+int MemoryTableModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : pages.size() * HostMemory::PageWords;
+}
+
+int MemoryTableModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+quint32 MemoryTableModel::addressForRow(int row) const
+{
+    return (pages[row / HostMemory::PageWords] << HostMemory::PageBits) | quint32(row % HostMemory::PageWords) * 4;
+}
+
+int MemoryTableModel::rowForAddress(quint32 address, bool *exact) const
+{
+    const quint32 page = address >> HostMemory::PageBits;
+    const int position = int(std::lower_bound(pages.begin(), pages.end(), page) - pages.begin());
+    if (exact) {
+        *exact = position < pages.size() && pages[position] == page;
+    }
+    if (position == pages.size()) {
+        return -1;
+    }
+    if (pages[position] != page) {
+        return position * HostMemory::PageWords;
+    }
+    return position * HostMemory::PageWords + int((address >> 2) & (HostMemory::PageWords - 1));
+}
+
+QVariant MemoryTableModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+
+    const quint32 address = addressForRow(index.row());
+
+    if (role == Qt::BackgroundRole) {
+        if (recentCount.contains(address >> 2)) {
+            return QColor(255, 236, 153);
+        }
+        return isMismatch(address) ? QVariant(QColor(255, 204, 204)) : QVariant();
+    }
+    if (role == Qt::TextAlignmentRole) {
+        return index.column() == DecimalColumn ? QVariant(Qt::AlignRight | Qt::AlignVCenter) : QVariant();
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    const quint32 value = memory->readWord(address);
+    switch (index.column()) {
+    case AddressColumn:
+        return QString("0x%1").arg(address, 8, 16, QChar('0'));
+    case HexColumn:
+        return QString("%1").arg(value, 8, 16, QChar('0'));
+    case DecimalColumn:
+        return QString::number(qint32(value));
+    case AsciiColumn: {
+        // Byte order as the core sees it: lowest address first
+        QString text;
+        for (int i = 0; i < 4; i++) {
+            const char byte = char((value >> (8 * i)) & 0xFF);
+            text += (byte >= 0x20 && byte < 0x7F) ? QChar(byte) : QChar('.');
+        }
+        return text;
+    }
+    case DisassemblyColumn:
+        return RiscVMachineCodeConverter::disassemble(value);
+    }
+    return QVariant();
+}
+
+QVariant MemoryTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+    case AddressColumn:     return "Address";
+    case HexColumn:         return "Hex";
+    case DecimalColumn:     return "Decimal";
+    case AsciiColumn:       return "ASCII";
+    case DisassemblyColumn: return "Disassembly";
+    }
+    return QVariant();
+}
+
+void MemoryTableModel::noteWrite(quint32 address)
+{
+    const quint32 word = address >> 2;
+    if (!allPending) {
+        if (pendingWords.size() >= MaxPendingWords) {
+            allPending = true;
+            pendingWords.clear();
+        } else {
+            pendingWords.append(word);
+        }
+    }
+
+    recentOrder.enqueue(word);
+    recentCount[word]++;
+    if (recentOrder.size() > RecentWrites) {
+        // The oldest write loses its highlight unless it was written again since
+        const quint32 expired = recentOrder.dequeue();
+        if (--recentCount[expired] == 0) {
+            recentCount.remove(expired);
+            if (!allPending) {
+                pendingWords.append(expired);
+            }
+        }
+    }
+
+    if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+}
+
+void MemoryTableModel::reload()
+{
+    flushTimer.stop();
+    beginResetModel();
+    pages = memory->touchedPages();
+    pendingWords.clear();
+    allPending = false;
+    recentOrder.clear();
+    recentCount.clear();
+    mismatches.clear();
+    endResetModel();
+}
+
+void MemoryTableModel::setMismatches(const QVector<MemoryRange>& ranges)
+{
+    mismatches = ranges;
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 0), index(rowCount() - 1, ColumnCount - 1), {Qt::BackgroundRole});
+    }
+}
+
+bool MemoryTableModel::isMismatch(quint32 address) const
+{
+    auto after = std::upper_bound(mismatches.begin(), mismatches.end(), address,
+                                  [](quint32 value, const MemoryRange& range) { return value < range.address; });
+    if (after == mismatches.begin()) {
+        return false;
+    }
+    const MemoryRange& range = *(after - 1);
+    return quint64(address - range.address) / 4 < range.words;
+}
+
+void MemoryTableModel::markRow(QVector<int>& rows, quint32 wordAddress) const
+{
+    const int row = rowForAddress(wordAddress << 2);
+    if (row >= 0 && addressForRow(row) == wordAddress << 2) {
+        rows.append(row);
+    }
+}
+
+void MemoryTableModel::flush()
+{
+    TRACE_ZONE("memoryView.flush");
+
+    // Pages only ever appear between reloads; insert rows for the new ones
+    if (memory->touchedPageCount() != pages.size()) {
+        const QVector<quint32> current = memory->touchedPages();
+        int position = 0;
+        for (quint32 page : current) {
+            while (position < pages.size() && pages[position] < page) {
+                position++;
+            }
+            if (position < pages.size() && pages[position] == page) {
+                position++;
+                continue;
+            }
+            const int firstRow = position * HostMemory::PageWords;
+            beginInsertRows(QModelIndex(), firstRow, firstRow + HostMemory::PageWords - 1);
+            pages.insert(position, page);
+            endInsertRows();
+            position++;
+        }
+        if (pages.size() != current.size()) {
+            reload();
+            return;
+        }
+    }
+
+    if (allPending) {
+        allPending = false;
+        if (rowCount() > 0) {
+            emit dataChanged(index(0, 0), index(rowCount() - 1, ColumnCount - 1));
+        }
+        return;
+    }
+
+    QVector<int> rows;
+    rows.reserve(pendingWords.size());
+    for (quint32 word : pendingWords) {
+        markRow(rows, word);
+    }
+    pendingWords.clear();
+    std::sort(rows.begin(), rows.end());
+
+    // One signal per run of adjacent rows
+    int i = 0;
+    while (i < rows.size()) {
+        int last = rows[i];
+        int j = i + 1;
+        while (j < rows.size() && rows[j] <= last + 1) {
+            last = rows[j++];
+        }
+        emit dataChanged(index(rows[i], 0), index(last, ColumnCount - 1));
+        i = j;
+    }
+}
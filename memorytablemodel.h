@@ -0,0 +1,72 @@
+#ifndef MEMORYTABLEMODEL_H
+#define MEMORYTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QQueue>
+#include <QTimer>
+#include <QVector>
+#include "hostmemory.h"
+#include "memorycomparison.h"
+
+// One row per word of every touched page of a HostMemory, read live on
+// demand: nothing is copied, so views scroll over millions of words at the
+// cost of the rows on screen. Untouched pages have no rows at all.
+//
+// Writes are reported with noteWrite() and applied in batches: new pages
+// become row insertions and changed words are coalesced into contiguous
+// dataChanged ranges. The most recent writes are highlighted.
+class MemoryTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column { AddressColumn, HexColumn, DecimalColumn, AsciiColumn, DisassemblyColumn, ColumnCount };
+
+    explicit MemoryTableModel(const HostMemory *memory, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Cheap; the view catches up on the next flush
+    void noteWrite(quint32 address);
+
+    // After the memory changed wholesale (restored, loaded, cleared); drops
+    // the mismatch highlights
+    void reload();
+
+    // Highlights words that differed from an expected image; empty clears
+    void setMismatches(const QVector<MemoryRange>& ranges);
+
+    quint32 addressForRow(int row) const;
+    // Row of the word at address, or of the first written word after it
+    // (exact is false then); -1 if nothing is written at or after it
+    int rowForAddress(quint32 address, bool *exact = nullptr) const;
+
+private slots:
+    void flush();
+
+private:
+    static const int RecentWrites = 32;
+    static const int MaxPendingWords = 4096;    // beyond this, refresh every row
+    static const int FlushIntervalMs = 50;
+
+    void markRow(QVector<int>& rows, quint32 wordAddress) const;
+    bool isMismatch(quint32 address) const;
+
+    const HostMemory *memory;
+    QVector<quint32> pages;             // sorted, what the rows currently show
+
+    QVector<quint32> pendingWords;      // word addresses (byte address >> 2)
+    bool allPending;
+    QTimer flushTimer;
+
+    QQueue<quint32> recentOrder;        // oldest first, may hold duplicates
+    QHash<quint32, int> recentCount;    // occurrences in recentOrder
+
+    QVector<MemoryRange> mismatches;    // ascending
+};
+
+#endif // MEMORYTABLEMODEL_H
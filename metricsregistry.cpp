@@ -0,0 +1,131 @@
+#include "metricsregistry.h"
+#include <QMutexLocker>
+#include <QSet>
+
+const std::array<quint64, MetricHistogram::BucketCount> MetricHistogram::BucketBoundsUs = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 5000000
+};
+
+void MetricHistogram::observeMicroseconds(quint64 microseconds)
+{
+    int bucket = 0;
+    while (bucket < BucketCount && microseconds > BucketBoundsUs[bucket]) {
+        bucket++;
+    }
+    // The overflow bucket is only implied by count
+    if (bucket < BucketCount) {
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(microseconds, std::memory_order_relaxed);
+}
+
+QString MetricsRegistry::label(const QString& name, const QString& value)
+{
+    QString escaped = value;
+    escaped.replace("\\", "\\\\");
+    escaped.replace("\"", "\\\"");
+    escaped.replace("\n", "\\n");
+    return QString("%1=\"%2\"").arg(name, escaped);
+}
+
+MetricsRegistry::Entry *MetricsRegistry::find(const QString& name, const QString& labels, Type type)
+{
+    for (const std::unique_ptr<Entry>& entry : entries) {
+        if (entry->name == name && entry->labels == labels && entry->type == type) {
+            return entry.get();
+        }
+    }
+    return nullptr;
+}
+
+MetricsRegistry::Entry *MetricsRegistry::add(const QString& name, const QString& help, const QString& labels, Type type)
+{
+    if (Entry *existing = find(name, labels, type)) {
+        return existing;
+    }
+
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->name = name;
+    entry->help = help;
+    entry->labels = labels;
+    entry->type = type;
+    switch (type) {
+    case Counter:   entry->counter.reset(new MetricCounter); break;
+    case Gauge:     entry->gauge.reset(new MetricGauge); break;
+    case Histogram: entry->histogram.reset(new MetricHistogram); break;
+    }
+    entries.push_back(std::move(entry));
+    return entries.back().get();
+}
+
+MetricCounter *MetricsRegistry::counter(const QString& name, const QString& help, const QString& labels)
+{
+    QMutexLocker locker(&mutex);
+    return add(name, help, labels, Counter)->counter.get();
+}
+
+MetricGauge *MetricsRegistry::gauge(const QString& name, const QString& help, const QString& labels)
+{
+    QMutexLocker locker(&mutex);
+    return add(name, help, labels, Gauge)->gauge.get();
+}
+
+MetricHistogram *MetricsRegistry::histogram(const QString& name, const QString& help, const QString& labels)
+{
+    QMutexLocker locker(&mutex);
+    return add(name, help, labels, Histogram)->histogram.get();
+}
+
+QByteArray MetricsRegistry::exposition() const
+{
+    static const char *const typeNames[] = { "counter", "gauge", "histogram" };
+
+    QMutexLocker locker(&mutex);
+    QString text;
+    QSet<QString> written;
+
+    for (const std::unique_ptr<Entry>& family : entries) {
+        if (written.contains(family->name)) {
+            continue;
+        }
+        written.insert(family->name);
+        text += QString("# HELP %1 %2\n").arg(family->name, family->help);
+        text += QString("# TYPE %1 %2\n").arg(family->name, typeNames[family->type]);
+
+        for (const std::unique_ptr<Entry>& entry : entries) {
+            if (entry->name != family->name) {
+                continue;
+            }
+            const QString braced = entry->labels.isEmpty() ? QString() : QString("{%1}").arg(entry->labels);
+            switch (entry->type) {
+            case Counter:
+                text += QString("%1%2 %3\n").arg(entry->name, braced).arg(entry->counter->value());
+                break;
+            case Gauge:
+                text += QString("%1%2 %3\n").arg(entry->name, braced).arg(entry->gauge->value());
+                break;
+            case Histogram: {
+                const MetricHistogram& histogram = *entry->histogram;
+                const QString prefix = entry->labels.isEmpty() ? QString() : entry->labels + ",";
+                quint64 cumulative = 0;
+                for (int i = 0; i < MetricHistogram::BucketCount; i++) {
+                    cumulative += histogram.bucketValue(i);
+                    text += QString("%1_bucket{%2le=\"%3\"} %4\n")
+                                .arg(entry->name, prefix)
+                                .arg(MetricHistogram::BucketBoundsUs[i] / 1e6, 0, 'g', 6)
+                                .arg(cumulative);
+                }
+                // Read without a lock while others observe; keep the series monotonic
+                const quint64 count = qMax(cumulative, histogram.count());
+                text += QString("%1_bucket{%2le=\"+Inf\"} %3\n").arg(entry->name, prefix).arg(count);
+                text += QString("%1_sum%2 %3\n").arg(entry->name, braced)
+                            .arg(histogram.sumMicroseconds() / 1e6, 0, 'f', 6);
+                text += QString("%1_count%2 %3\n").arg(entry->name, braced).arg(count);
+                break;
+            }
+            }
+        }
+    }
+    return text.toUtf8();
+}
@@ -0,0 +1,94 @@
+#ifndef METRICSREGISTRY_H
+#define METRICSREGISTRY_H
+
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+#include <atomic>
+#include <array>
+#include <memory>
+#include <vector>
+
+// Monotonic count; safe to bump from any thread
+class MetricCounter
+{
+public:
+    void add(quint64 amount = 1) { count.fetch_add(amount, std::memory_order_relaxed); }
+    quint64 value() const { return count.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> count{0};
+};
+
+// Value that can go up and down
+class MetricGauge
+{
+public:
+    void set(qint64 newValue) { current.store(newValue, std::memory_order_relaxed); }
+    void add(qint64 amount) { current.fetch_add(amount, std::memory_order_relaxed); }
+    qint64 value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> current{0};
+};
+
+// Latency distribution with fixed buckets from 50 us to 5 s; the dashboard
+// derives percentiles from the buckets (histogram_quantile)
+class MetricHistogram
+{
+public:
+    static const int BucketCount = 15;
+    static const std::array<quint64, BucketCount> BucketBoundsUs;
+
+    void observeMicroseconds(quint64 microseconds);
+
+    quint64 bucketValue(int bucket) const { return buckets[bucket].load(std::memory_order_relaxed); }
+    quint64 count() const { return total.load(std::memory_order_relaxed); }
+    quint64 sumMicroseconds() const { return sumUs.load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<quint64>, BucketCount> buckets{};   // non-cumulative
+    std::atomic<quint64> total{0};
+    std::atomic<quint64> sumUs{0};
+};
+
+// Owns every metric of the process and renders them in the Prometheus text
+// exposition format. Registration takes a lock; updating a metric is a
+// single relaxed atomic add, so hot paths can keep the returned pointers
+// and bump them unconditionally.
+//
+// Labels are given preformatted, e.g. target="ttyUSB0"; metrics with the
+// same name and different labels form one family.
+class MetricsRegistry
+{
+public:
+    MetricCounter *counter(const QString& name, const QString& help, const QString& labels = QString());
+    MetricGauge *gauge(const QString& name, const QString& help, const QString& labels = QString());
+    MetricHistogram *histogram(const QString& name, const QString& help, const QString& labels = QString());
+
+    QByteArray exposition() const;
+
+    // Quotes and escapes a label value
+    static QString label(const QString& name, const QString& value);
+
+private:
+    enum Type { Counter, Gauge, Histogram };
+
+    struct Entry {
+        QString name;
+        QString help;
+        QString labels;
+        Type type;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+
+    Entry *find(const QString& name, const QString& labels, Type type);
+    Entry *add(const QString& name, const QString& help, const QString& labels, Type type);
+
+    mutable QMutex mutex;
+    std::vector<std::unique_ptr<Entry>> entries;
+};
+
+#endif // METRICSREGISTRY_H
@@ -0,0 +1,77 @@
+#include "metricsserver.h"
+#include <QTcpSocket>
+#include <QHostAddress>
+
+MetricsServer::MetricsServer(const MetricsRegistry *registry, QObject *parent)
+    : QObject(parent)
+    , metrics(registry)
+{
+    connect(&server, &QTcpServer::newConnection, this, &MetricsServer::acceptConnection);
+}
+
+bool MetricsServer::listen(quint16 port, QString& errorMessage)
+{
+    if (!server.listen(QHostAddress::LocalHost, port)) {
+        errorMessage = QString("Could not serve metrics on 127.0.0.1:%1: %2").arg(port).arg(server.errorString());
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::acceptConnection()
+{
+    while (QTcpSocket *socket = server.nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { handleRequest(socket); });
+    }
+}
+
+void MetricsServer::handleRequest(QTcpSocket *socket)
+{
+    if (socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+
+    // Wait for the end of the headers; the body of a GET is empty
+    QByteArray request = socket->peek(MaxRequestBytes);
+    if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+        if (request.size() >= MaxRequestBytes) {
+            respond(socket, "431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+        }
+        return;
+    }
+    socket->readAll();
+
+    const QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+    if (requestLine.size() < 2) {
+        respond(socket, "400 Bad Request", "text/plain", "Bad request\n");
+        return;
+    }
+
+    const QByteArray method = requestLine[0];
+    QByteArray path = requestLine[1];
+    const int query = path.indexOf('?');
+    if (query >= 0) {
+        path.truncate(query);
+    }
+
+    if (method != "GET") {
+        respond(socket, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+    } else if (path != "/metrics") {
+        respond(socket, "404 Not Found", "text/plain", "Metrics are at /metrics\n");
+    } else {
+        respond(socket, "200 OK", "text/plain; version=0.0.4; charset=utf-8", metrics->exposition());
+    }
+}
+
+void MetricsServer::respond(QTcpSocket *socket, const QByteArray& status,
+                            const QByteArray& contentType, const QByteArray& body)
+{
+    QByteArray response = "HTTP/1.1 " + status + "\r\n"
+                          "Content-Type: " + contentType + "\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n";
+    response += body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,41 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include "metricsregistry.h"
+
+class QTcpSocket;
+
+// Serves a MetricsRegistry at http://127.0.0.1:<port>/metrics for a
+// Prometheus scraper. Only enough HTTP/1.x for a GET: one request per
+// connection, no keep-alive, nothing but /metrics. Listens on loopback
+// only; put a proxy or node exporter in front to reach it from elsewhere.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(const MetricsRegistry *registry, QObject *parent = nullptr);
+
+    // Port 0 picks a free one; see port()
+    bool listen(quint16 port, QString& errorMessage);
+    void close() { server.close(); }
+    bool isListening() const { return server.isListening(); }
+    quint16 port() const { return server.serverPort(); }
+
+private slots:
+    void acceptConnection();
+
+private:
+    void handleRequest(QTcpSocket *socket);
+    static void respond(QTcpSocket *socket, const QByteArray& status,
+                        const QByteArray& contentType, const QByteArray& body);
+
+    static const int MaxRequestBytes = 8192;
+
+    const MetricsRegistry *metrics;
+    QTcpServer server;
+};
+
+#endif // METRICSSERVER_H
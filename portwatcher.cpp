@@ -0,0 +1,83 @@
+#include "portwatcher.h"
+#include <QDir>
+#include <QPointer>
+#include <QThreadPool>
+
+PortWatcher::PortWatcher(QObject *parent)
+    : QObject(parent)
+    , scanning(false)
+    , rescanPending(false)
+{
+    settleTimer.setSingleShot(true);
+    settleTimer.setInterval(SettleMs);
+    connect(&settleTimer, &QTimer::timeout, this, &PortWatcher::rescan);
+    connect(&watcher, &QFileSystemWatcher::directoryChanged, this, [this]() { settleTimer.start(); });
+
+    pollTimer.setInterval(PollMs);
+    connect(&pollTimer, &QTimer::timeout, this, &PortWatcher::rescan);
+}
+
+void PortWatcher::start()
+{
+    // inotify on Linux, kqueue on macOS; Windows has no device directory
+    if (!QDir("/dev").exists() || !watcher.addPath("/dev")) {
+        pollTimer.start();
+    }
+    rescan();
+}
+
+void PortWatcher::rescan()
+{
+    if (scanning) {
+        rescanPending = true;
+        return;
+    }
+    scanning = true;
+
+    QPointer<PortWatcher> self(this);
+    QThreadPool::globalInstance()->start([self]() {
+        QList<Transport> found = Transport::serialPorts();
+        QMetaObject::invokeMethod(self, [self, found]() {
+            if (self) {
+                self->scanned(found);
+            }
+        });
+    });
+}
+
+void PortWatcher::scanned(const QList<Transport>& found)
+{
+    scanning = false;
+
+    QMap<QString, Transport> current;
+    for (const Transport& port : found) {
+        current.insert(port.address, port);
+    }
+    QList<Transport> removed;
+    for (auto it = known.cbegin(); it != known.cend(); ++it) {
+        if (!current.contains(it.key())) {
+            removed.append(it.value());
+        }
+    }
+    QList<Transport> added;
+    for (auto it = current.cbegin(); it != current.cend(); ++it) {
+        if (!known.contains(it.key())) {
+            added.append(it.value());
+        }
+    }
+
+    // Updated first, so receivers see the new list
+    known = current;
+    for (const Transport& port : removed) {
+        emit portRemoved(port);
+    }
+    for (const Transport& port : added) {
+        emit portAdded(port);
+    }
+    emit scanFinished();
+
+    if (rescanPending) {
+        rescanPending = false;
+        rescan();
+    }
+}
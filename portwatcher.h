@@ -0,0 +1,50 @@
+#ifndef PORTWATCHER_H
+#define PORTWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QList>
+#include <QMap>
+#include <QTimer>
+#include "transport.h"
+
+// Keeps the list of serial ports current without blocking its thread.
+// Enumeration runs on the global thread pool and only the differences from
+// the previous scan are reported. Where there is a /dev it is watched, so
+// plugging or unplugging an adapter triggers a scan; elsewhere ports are
+// polled.
+class PortWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PortWatcher(QObject *parent = nullptr);
+
+    // Starts watching and queues the first scan
+    void start();
+    // Queues a scan; requests made while one runs are folded into one more
+    void rescan();
+
+    QList<Transport> ports() const { return known.values(); }
+
+signals:
+    void portAdded(const Transport& port);
+    void portRemoved(const Transport& port);
+    void scanFinished();
+
+private:
+    // udev creates, renames and chmods a new node in a burst; scan once it settles
+    static const int SettleMs = 300;
+    static const int PollMs = 2000;
+
+    void scanned(const QList<Transport>& found);
+
+    QFileSystemWatcher watcher;
+    QTimer settleTimer;
+    QTimer pollTimer;
+    QMap<QString, Transport> known;     // by port name
+    bool scanning;
+    bool rescanPending;
+};
+
+#endif // PORTWATCHER_H
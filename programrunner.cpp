@@ -0,0 +1,385 @@
+#include "programrunner.h"
+#include "assemblyprogram.h"
+#include "tracing.h"
+#include <QFile>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QPair>
+#include <QPointer>
+#include <QRegularExpression>
+
+QJsonObject ProgramResult::toJson() const
+{
+    QJsonObject object;
+    object["name"] = name;
+    object["passed"] = passed;
+    if (!passed) {
+        object["failure"] = failure;
+        object["transportFailure"] = transportFailure;
+    }
+    object["instructions"] = double(instructions);
+    object["completed"] = double(completed);
+    object["elapsedMs"] = double(elapsedMs);
+    if (hasProgramCounter) {
+        object["programCounter"] = QString("0x%1").arg(programCounter, 8, 16, QChar('0'));
+    }
+    if (!mismatches.isEmpty()) {
+        QJsonArray array;
+        for (const Mismatch& mismatch : mismatches) {
+            QJsonObject entry;
+            entry["address"] = QString("0x%1").arg(mismatch.address, 8, 16, QChar('0'));
+            entry["expected"] = QString("0x%1").arg(mismatch.expected, 8, 16, QChar('0'));
+            entry["actual"] = QString("0x%1").arg(mismatch.actual, 8, 16, QChar('0'));
+            array.append(entry);
+        }
+        object["mismatches"] = array;
+    }
+    if (exited) {
+        object["exitCode"] = double(exitCode);
+    }
+    if (!console.isEmpty()) {
+        object["console"] = console;
+    }
+    if (!results.isEmpty()) {
+        QJsonArray array;
+        for (quint32 value : results) {
+            array.append(double(value));
+        }
+        object["results"] = array;
+    }
+    if (!differingRanges.isEmpty()) {
+        QJsonArray array;
+        for (const MemoryRange& range : differingRanges) {
+            QJsonObject entry;
+            entry["address"] = QString("0x%1").arg(range.address, 8, 16, QChar('0'));
+            entry["words"] = double(range.words);
+            array.append(entry);
+        }
+        object["differingRanges"] = array;
+        object["differingWords"] = double(differingWords);
+    }
+    return object;
+}
+
+ProgramRunner::ProgramRunner(RiscVSession *session, QObject *parent)
+    : QObject(parent)
+    , session(session)
+    , streamer(new InstructionStreamer(session, this))
+    , generation(0)
+    , running(false)
+{
+    programTimer.setSingleShot(true);
+    responseTimer.setSingleShot(true);
+
+    connect(streamer, &InstructionStreamer::finished, this, &ProgramRunner::streamFinished);
+    connect(&programTimer, &QTimer::timeout, this, &ProgramRunner::programTimedOut);
+    connect(&responseTimer, &QTimer::timeout, this, &ProgramRunner::responseTimedOut);
+
+    // Any reply from the core shows it is still alive
+    connect(session, &RiscVSession::cpuReady, this, &ProgramRunner::coreResponded);
+    connect(session, &RiscVSession::storeReceived, this, &ProgramRunner::coreResponded);
+    connect(session, &RiscVSession::loadServed, this, &ProgramRunner::coreResponded);
+    connect(session, &RiscVSession::programCounterReceived, this, &ProgramRunner::coreResponded);
+}
+
+AsyncResult<ProgramResult> ProgramRunner::run(const TestProgram& program)
+{
+    if (running) {
+        AsyncPromise<ProgramResult> busy;
+        ProgramResult busyResult;
+        busyResult.name = program.name;
+        busyResult.failure = "Another program is already running";
+        busy.finish(busyResult);
+        return busy.future();
+    }
+
+    running = true;
+    generation++;
+    current = program;
+    result = ProgramResult();
+    result.name = program.name;
+    result.instructions = program.words.size();
+    promise = AsyncPromise<ProgramResult>();
+    AsyncResult<ProgramResult> future = promise.future();
+
+    // Shared memory belongs to every board on it; the caller loads it once
+    if (!session->shared()) {
+        *session->memory() = program.initialMemory.snapshot();
+    }
+    if (ReferenceModel *reference = session->reference()) {
+        // Registers carry over between programs on the board, so they do here too
+        reference->memory() = program.initialMemory.snapshot();
+    }
+    if (MemoryMap *devices = session->devices()) {
+        devices->reset();
+        // Queued: the exit store arrives in the middle of the session's event handling
+        connect(devices, &MemoryMap::exitRequested, this, &ProgramRunner::deviceExit,
+                Qt::ConnectionType(Qt::QueuedConnection | Qt::UniqueConnection));
+    }
+    elapsed.start();
+    programTimer.start(options.timeoutMs);
+    responseTimer.start(options.responseTimeoutMs);
+
+    if (options.resetFirst) {
+        QPointer<ProgramRunner> self(this);
+        const quint64 startedGeneration = generation;
+        session->reset().then([self, startedGeneration](const SessionResult& reset) {
+            if (!self || self->generation != startedGeneration) {
+                return;
+            }
+            if (!reset.ok) {
+                self->fail(reset.errorMessage, true);
+                return;
+            }
+            self->startStreaming();
+        });
+    } else {
+        startStreaming();
+    }
+    return future;
+}
+
+void ProgramRunner::startStreaming()
+{
+    source.reset(current.words);
+    streamer->start(&source);
+}
+
+void ProgramRunner::streamFinished(bool ok, const QString& errorMessage)
+{
+    if (!running) {
+        return;
+    }
+
+    result.completed = streamer->completed();
+    if (!ok) {
+        fail(errorMessage, true);
+        return;
+    }
+
+    // The exit store came mid-program; the PC is wherever it stopped
+    if (!options.readProgramCounter || result.exited) {
+        checkMemory();
+        return;
+    }
+
+    QPointer<ProgramRunner> self(this);
+    const quint64 startedGeneration = generation;
+    session->readPC().then([self, startedGeneration](const SessionResult& pc) {
+        if (!self || self->generation != startedGeneration) {
+            return;
+        }
+        if (!pc.ok) {
+            self->fail(pc.errorMessage, true);
+            return;
+        }
+        self->result.hasProgramCounter = true;
+        self->result.programCounter = pc.value;
+        self->checkMemory();
+    });
+}
+
+void ProgramRunner::checkMemory()
+{
+    TRACE_ZONE("runner.checkMemory");
+    const HostMemory memory = session->shared() ? session->shared()->snapshot() : *session->memory();
+    result.mismatches = compareMemory(memory, current.expectedMemory);
+    if (!result.mismatches.isEmpty()) {
+        result.failure = QString("%1 of %2 expected memory words differ")
+                             .arg(result.mismatches.size())
+                             .arg(current.expectedMemory.size());
+        finish();
+        return;
+    }
+
+    QVector<QPair<const HostMemory *, QString>> images;
+    if (current.hasExpectedImage) {
+        images.append({&current.expectedImage, "the expected image"});
+    }
+    if (options.compareWithReference && session->reference()) {
+        images.append({&session->reference()->memory(), "the reference model"});
+    }
+    for (const auto& image : images) {
+        const MemoryComparison comparison = MemoryComparison::compare(memory, *image.first,
+                                                                      MaxReportedRanges);
+        if (!comparison.identical()) {
+            result.differingRanges = comparison.ranges;
+            result.differingWords = comparison.differingWords;
+            result.failure = QString("%1 memory words in %2%3 range(s) differ from %4, first at %5")
+                                 .arg(comparison.differingWords)
+                                 .arg(comparison.truncated ? "over " : "")
+                                 .arg(comparison.ranges.size())
+                                 .arg(image.second, MemoryComparison::describe(comparison.ranges.first()));
+            finish();
+            return;
+        }
+    }
+    result.passed = true;
+    finish();
+}
+
+void ProgramRunner::programTimedOut()
+{
+    fail(QString("Timed out after %1 ms").arg(options.timeoutMs));
+}
+
+void ProgramRunner::responseTimedOut()
+{
+    fail(QString("No response from the core for %1 ms").arg(options.responseTimeoutMs));
+}
+
+void ProgramRunner::coreResponded()
+{
+    if (running) {
+        responseTimer.start(options.responseTimeoutMs);
+    }
+}
+
+void ProgramRunner::deviceExit(quint32 code)
+{
+    // Stale if it was queued before this program reset the devices
+    if (!running || result.exited || !session->devices()->hasExited()) {
+        return;
+    }
+    result.exited = true;
+    result.exitCode = code;
+    if (code != 0) {
+        fail(QString("Exited with code %1").arg(code));
+        return;
+    }
+    // Drops the rest of the program; streamFinished goes on to the checks
+    streamer->stop();
+}
+
+void ProgramRunner::fail(const QString& message, bool transportFailure)
+{
+    if (!running) {
+        return;
+    }
+    result.passed = false;
+    result.failure = message;
+    result.transportFailure = transportFailure;
+    result.completed = streamer->completed();
+    finish();
+}
+
+void ProgramRunner::finish()
+{
+    running = false;
+    generation++;
+    programTimer.stop();
+    responseTimer.stop();
+    result.elapsedMs = elapsed.elapsed();
+    if (const MemoryMap *devices = session->devices()) {
+        result.console = QString::fromUtf8(devices->consoleOutput());
+        result.results = devices->results();
+    }
+
+    // Abandon whatever the failed (or exited) program still had in flight
+    streamer->stop();
+    if (session->pendingOperations() > 0) {
+        session->cancelAll(result.failure.isEmpty() ? QString("Program exited") : result.failure);
+    }
+
+    promise.finish(result);
+}
+
+bool ProgramRunner::loadProgram(const QString& fileName, TestProgram& program, QString& errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    AssemblyProgram assembly;
+    assembly.load(QTextStream(&file).readAll());
+
+    program.name = QFileInfo(fileName).fileName();
+    program.words.clear();
+    for (const AssemblyProgram::Instruction& instruction : assembly.instructions()) {
+        if (!instruction.valid) {
+            errorMessage = QString("%1:%2: %3")
+                               .arg(fileName)
+                               .arg(instruction.sourceLine + 1)
+                               .arg(instruction.errorMessage);
+            return false;
+        }
+        program.words.append(instruction.machineCode);
+    }
+    return true;
+}
+
+bool ProgramRunner::loadExpectedMemory(const QString& fileName, QVector<MemoryExpectation>& expected,
+                                       QString& errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    static const QRegularExpression separators("[\\s,=]+");
+    QTextStream in(&file);
+    expected.clear();
+    bool rowLayout = false;
+    quint32 row = 0;
+    int lineNumber = 0;
+
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        lineNumber++;
+
+        int commentIndex = line.indexOf('#');
+        if (commentIndex != -1) {
+            line = line.left(commentIndex);
+        }
+        line = line.trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        if (lineNumber == 1 && line == "DataValue") {
+            rowLayout = true;
+            continue;
+        }
+
+        MemoryExpectation expectation;
+        bool ok = false;
+        if (rowLayout) {
+            expectation.address = row * 4;
+            expectation.value = line.toUInt(&ok, 16);
+            row++;
+        } else {
+            QStringList fields = line.split(separators, Qt::SkipEmptyParts);
+            bool addressOk = false;
+            if (fields.size() == 2) {
+                expectation.address = fields[0].toUInt(&addressOk, 0);
+                expectation.value = fields[1].toUInt(&ok, 0);
+            }
+            ok = ok && addressOk && (expectation.address & 3) == 0;
+        }
+
+        if (!ok) {
+            errorMessage = QString("%1:%2: expected an aligned address and a 32-bit value")
+                               .arg(fileName)
+                               .arg(lineNumber);
+            return false;
+        }
+        expected.append(expectation);
+    }
+    return true;
+}
+
+QVector<ProgramResult::Mismatch> ProgramRunner::compareMemory(const HostMemory& memory,
+                                                              const QVector<MemoryExpectation>& expected)
+{
+    QVector<ProgramResult::Mismatch> mismatches;
+    for (const MemoryExpectation& expectation : expected) {
+        quint32 actual = memory.readWord(expectation.address);
+        if (actual != expectation.value) {
+            mismatches.append({expectation.address, expectation.value, actual});
+        }
+    }
+    return mismatches;
+}
@@ -0,0 +1,128 @@
+#ifndef PROGRAMRUNNER_H
+#define PROGRAMRUNNER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include "riscvsession.h"
+#include "instructionstreamer.h"
+#include "instructionsource.h"
+#include "memorycomparison.h"
+
+struct MemoryExpectation {
+    quint32 address = 0;
+    quint32 value = 0;
+};
+
+// A program ready to stream: assembled words plus the memory it should leave behind
+struct TestProgram {
+    QString name;
+    QVector<quint32> words;
+    // Host memory at the start of the run (preloaded data); shared, not copied
+    HostMemory initialMemory;
+    QVector<MemoryExpectation> expectedMemory;
+    // Whole image the memory must equal, untouched words included
+    bool hasExpectedImage = false;
+    HostMemory expectedImage;
+};
+
+struct ProgramResult {
+    struct Mismatch {
+        quint32 address;
+        quint32 expected;
+        quint32 actual;
+    };
+
+    QString name;
+    bool passed = false;
+    bool transportFailure = false;  // the link failed, not the program
+    QString failure;
+    quint64 instructions = 0;
+    quint64 completed = 0;
+    qint64 elapsedMs = 0;
+    bool hasProgramCounter = false;
+    quint32 programCounter = 0;
+    QVector<Mismatch> mismatches;
+    QVector<MemoryRange> differingRanges;   // against the expected image or reference model
+    quint64 differingWords = 0;
+    // Collected by the session's devices, if it has any
+    bool exited = false;        // the program stored to the exit device
+    quint32 exitCode = 0;
+    QString console;
+    QVector<quint32> results;
+
+    QJsonObject toJson() const;
+};
+
+// Streams one program through a session at link rate, then checks the
+// memory the core stored against the expectations. Used by the headless
+// runner; no widgets involved.
+//
+// If the session has devices mapped, a store to the exit device ends the
+// program early: code 0 goes on to the memory checks, anything else fails.
+class ProgramRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        bool resetFirst = false;        // send the reset command before the program
+        bool readProgramCounter = true; // read the PC once the last instruction retired
+        int timeoutMs = 10000;          // whole program
+        int responseTimeoutMs = 1000;   // longest wait for any reply from the core
+        bool compareWithReference = false;  // memory must equal the session's reference model's
+    };
+
+    explicit ProgramRunner(RiscVSession *session, QObject *parent = nullptr);
+
+    void setOptions(const Options& newOptions) { options = newOptions; }
+    const Options& runOptions() const { return options; }
+
+    // The session's memory (and its reference model's) starts out as the
+    // program's initial memory, unless the session serves from a shared
+    // memory; then the checks look at that. Only one program runs at a time.
+    AsyncResult<ProgramResult> run(const TestProgram& program);
+    bool isRunning() const { return running; }
+
+    // .s source through AssemblyProgram; any invalid line is an error
+    static bool loadProgram(const QString& fileName, TestProgram& program, QString& errorMessage);
+
+    // Either memory_map.csv layout ("DataValue" header, row = address / 4) or
+    // one "address value" pair per line (separated by spaces, ',' or '=').
+    static bool loadExpectedMemory(const QString& fileName, QVector<MemoryExpectation>& expected,
+                                   QString& errorMessage);
+
+    static QVector<ProgramResult::Mismatch> compareMemory(const HostMemory& memory,
+                                                          const QVector<MemoryExpectation>& expected);
+
+private slots:
+    void streamFinished(bool ok, const QString& errorMessage);
+    void programTimedOut();
+    void responseTimedOut();
+    void coreResponded();
+    void deviceExit(quint32 code);
+
+private:
+    static const int MaxReportedRanges = 64;
+
+    void startStreaming();
+    void checkMemory();
+    void fail(const QString& message, bool transportFailure = false);
+    void finish();
+
+    RiscVSession *session;
+    InstructionStreamer *streamer;
+    InstructionListSource source;
+    Options options;
+    TestProgram current;
+    ProgramResult result;
+    AsyncPromise<ProgramResult> promise;
+    QElapsedTimer elapsed;
+    QTimer programTimer;
+    QTimer responseTimer;
+    quint64 generation;
+    bool running;
+};
+
+#endif // PROGRAMRUNNER_H
@@ -0,0 +1,26 @@
+#include "referencemodel.h"
+
+void ReferenceModel::execute(quint32 instruction, const MemoryMap *devices, quint32 deviceLoad)
+{
+    Rv32iCore::MemoryAccess access = core.execute(instruction);
+    const bool device = access.kind != Rv32iCore::MemoryAccess::None && devices && devices->contains(access.address);
+    switch (access.kind) {
+    case Rv32iCore::MemoryAccess::Load:
+        core.completeLoad(access, device ? deviceLoad : referenceMemory.readWord(access.address));
+        break;
+    case Rv32iCore::MemoryAccess::Store:
+        // Same word-granular store the host applies for a store frame
+        if (!device) {
+            referenceMemory.writeWord(access.address, access.value);
+        }
+        break;
+    case Rv32iCore::MemoryAccess::None:
+        break;
+    }
+}
+
+void ReferenceModel::clear()
+{
+    core.powerOn();
+    referenceMemory.clear();
+}
@@ -0,0 +1,34 @@
+#ifndef REFERENCEMODEL_H
+#define REFERENCEMODEL_H
+
+#include "rv32icore.h"
+#include "hostmemory.h"
+#include "memorymap.h"
+
+// Software mirror of the board: every instruction the session completes is
+// also executed here, against a private copy of memory, giving the register
+// file, program counter and memory image the board should have.
+class ReferenceModel
+{
+public:
+    // Accesses to device pages in devices are not mirrored: a load gets
+    // deviceLoad, the value the board was served, and a store is dropped
+    void execute(quint32 instruction, const MemoryMap *devices = nullptr, quint32 deviceLoad = 0);
+
+    // Mirrors the chip's reset command: program counter only
+    void resetProgramCounter() { core.resetProgramCounter(); }
+
+    // Power-on registers and empty memory
+    void clear();
+
+    Rv32iCore& processor() { return core; }
+    const Rv32iCore& processor() const { return core; }
+    HostMemory& memory() { return referenceMemory; }
+    const HostMemory& memory() const { return referenceMemory; }
+
+private:
+    Rv32iCore core;
+    HostMemory referenceMemory;
+};
+
+#endif // REFERENCEMODEL_H
@@ -0,0 +1,87 @@
+#include "registerdump.h"
+#include "rvassembler.h"
+
+bool RegisterDump::isValidScratchBase(quint32 scratchBase)
+{
+    // Every store must be addressable as a sign-extended 12-bit offset from x0
+    const qint32 first = qint32(scratchBase);
+    const qint32 last = first + (ScratchWords - 1) * 4;
+    return (scratchBase & 3) == 0 && first >= -2048 && last <= 2047 && (first >= 0 || last < 0);
+}
+
+QVector<quint32> RegisterDump::program(quint32 scratchBase)
+{
+    QVector<quint32> words;
+    for (int rs2 = 1; rs2 <= ScratchWords; rs2++) {
+        words.append(rv::sw(rs2, qint32(scratchBase) + (rs2 - 1) * 4, 0));
+    }
+
+    // The stores moved the PC on by 4 each. Land on the instruction before
+    // the one that was next, then step from there onto it, so both the next
+    // fetch and (after a fall-through) the PC readback are as they were.
+    const qint32 burstBytes = ScratchWords * 4;
+    words.append(rv::jal(0, -(burstBytes + 4)));
+    words.append(rv::jal(0, 4));
+    return words;
+}
+
+AsyncResult<RegisterDump> RegisterDump::capture(RiscVSession *session, quint32 scratchBase)
+{
+    AsyncPromise<RegisterDump> promise;
+    if (!isValidScratchBase(scratchBase)) {
+        RegisterDump dump;
+        dump.errorMessage = QString("Scratch region 0x%1 is not reachable from x0").arg(scratchBase, 8, 16, QChar('0'));
+        promise.finish(dump);
+        return promise.future();
+    }
+
+    // Copy-on-write snapshots, to put the scratch words back afterwards
+    const HostMemory hostBefore = session->memory()->snapshot();
+    ReferenceModel *reference = session->reference();
+    const HostMemory referenceBefore = reference ? reference->memory().snapshot() : HostMemory();
+
+    QVector<SessionFuture> steps;
+    for (quint32 machineCode : program(scratchBase)) {
+        steps.append(session->execute(machineCode));
+    }
+
+    whenAll(steps).then([promise, session, scratchBase, hostBefore, referenceBefore]
+                        (const QVector<SessionResult>& results) mutable {
+        RegisterDump dump;
+        dump.ok = true;
+        for (int i = 0; i < results.size() && dump.ok; i++) {
+            const SessionResult& result = results[i];
+            if (!result.ok) {
+                dump.ok = false;
+                dump.errorMessage = result.errorMessage;
+            } else if (i < ScratchWords) {
+                const quint32 expected = scratchBase + quint32(i) * 4;
+                if (result.access != SessionResult::StoreAccess || result.address != expected) {
+                    dump.ok = false;
+                    dump.errorMessage = QString("Expected a store to 0x%1 for x%2")
+                                            .arg(expected, 8, 16, QChar('0')).arg(i + 1);
+                } else {
+                    dump.registers[i + 1] = result.value;
+                }
+            }
+        }
+
+        session->memory()->restoreRange(hostBefore, scratchBase, ScratchWords);
+        if (ReferenceModel *model = session->reference()) {
+            model->memory().restoreRange(referenceBefore, scratchBase, ScratchWords);
+        }
+        promise.finish(dump);
+    });
+    return promise.future();
+}
+
+QString RegisterDump::abiName(int index)
+{
+    static const char *const names[32] = {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+        "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+        "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+    };
+    return names[index & 31];
+}
@@ -0,0 +1,38 @@
+#ifndef REGISTERDUMP_H
+#define REGISTERDUMP_H
+
+#include <QString>
+#include <QVector>
+#include <array>
+#include "riscvsession.h"
+
+// Register file read back from a core that has no register readback: one
+// burst of "sw xN, off(x0)" into a reserved scratch region, decoded from
+// the store frames as they arrive. The burst is queued in one go, so it
+// runs back to back on CPU_READY.
+//
+// Afterwards the burst is undone as far as the host can: the scratch words
+// (and any page they created) are put back, and two jumps return the
+// program counter to the next instruction, with the PC readback restored
+// whenever the last instruction before the dump fell through.
+struct RegisterDump {
+    bool ok = false;
+    QString errorMessage;
+    std::array<quint32, 32> registers{};    // x0 reads as zero
+
+    // Reachable from x0 with a 12-bit signed offset; the top 2 KiB of the
+    // address space is the least likely to hold program data
+    static const quint32 DefaultScratchBase = 0xFFFFF800;
+    static const int ScratchWords = 31;
+
+    static bool isValidScratchBase(quint32 scratchBase);
+
+    // The instruction words of a dump, scratch stores first
+    static QVector<quint32> program(quint32 scratchBase);
+
+    static AsyncResult<RegisterDump> capture(RiscVSession *session, quint32 scratchBase = DefaultScratchBase);
+
+    static QString abiName(int index);
+};
+
+#endif // REGISTERDUMP_H
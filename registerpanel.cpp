@@ -0,0 +1,104 @@
+#include "registerpanel.h"
+#include "ui_registerpanel.h"
+#include <QElapsedTimer>
+#include <QHeaderView>
+#include <QPointer>
+
+RegisterPanel::RegisterPanel(RiscVSession *session, QWidget *parent)
+    : QMainWindow(parent)
+    , ui(new Ui::RegisterPanel)
+    , session(session)
+    , dumping(false)
+{
+    ui->setupUi(this);
+    setupTable();
+
+    connect(ui->dumpButton, &QPushButton::clicked, this, &RegisterPanel::dumpRegisters);
+}
+
+RegisterPanel::~RegisterPanel()
+{
+    delete ui;
+}
+
+void RegisterPanel::setupTable()
+{
+    ui->registerTable->setColumnCount(ColumnCount);
+    ui->registerTable->setHorizontalHeaderLabels({"Register", "ABI", "Hex", "Decimal", "Reference"});
+    ui->registerTable->setRowCount(32);
+    ui->registerTable->verticalHeader()->hide();
+    for (int row = 0; row < 32; row++) {
+        ui->registerTable->setItem(row, NameColumn, new QTableWidgetItem(QString("x%1").arg(row)));
+        ui->registerTable->setItem(row, AbiColumn, new QTableWidgetItem(RegisterDump::abiName(row)));
+        for (int column = HexColumn; column < ColumnCount; column++) {
+            ui->registerTable->setItem(row, column, new QTableWidgetItem());
+        }
+    }
+    ui->registerTable->horizontalHeader()->setStretchLastSection(true);
+}
+
+void RegisterPanel::dumpRegisters()
+{
+    if (dumping) {
+        return;
+    }
+    if (!session->device() || !session->device()->isOpen()) {
+        ui->summaryLabel->setText("Not connected to any serial port.");
+        return;
+    }
+
+    dumping = true;
+    ui->dumpButton->setEnabled(false);
+    ui->summaryLabel->setText(QString("Dumping x1..x31 to 0x%1...")
+                                  .arg(RegisterDump::DefaultScratchBase, 8, 16, QChar('0')));
+
+    QPointer<RegisterPanel> self(this);
+    QElapsedTimer elapsed;
+    elapsed.start();
+    RegisterDump::capture(session).then([self, elapsed](const RegisterDump& dump) {
+        if (!self) {
+            return;
+        }
+        self->dumping = false;
+        self->ui->dumpButton->setEnabled(true);
+        if (!dump.ok) {
+            self->ui->summaryLabel->setText(QString("Dump failed: %1").arg(dump.errorMessage));
+        } else {
+            self->showDump(dump);
+            self->ui->summaryLabel->setText(self->ui->summaryLabel->text()
+                                            + QString(" in %1 ms").arg(elapsed.elapsed()));
+        }
+        emit self->dumpFinished(dump.ok, dump.errorMessage);
+    });
+}
+
+void RegisterPanel::showDump(const RegisterDump& dump)
+{
+    const ReferenceModel *reference = session->reference();
+    const QColor mismatchColor(255, 200, 200);
+    int mismatches = 0;
+
+    for (int row = 0; row < 32; row++) {
+        const quint32 value = dump.registers[row];
+        ui->registerTable->item(row, HexColumn)->setText(QString("0x%1").arg(value, 8, 16, QChar('0')));
+        ui->registerTable->item(row, DecimalColumn)->setText(QString::number(qint32(value)));
+
+        // The reference has already executed the dump burst too, which changes no registers
+        bool differs = false;
+        if (reference) {
+            const quint32 expected = reference->processor().registerValue(row);
+            ui->registerTable->item(row, ReferenceColumn)->setText(QString("0x%1").arg(expected, 8, 16, QChar('0')));
+            differs = expected != value;
+        } else {
+            ui->registerTable->item(row, ReferenceColumn)->setText(QString());
+        }
+        mismatches += differs ? 1 : 0;
+        for (int column = 0; column < ColumnCount; column++) {
+            ui->registerTable->item(row, column)->setBackground(differs ? QBrush(mismatchColor) : QBrush());
+        }
+    }
+
+    ui->summaryLabel->setText(reference
+                                  ? QString("Registers read; %1 differ from the reference model").arg(mismatches)
+                                  : QString("Registers read"));
+}
@@ -0,0 +1,42 @@
+#ifndef REGISTERPANEL_H
+#define REGISTERPANEL_H
+
+#include <QMainWindow>
+#include "registerdump.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+class RegisterPanel;
+}
+QT_END_NAMESPACE
+
+// Register file of the connected core, read with a RegisterDump burst.
+// With a reference model attached, registers that differ from it are
+// highlighted.
+class RegisterPanel : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    explicit RegisterPanel(RiscVSession *session, QWidget *parent = nullptr);
+    ~RegisterPanel();
+
+signals:
+    // Scratch memory has been restored by the time this is emitted
+    void dumpFinished(bool ok, const QString& errorMessage);
+
+public slots:
+    void dumpRegisters();
+
+private:
+    enum Column { NameColumn, AbiColumn, HexColumn, DecimalColumn, ReferenceColumn, ColumnCount };
+
+    void setupTable();
+    void showDump(const RegisterDump& dump);
+
+    Ui::RegisterPanel *ui;
+    RiscVSession *session;
+    bool dumping;
+};
+
+#endif // REGISTERPANEL_H
@@ -0,0 +1,399 @@
+#include "regressionscheduler.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QXmlStreamWriter>
+#include <algorithm>
+
+QJsonObject SuiteResult::toJson() const
+{
+    QJsonObject object;
+    object["passed"] = passed;
+    object["failed"] = failed;
+    object["skipped"] = skipped;
+    object["elapsedMs"] = double(wallMs);
+
+    QJsonArray programs;
+    for (int i = 0; i < results.size(); i++) {
+        QJsonObject entry = results[i].toJson();
+        if (attempts[i] > 0) {
+            entry["target"] = targets[i];
+            entry["attempts"] = attempts[i];
+        }
+        programs.append(entry);
+    }
+    object["programs"] = programs;
+
+    QJsonArray pool;
+    for (const TargetStats& stats : targetStats) {
+        QJsonObject entry;
+        entry["name"] = stats.name;
+        entry["programsRun"] = stats.programsRun;
+        entry["passed"] = stats.passed;
+        entry["failed"] = stats.failed;
+        entry["transportFailures"] = stats.transportFailures;
+        entry["stolen"] = stats.stolen;
+        entry["recoveries"] = double(stats.recoveries);
+        entry["busyMs"] = double(stats.busyMs);
+        entry["utilisation"] = stats.utilisation(wallMs);
+        entry["retired"] = stats.retired;
+        pool.append(entry);
+    }
+    object["targets"] = pool;
+    return object;
+}
+
+bool SuiteResult::writeJUnit(const QString& fileName, const QString& suiteName, QString& errorMessage) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = QString("Failed to write %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    int errors = 0;
+    for (const ProgramResult& result : results) {
+        if (!result.passed && result.transportFailure) {
+            errors++;
+        }
+    }
+    const QString seconds = QString::number(wallMs / 1000.0, 'f', 3);
+
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("testsuites");
+    xml.writeAttribute("tests", QString::number(results.size()));
+    xml.writeAttribute("failures", QString::number(failed - errors));
+    xml.writeAttribute("errors", QString::number(errors));
+    xml.writeAttribute("time", seconds);
+
+    xml.writeStartElement("testsuite");
+    xml.writeAttribute("name", suiteName);
+    xml.writeAttribute("tests", QString::number(results.size()));
+    xml.writeAttribute("failures", QString::number(failed - errors));
+    xml.writeAttribute("errors", QString::number(errors));
+    xml.writeAttribute("skipped", QString::number(skipped));
+    xml.writeAttribute("time", seconds);
+
+    xml.writeStartElement("properties");
+    for (const TargetStats& stats : targetStats) {
+        xml.writeStartElement("property");
+        xml.writeAttribute("name", QString("target.%1.utilisation").arg(stats.name));
+        xml.writeAttribute("value", QString::number(stats.utilisation(wallMs), 'f', 3));
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+
+    for (int i = 0; i < results.size(); i++) {
+        const ProgramResult& result = results[i];
+        xml.writeStartElement("testcase");
+        xml.writeAttribute("name", result.name);
+        xml.writeAttribute("classname", suiteName);
+        xml.writeAttribute("time", QString::number(result.elapsedMs / 1000.0, 'f', 3));
+
+        if (attempts[i] == 0) {
+            xml.writeEmptyElement("skipped");
+        } else if (!result.passed) {
+            xml.writeStartElement(result.transportFailure ? "error" : "failure");
+            xml.writeAttribute("message", result.failure);
+            QString details;
+            for (const ProgramResult::Mismatch& mismatch : result.mismatches) {
+                details += QString("0x%1: expected 0x%2, got 0x%3\n")
+                               .arg(mismatch.address, 8, 16, QChar('0'))
+                               .arg(mismatch.expected, 8, 16, QChar('0'))
+                               .arg(mismatch.actual, 8, 16, QChar('0'));
+            }
+            xml.writeCharacters(details);
+            xml.writeEndElement();
+        }
+        if (attempts[i] > 0) {
+            QString output = QString("target: %1, attempts: %2").arg(targets[i]).arg(attempts[i]);
+            if (!result.console.isEmpty()) {
+                output += "\n" + result.console;
+            }
+            xml.writeTextElement("system-out", output);
+        }
+        xml.writeEndElement();
+    }
+
+    xml.writeEndElement();
+    xml.writeEndElement();
+    xml.writeEndDocument();
+
+    if (xml.hasError()) {
+        errorMessage = QString("Failed to write %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+RegressionScheduler::RegressionScheduler(QObject *parent)
+    : QObject(parent)
+    , maxAttempts(2)
+    , stopOnFailure(false)
+    , linkBaudRate(115200)
+    , deadlineMarginMs(100)
+    , metricsRegistry(nullptr)
+    , referenceModels(false)
+    , sharedMemory(nullptr)
+    , remaining(0)
+    , running(false)
+    , stopping(false)
+{
+}
+
+RegressionScheduler::~RegressionScheduler()
+{
+}
+
+void RegressionScheduler::addTarget(const QString& name, QIODevice *device)
+{
+    std::unique_ptr<Target> target(new Target);
+    target->stats.name = name;
+    target->device = device;
+    target->session.reset(new RiscVSession);
+    target->session->setDevice(device);
+    target->session->setLinkTiming(linkBaudRate, deadlineMarginMs);
+    if (metricsRegistry) {
+        target->metrics = SessionMetrics::registerTarget(*metricsRegistry, name);
+        target->session->setMetrics(&target->metrics);
+    }
+    if (referenceModels) {
+        target->reference.reset(new ReferenceModel);
+        target->session->setReferenceModel(target->reference.get());
+    }
+    if (!deviceRegions.isEmpty()) {
+        target->devices.reset(new MemoryMap);
+        for (const MemoryMap::Region& region : deviceRegions) {
+            QString errorMessage;
+            target->devices->addRegion(region, errorMessage);   // checked when the layout was built
+        }
+        target->session->setMemoryMap(target->devices.get());
+    }
+    if (sharedMemory) {
+        target->session->setSharedMemory(sharedMemory, sharedMemory->addClient(name));
+    }
+    target->runner.reset(new ProgramRunner(target->session.get()));
+    targets.push_back(std::move(target));
+}
+
+QString RegressionScheduler::targetFileName(const QString& fileName, const QString& target,
+                                            const QString& defaultSuffix) const
+{
+    if (targets.size() <= 1) {
+        return fileName;
+    }
+    const QFileInfo info(fileName);
+    const QString suffix = info.suffix().isEmpty() ? defaultSuffix : info.suffix();
+    return info.dir().filePath(QString("%1-%2.%3").arg(info.completeBaseName(), target, suffix));
+}
+
+bool RegressionScheduler::recordWaveforms(const QString& fileName, QString& errorMessage)
+{
+    for (auto& target : targets) {
+        target->waveform.reset(new VcdWriter);
+        if (!target->waveform->open(targetFileName(fileName, target->stats.name, "vcd"), errorMessage)) {
+            return false;
+        }
+        target->session->setWaveform(target->waveform.get());
+    }
+    return true;
+}
+
+bool RegressionScheduler::recordCaptures(const QString& fileName, QString& errorMessage)
+{
+    for (auto& target : targets) {
+        target->capture.reset(new CaptureWriter);
+        if (!target->capture->open(targetFileName(fileName, target->stats.name, "cap"), errorMessage)) {
+            return false;
+        }
+        target->session->setCapture(target->capture.get());
+    }
+    return true;
+}
+
+AsyncResult<SuiteResult> RegressionScheduler::run(const QVector<TestProgram>& suite)
+{
+    programs = suite;
+    suiteResult = SuiteResult();
+    suiteResult.results.resize(suite.size());
+    suiteResult.targets.resize(suite.size());
+    suiteResult.attempts.fill(0, suite.size());
+    triedTargets = QVector<QSet<int>>(suite.size());
+    done.fill(false, suite.size());
+    remaining = suite.size();
+    running = true;
+    stopping = false;
+    promise = AsyncPromise<SuiteResult>();
+    AsyncResult<SuiteResult> future = promise.future();
+    wallClock.start();
+
+    for (auto& target : targets) {
+        target->stats = TargetStats{target->stats.name};
+        target->queue.clear();
+        target->idle = true;
+        target->consecutiveTransportFailures = 0;
+        target->recoveriesAtStart = target->session->recoveryCount();
+        target->runner->setOptions(runnerOptions);
+    }
+
+    // Deal round-robin; stealing evens out whatever the deal got wrong
+    for (int i = 0; i < programs.size(); i++) {
+        suiteResult.results[i].name = programs[i].name;
+        if (!targets.empty()) {
+            targets[i % targets.size()]->queue.append(i);
+        }
+    }
+
+    dispatch();
+    return future;
+}
+
+bool RegressionScheduler::takeWork(int targetIndex, int& programIndex)
+{
+    Target& target = *targets[targetIndex];
+
+    for (int i = 0; i < target.queue.size(); i++) {
+        if (!triedTargets[target.queue[i]].contains(targetIndex)) {
+            programIndex = target.queue.takeAt(i);
+            return true;
+        }
+    }
+
+    // Steal from the back of the longest queue: the work its owner would reach
+    // last. If this target already tried everything there, try shorter ones.
+    QVector<Target *> victims;
+    for (auto& other : targets) {
+        if (other.get() != &target && !other->queue.isEmpty()) {
+            victims.append(other.get());
+        }
+    }
+    std::stable_sort(victims.begin(), victims.end(), [](const Target *a, const Target *b) {
+        return a->queue.size() > b->queue.size();
+    });
+    for (Target *victim : victims) {
+        for (int i = victim->queue.size() - 1; i >= 0; i--) {
+            if (!triedTargets[victim->queue[i]].contains(targetIndex)) {
+                programIndex = victim->queue.takeAt(i);
+                target.stats.stolen++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void RegressionScheduler::dispatch()
+{
+    for (int t = 0; t < int(targets.size()) && running && !stopping; t++) {
+        Target& target = *targets[t];
+        int programIndex;
+        if (!target.idle || target.stats.retired || !takeWork(t, programIndex)) {
+            continue;
+        }
+
+        target.idle = false;
+        target.busy.start();
+        suiteResult.attempts[programIndex]++;
+        target.runner->run(programs[programIndex]).then([this, t, programIndex](const ProgramResult& result) {
+            finished(t, programIndex, result);
+        });
+    }
+
+    bool anyBusy = false;
+    for (auto& target : targets) {
+        anyBusy = anyBusy || !target->idle;
+    }
+    if (running && !anyBusy) {
+        complete();
+    }
+}
+
+void RegressionScheduler::finished(int targetIndex, int programIndex, const ProgramResult& result)
+{
+    Target& target = *targets[targetIndex];
+    target.idle = true;
+    target.stats.busyMs += target.busy.elapsed();
+    target.stats.programsRun++;
+    triedTargets[programIndex].insert(targetIndex);
+
+    if (result.transportFailure) {
+        target.stats.transportFailures++;
+        if (++target.consecutiveTransportFailures >= RetireAfterTransportFailures) {
+            target.stats.retired = true;
+            while (!target.queue.isEmpty()) {
+                requeueElsewhere(targetIndex, target.queue.takeLast());
+            }
+        }
+
+        bool untriedTarget = false;
+        for (int t = 0; t < int(targets.size()); t++) {
+            untriedTarget = untriedTarget || (!targets[t]->stats.retired && !triedTargets[programIndex].contains(t));
+        }
+        if (untriedTarget && suiteResult.attempts[programIndex] < maxAttempts) {
+            requeueElsewhere(targetIndex, programIndex);
+            dispatch();
+            return;
+        }
+    } else {
+        target.consecutiveTransportFailures = 0;
+    }
+
+    done[programIndex] = true;
+    suiteResult.results[programIndex] = result;
+    suiteResult.targets[programIndex] = target.stats.name;
+    remaining--;
+    if (result.passed) {
+        target.stats.passed++;
+        suiteResult.passed++;
+    } else {
+        target.stats.failed++;
+        suiteResult.failed++;
+        stopping = stopping || stopOnFailure;
+    }
+    emit programFinished(result, target.stats.name, suiteResult.attempts[programIndex]);
+
+    dispatch();
+}
+
+void RegressionScheduler::requeueElsewhere(int failedTarget, int programIndex)
+{
+    // Shortest queue among the live targets this program has not failed on yet
+    Target *best = nullptr;
+    for (int t = 0; t < int(targets.size()); t++) {
+        Target *candidate = targets[t].get();
+        if (t == failedTarget || candidate->stats.retired || triedTargets[programIndex].contains(t)) {
+            continue;
+        }
+        if (!best || candidate->queue.size() < best->queue.size()) {
+            best = candidate;
+        }
+    }
+    if (best) {
+        best->queue.prepend(programIndex);
+    }
+    // Otherwise it stays unscheduled and is reported as skipped
+}
+
+void RegressionScheduler::complete()
+{
+    running = false;
+    suiteResult.wallMs = wallClock.elapsed();
+    suiteResult.skipped = 0;
+    for (int i = 0; i < done.size(); i++) {
+        if (!done[i]) {
+            suiteResult.skipped++;
+            suiteResult.attempts[i] = 0;
+            suiteResult.results[i] = ProgramResult();
+            suiteResult.results[i].name = programs[i].name;
+            suiteResult.results[i].failure = "Not run";
+        }
+    }
+    suiteResult.targetStats.clear();
+    for (auto& target : targets) {
+        target->stats.recoveries = target->session->recoveryCount() - target->recoveriesAtStart;
+        suiteResult.targetStats.append(target->stats);
+    }
+    promise.finish(suiteResult);
+}
@@ -0,0 +1,141 @@
+#ifndef REGRESSIONSCHEDULER_H
+#define REGRESSIONSCHEDULER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QList>
+#include <QSet>
+#include <memory>
+#include "programrunner.h"
+#include "sessionmetrics.h"
+
+struct TargetStats {
+    QString name;
+    int programsRun = 0;
+    int passed = 0;
+    int failed = 0;
+    int transportFailures = 0;
+    int stolen = 0;             // programs this target took from another's queue
+    quint64 recoveries = 0;     // hangs the session's watchdog recovered from
+    qint64 busyMs = 0;
+    bool retired = false;       // dropped from the pool after repeated link failures
+
+    double utilisation(qint64 wallMs) const { return wallMs > 0 ? double(busyMs) / wallMs : 0; }
+};
+
+struct SuiteResult {
+    QVector<ProgramResult> results;     // in suite order
+    QVector<QString> targets;           // target that produced each result
+    QVector<int> attempts;
+    QVector<TargetStats> targetStats;
+    qint64 wallMs = 0;
+    int passed = 0;
+    int failed = 0;
+    int skipped = 0;
+
+    bool allPassed() const { return failed == 0 && skipped == 0; }
+    QJsonObject toJson() const;
+    bool writeJUnit(const QString& fileName, const QString& suiteName, QString& errorMessage) const;
+};
+
+// Runs a suite over a pool of targets (serial ports, simulated cores, any
+// QIODevice). Each target has its own deque of programs, dealt round-robin;
+// a target that drains its deque steals from the back of the longest one,
+// so fast targets end up doing more of the work. A program whose link
+// failed is retried on a target it has not been tried on yet.
+//
+// Targets are event-driven on the calling thread: every session only waits
+// on its device, so throughput grows with the number of boards.
+class RegressionScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RegressionScheduler(QObject *parent = nullptr);
+    ~RegressionScheduler();
+
+    // The device must already be open; it is not owned
+    void addTarget(const QString& name, QIODevice *device);
+    int targetCount() const { return targets.size(); }
+
+    void setRunnerOptions(const ProgramRunner::Options& options) { runnerOptions = options; }
+    // Applied to targets added afterwards
+    void setLinkTiming(int baudRate, int marginMs) { linkBaudRate = baudRate; deadlineMarginMs = marginMs; }
+    void setMaxAttempts(int attempts) { maxAttempts = qMax(1, attempts); }
+    void setStopOnFailure(bool stop) { stopOnFailure = stop; }
+    // Applied to targets added afterwards; each registers counters under its name
+    void setMetrics(MetricsRegistry *registry) { metricsRegistry = registry; }
+    // Applied to targets added afterwards: each session mirrors its board in
+    // a reference model, for ProgramRunner::Options::compareWithReference
+    void setReferenceModels(bool enabled) { referenceModels = enabled; }
+    // Applied to targets added afterwards: each session gets its own devices
+    // at these addresses
+    void setDeviceRegions(const QVector<MemoryMap::Region>& regions) { deviceRegions = regions; }
+    // Applied to targets added afterwards: their sessions serve loads and
+    // stores from this one memory, each as a client named after the target.
+    // Programs dealt to different targets run at the same time, so a suite
+    // of one program per target runs them side by side. Not owned.
+    void setSharedMemory(SharedMemory *memory) { sharedMemory = memory; }
+    // Opens a waveform per target added so far: the file itself for a single
+    // target, otherwise "name-target.vcd"
+    bool recordWaveforms(const QString& fileName, QString& errorMessage);
+    // Same naming for indexed captures; each index is written when its
+    // target goes away
+    bool recordCaptures(const QString& fileName, QString& errorMessage);
+
+    AsyncResult<SuiteResult> run(const QVector<TestProgram>& suite);
+
+signals:
+    void programFinished(const ProgramResult& result, const QString& target, int attempt);
+
+private:
+    struct Target {
+        TargetStats stats;
+        QIODevice *device = nullptr;
+        SessionMetrics metrics;
+        std::unique_ptr<ReferenceModel> reference;
+        std::unique_ptr<MemoryMap> devices;
+        std::unique_ptr<VcdWriter> waveform;
+        std::unique_ptr<CaptureWriter> capture;
+        std::unique_ptr<RiscVSession> session;
+        std::unique_ptr<ProgramRunner> runner;
+        QList<int> queue;
+        QElapsedTimer busy;
+        bool idle = true;
+        int consecutiveTransportFailures = 0;
+        quint64 recoveriesAtStart = 0;
+    };
+
+    static const int RetireAfterTransportFailures = 2;
+
+    QString targetFileName(const QString& fileName, const QString& target, const QString& defaultSuffix) const;
+    bool takeWork(int targetIndex, int& programIndex);
+    void dispatch();
+    void finished(int targetIndex, int programIndex, const ProgramResult& result);
+    void requeueElsewhere(int failedTarget, int programIndex);
+    void complete();
+
+    std::vector<std::unique_ptr<Target>> targets;
+    ProgramRunner::Options runnerOptions;
+    int maxAttempts;
+    bool stopOnFailure;
+    int linkBaudRate;
+    int deadlineMarginMs;
+    MetricsRegistry *metricsRegistry;
+    bool referenceModels;
+    QVector<MemoryMap::Region> deviceRegions;
+    SharedMemory *sharedMemory;
+
+    QVector<TestProgram> programs;
+    QVector<QSet<int>> triedTargets;
+    QVector<bool> done;
+    SuiteResult suiteResult;
+    AsyncPromise<SuiteResult> promise;
+    QElapsedTimer wallClock;
+    int remaining;
+    bool running;
+    bool stopping;
+};
+
+#endif // REGRESSIONSCHEDULER_H
@@ -1,5 +1,9 @@
 #include "riscvmachinecodeconverter.h"
+#include "tracing.h"
+#include "instructioncoverage.h"
+#include "rvassembler.h"
 #include <QStringList>
+#include <QSet>
 #include <QRegularExpression>
 #include <QDebug>
 
@@ -10,102 +14,172 @@ RiscVMachineCodeConverter::RiscVMachineCodeConverter()
 
 void RiscVMachineCodeConverter::initializeMaps()
 {
-    // Initialize register mappings
+    // Same table as the compile-time encoder, so the two cannot drift apart
     registerMap.clear();
     for (int i = 0; i < 32; i++) {
         registerMap[QString("x%1").arg(i)] = i;
+        registerMap[rv::registerNames[i]] = i;
     }
-    // ABI names
-    registerMap["zero"] = 0;
-    registerMap["ra"] = 1;
-    registerMap["sp"] = 2;
-    registerMap["gp"] = 3;
-    registerMap["tp"] = 4;
-    registerMap["t0"] = 5; registerMap["t1"] = 6; registerMap["t2"] = 7;
-    registerMap["s0"] = 8; registerMap["s1"] = 9;
-    registerMap["a0"] = 10; registerMap["a1"] = 11; registerMap["a2"] = 12;
-    registerMap["a3"] = 13; registerMap["a4"] = 14; registerMap["a5"] = 15;
-    registerMap["a6"] = 16; registerMap["a7"] = 17;
-    registerMap["s2"] = 18; registerMap["s3"] = 19; registerMap["s4"] = 20;
-    registerMap["s5"] = 21; registerMap["s6"] = 22; registerMap["s7"] = 23;
-    registerMap["s8"] = 24; registerMap["s9"] = 25; registerMap["s10"] = 26;
-    registerMap["s11"] = 27;
-    registerMap["t3"] = 28; registerMap["t4"] = 29; registerMap["t5"] = 30;
-    registerMap["t6"] = 31;
-
-    // R-type instructions (opcode, funct3, funct7)
-    opcodeMap["add"] = 0x33;  funct3Map["add"] = 0x0;  funct7Map["add"] = 0x00;
-    opcodeMap["sub"] = 0x33;  funct3Map["sub"] = 0x0;  funct7Map["sub"] = 0x20;
-    opcodeMap["sll"] = 0x33;  funct3Map["sll"] = 0x1;  funct7Map["sll"] = 0x00;
-    opcodeMap["slt"] = 0x33;  funct3Map["slt"] = 0x2;  funct7Map["slt"] = 0x00;
-    opcodeMap["sltu"] = 0x33; funct3Map["sltu"] = 0x3; funct7Map["sltu"] = 0x00;
-    opcodeMap["xor"] = 0x33;  funct3Map["xor"] = 0x4;  funct7Map["xor"] = 0x00;
-    opcodeMap["srl"] = 0x33;  funct3Map["srl"] = 0x5;  funct7Map["srl"] = 0x00;
-    opcodeMap["sra"] = 0x33;  funct3Map["sra"] = 0x5;  funct7Map["sra"] = 0x20;
-    opcodeMap["or"] = 0x33;   funct3Map["or"] = 0x6;   funct7Map["or"] = 0x00;
-    opcodeMap["and"] = 0x33;  funct3Map["and"] = 0x7;  funct7Map["and"] = 0x00;
-
-    // I-type instructions
-    opcodeMap["addi"] = 0x13;  funct3Map["addi"] = 0x0;
-    opcodeMap["slti"] = 0x13;  funct3Map["slti"] = 0x2;
-    opcodeMap["sltiu"] = 0x13; funct3Map["sltiu"] = 0x3;
-    opcodeMap["xori"] = 0x13;  funct3Map["xori"] = 0x4;
-    opcodeMap["ori"] = 0x13;   funct3Map["ori"] = 0x6;
-    opcodeMap["andi"] = 0x13;  funct3Map["andi"] = 0x7;
-    opcodeMap["slli"] = 0x13;  funct3Map["slli"] = 0x1; funct7Map["slli"] = 0x00;
-    opcodeMap["srli"] = 0x13;  funct3Map["srli"] = 0x5; funct7Map["srli"] = 0x00;
-    opcodeMap["srai"] = 0x13;  funct3Map["srai"] = 0x5; funct7Map["srai"] = 0x20;
-
-    // Load instructions (I-type)
-    opcodeMap["lb"] = 0x03;   funct3Map["lb"] = 0x0;
-    opcodeMap["lh"] = 0x03;   funct3Map["lh"] = 0x1;
-    opcodeMap["lw"] = 0x03;   funct3Map["lw"] = 0x2;
-    opcodeMap["lbu"] = 0x03;  funct3Map["lbu"] = 0x4;
-    opcodeMap["lhu"] = 0x03;  funct3Map["lhu"] = 0x5;
-
-    // JALR (I-type)
-    opcodeMap["jalr"] = 0x67; funct3Map["jalr"] = 0x0;
-
-    // S-type instructions (Store)
-    opcodeMap["sb"] = 0x23;   funct3Map["sb"] = 0x0;
-    opcodeMap["sh"] = 0x23;   funct3Map["sh"] = 0x1;
-    opcodeMap["sw"] = 0x23;   funct3Map["sw"] = 0x2;
-
-    // B-type instructions (Branch)
-    opcodeMap["beq"] = 0x63;  funct3Map["beq"] = 0x0;
-    opcodeMap["bne"] = 0x63;  funct3Map["bne"] = 0x1;
-    opcodeMap["blt"] = 0x63;  funct3Map["blt"] = 0x4;
-    opcodeMap["bge"] = 0x63;  funct3Map["bge"] = 0x5;
-    opcodeMap["bltu"] = 0x63; funct3Map["bltu"] = 0x6;
-    opcodeMap["bgeu"] = 0x63; funct3Map["bgeu"] = 0x7;
-
-    // U-type instructions
-    opcodeMap["lui"] = 0x37;
-    opcodeMap["auipc"] = 0x17;
-
-    // J-type instructions
-    opcodeMap["jal"] = 0x6f;
-
-    // SYSTEM instructions (I-type)
-    opcodeMap["ecall"] = 0x73;  funct3Map["ecall"] = 0x0; funct12Map["ecall"] = 0x000;
-    opcodeMap["ebreak"] = 0x73; funct3Map["ebreak"] = 0x0; funct12Map["ebreak"] = 0x001;
-    opcodeMap["csrrw"] = 0x73;  funct3Map["csrrw"] = 0x1;
-    opcodeMap["csrrs"] = 0x73;  funct3Map["csrrs"] = 0x2;
-    opcodeMap["csrrc"] = 0x73;  funct3Map["csrrc"] = 0x3;
-    opcodeMap["csrrwi"] = 0x73; funct3Map["csrrwi"] = 0x5;
-    opcodeMap["csrrsi"] = 0x73; funct3Map["csrrsi"] = 0x6;
-    opcodeMap["csrrci"] = 0x73; funct3Map["csrrci"] = 0x7;
-
-    // FENCE instruction
-    opcodeMap["fence"] = 0x0f; funct3Map["fence"] = 0x0;
+
+    for (const rv::Instruction& instruction : rv::instructions) {
+        const QString name = instruction.name;
+        opcodeMap[name] = instruction.opcode;
+        funct3Map[name] = instruction.funct3;
+        if (instruction.funct7 >= 0) {
+            funct7Map[name] = quint32(instruction.funct7);
+        }
+        if (instruction.funct12 >= 0) {
+            funct12Map[name] = quint32(instruction.funct12);
+        }
+    }
+}
+
+namespace {
+
+bool parseConstant(const QString& text, quint32& value)
+{
+    QString digits = text.trimmed();
+    const bool negative = digits.startsWith('-');
+    if (negative || digits.startsWith('+')) {
+        digits = digits.mid(1);
+    }
+    bool ok;
+    qint64 magnitude;
+    if (digits.startsWith("0x", Qt::CaseInsensitive)) {
+        magnitude = digits.mid(2).toLongLong(&ok, 16);
+    } else if (digits.startsWith("0b", Qt::CaseInsensitive)) {
+        magnitude = digits.mid(2).toLongLong(&ok, 2);
+    } else {
+        magnitude = digits.toLongLong(&ok, 10);
+    }
+    // Anything a register can hold, written signed or unsigned
+    if (!ok || magnitude > (negative ? 0x80000000LL : 0xFFFFFFFFLL)) {
+        return false;
+    }
+    value = quint32(negative ? -magnitude : magnitude);
+    return true;
+}
+
+QStringList loadImmediate(const QString& rd, quint32 value)
+{
+    // Same choice as rv::li; lui takes the full value, written signed
+    if (rv::hi(value) == 0) {
+        return {QString("addi %1, x0, %2").arg(rd).arg(rv::lo(value))};
+    }
+    QStringList sequence{QString("lui %1, %2").arg(rd).arg(qint32(rv::hi(value) << 12))};
+    if (rv::lo(value) != 0) {
+        sequence.append(QString("addi %1, %1, %2").arg(rd).arg(rv::lo(value)));
+    }
+    return sequence;
+}
+
+}
+
+bool RiscVMachineCodeConverter::expandPseudoInstruction(const QString& instruction, QStringList& expansion,
+                                                        QString& errorMessage)
+{
+    static const QRegularExpression separators("[\\s,]+");
+    static const QRegularExpression relocation(R"(%(hi|lo)\(\s*([^)\s]+)\s*\))");
+    static const QRegularExpression identifier(R"(^[A-Za-z_.][\w.]*$)");
+
+    // %hi/%lo of a number become the number; of a label, they wait for linking
+    QString text = instruction.trimmed();
+    if (text.contains('%')) {
+        QRegularExpressionMatchIterator matches = relocation.globalMatch(text);
+        QString resolved;
+        int end = 0;
+        while (matches.hasNext()) {
+            QRegularExpressionMatch match = matches.next();
+            quint32 value;
+            if (!parseConstant(match.captured(2), value)) {
+                continue;
+            }
+            resolved += text.mid(end, match.capturedStart() - end);
+            resolved += match.captured(1) == "hi" ? QString::number(qint32(rv::hi(value) << 12))
+                                                  : QString::number(rv::lo(value));
+            end = match.capturedEnd();
+        }
+        text = resolved + text.mid(end);
+    }
+
+    const QStringList parts = text.split(separators, Qt::SkipEmptyParts);
+    const QString mnemonic = parts.isEmpty() ? QString() : parts[0].toLower();
+    const int operands = parts.size() - 1;
+    auto expect = [&](int count, const QString& syntax) {
+        if (operands != count) {
+            errorMessage = QString("%1 expects %2").arg(mnemonic, syntax);
+            return false;
+        }
+        return true;
+    };
+
+    if (mnemonic == "nop") {
+        if (!expect(0, "no operands")) return false;
+        expansion = QStringList{"addi x0, x0, 0"};
+    } else if (mnemonic == "mv") {
+        if (!expect(2, "rd, rs")) return false;
+        expansion = QStringList{QString("addi %1, %2, 0").arg(parts[1], parts[2])};
+    } else if (mnemonic == "li") {
+        if (!expect(2, "rd, constant")) return false;
+        quint32 value;
+        if (!parseConstant(parts[2], value)) {
+            errorMessage = QString("li needs a 32-bit constant, not '%1'; use la for labels").arg(parts[2]);
+            return false;
+        }
+        expansion = loadImmediate(parts[1], value);
+    } else if (mnemonic == "la") {
+        if (!expect(2, "rd, label or address")) return false;
+        quint32 value;
+        if (parseConstant(parts[2], value)) {
+            expansion = loadImmediate(parts[1], value);
+        } else if (identifier.match(parts[2]).hasMatch()) {
+            // The address is not known yet, so both halves are kept
+            expansion = QStringList{QString("lui %1, %hi(%2)").arg(parts[1], parts[2]),
+                                    QString("addi %1, %1, %lo(%2)").arg(parts[1], parts[2])};
+        } else {
+            errorMessage = QString("Invalid label or address: '%1'").arg(parts[2]);
+            return false;
+        }
+    } else if (mnemonic == "j") {
+        if (!expect(1, "offset or label")) return false;
+        expansion = QStringList{QString("jal x0, %1").arg(parts[1])};
+    } else if (mnemonic == "call") {
+        // jal reaches +-1 MiB, far more than a streamed program
+        if (!expect(1, "offset or label")) return false;
+        expansion = QStringList{QString("jal ra, %1").arg(parts[1])};
+    } else if (mnemonic == "ret") {
+        if (!expect(0, "no operands")) return false;
+        expansion = QStringList{"jalr x0, ra, 0"};
+    } else {
+        expansion = QStringList{text};
+    }
+    return true;
 }
 
 bool RiscVMachineCodeConverter::convertToMachineCode(const QString& instruction, quint32& machineCode, QString& errorMessage)
 {
+    TRACE_ZONE("converter.assemble");
+    static const QSet<QString> pseudoInstructions = {"nop", "mv", "li", "la", "j", "call", "ret"};
+
     // Clean and split the instruction
     QString cleanInstruction = instruction.trimmed().toLower();
     QStringList parts = cleanInstruction.split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
 
+    // Real instructions skip the rewrite
+    if (!parts.isEmpty() && (pseudoInstructions.contains(parts[0]) || cleanInstruction.contains('%'))) {
+        QStringList expansion;
+        if (!expandPseudoInstruction(instruction, expansion, errorMessage)) {
+            return false;
+        }
+        if (expansion.size() != 1) {
+            errorMessage = QString("'%1' expands to %2 instructions: %3")
+                               .arg(instruction.trimmed()).arg(expansion.size()).arg(expansion.join("; "));
+            return false;
+        }
+        cleanInstruction = expansion.first().toLower();
+        parts = cleanInstruction.split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+    }
+
     if (parts.isEmpty()) {
         errorMessage = "Empty instruction";
         return false;
@@ -453,3 +527,83 @@ QString RiscVMachineCodeConverter::formatMachineCode(quint32 machineCode)
 {
     return QString("0x%1").arg(machineCode, 8, 16, QChar('0'));
 }
+
+QString RiscVMachineCodeConverter::disassemble(quint32 machineCode)
+{
+    const quint32 opcode = machineCode & 0x7F;
+    const int rd = (machineCode >> 7) & 0x1F;
+    const quint32 funct3 = (machineCode >> 12) & 0x7;
+    const int rs1 = (machineCode >> 15) & 0x1F;
+    const int rs2 = (machineCode >> 20) & 0x1F;
+    const quint32 funct7 = machineCode >> 25;
+    const qint32 immI = qint32(machineCode) >> 20;
+
+    const InstructionCoverage::InstructionKind *match = nullptr;
+    for (const InstructionCoverage::InstructionKind& kind : InstructionCoverage::instructionKinds()) {
+        if (kind.opcode != opcode) {
+            continue;
+        }
+        const bool hasFunct3 = kind.format != InstructionCoverage::FormatU && kind.format != InstructionCoverage::FormatJ;
+        if ((hasFunct3 && kind.funct3 != funct3) || (kind.funct7 >= 0 && quint32(kind.funct7) != funct7)) {
+            continue;
+        }
+        match = &kind;
+        break;
+    }
+    if (!match) {
+        return QString(".word %1").arg(formatMachineCode(machineCode));
+    }
+
+    const QString name = match->name;
+    switch (match->format) {
+    case InstructionCoverage::FormatR:
+        return QString("%1 x%2, x%3, x%4").arg(name).arg(rd).arg(rs1).arg(rs2);
+
+    case InstructionCoverage::FormatI:
+        if (opcode == 0x73 && funct3 == 0) {
+            return (machineCode >> 20) == 1 ? "ebreak" : "ecall";
+        }
+        if (opcode == 0x73) {
+            return QString("%1 x%2, %3").arg(name).arg(rd).arg(machineCode >> 20);
+        }
+        if (opcode == 0x0F) {
+            return name;
+        }
+        if (opcode == 0x03) {
+            return QString("%1 x%2, %3(x%4)").arg(name).arg(rd).arg(immI).arg(rs1);
+        }
+        if (match->funct7 >= 0) {
+            return QString("%1 x%2, x%3, %4").arg(name).arg(rd).arg(rs1).arg(rs2);
+        }
+        return QString("%1 x%2, x%3, %4").arg(name).arg(rd).arg(rs1).arg(immI);
+
+    case InstructionCoverage::FormatS: {
+        const qint32 offset = (qint32(machineCode & 0xFE000000) >> 20) | qint32((machineCode >> 7) & 0x1F);
+        return QString("%1 x%2, %3(x%4)").arg(name).arg(rs2).arg(offset).arg(rs1);
+    }
+
+    case InstructionCoverage::FormatB: {
+        const qint32 offset = (qint32(machineCode & 0x80000000) >> 19)
+                              | qint32((machineCode & 0x80) << 4)
+                              | qint32((machineCode >> 20) & 0x7E0)
+                              | qint32((machineCode >> 7) & 0x1E);
+        return QString("%1 x%2, x%3, %4").arg(name).arg(rs1).arg(rs2).arg(offset);
+    }
+
+    case InstructionCoverage::FormatU:
+        // The assembler takes the full value and keeps its upper 20 bits
+        return QString("%1 x%2, %3").arg(name).arg(rd).arg(qint32(machineCode & 0xFFFFF000));
+
+    case InstructionCoverage::FormatJ: {
+        const qint32 offset = (qint32(machineCode & 0x80000000) >> 11)
+                              | qint32(machineCode & 0xFF000)
+                              | qint32((machineCode >> 9) & 0x800)
+                              | qint32((machineCode >> 20) & 0x7FE);
+        return QString("%1 x%2, %3").arg(name).arg(rd).arg(offset);
+    }
+
+    default:
+        break;
+    }
+    return QString(".word %1").arg(formatMachineCode(machineCode));
+}
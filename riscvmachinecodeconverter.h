@@ -2,6 +2,7 @@
 #define RISCVMACHINECODECONVERTER_H
 
 #include <QString>
+#include <QStringList>
 #include <QMap>
 
 class RiscVMachineCodeConverter
@@ -9,12 +10,24 @@ class RiscVMachineCodeConverter
 public:
     RiscVMachineCodeConverter();
 
-    // Main conversion function
+    // Main conversion function; a pseudo-instruction is accepted when it
+    // expands to a single instruction
     bool convertToMachineCode(const QString& instruction, quint32& machineCode, QString& errorMessage);
 
+    // Rewrites nop, mv, li, la, j, call and ret, and %hi/%lo of numbers, as
+    // the fewest real instructions; anything else comes back unchanged as the
+    // only element. la and %hi/%lo of a label are left for AssemblyProgram to
+    // resolve. %hi(x) is the rounded upper part as lui takes it here, a
+    // multiple of 4096.
+    static bool expandPseudoInstruction(const QString& instruction, QStringList& expansion, QString& errorMessage);
+
     // Utility function to format machine code as string
     static QString formatMachineCode(quint32 machineCode);
 
+    // Inverse of convertToMachineCode, in the syntax it accepts; words that
+    // are not RV32I instructions come back as ".word 0x..."
+    static QString disassemble(quint32 machineCode);
+
 private:
     void initializeMaps();
     bool parseRTypeInstruction(const QStringList& parts, quint32& machineCode, QString& errorMessage);
@@ -0,0 +1,531 @@
+#include "riscvsession.h"
+#include "tracing.h"
+
+RiscVSession::RiscVSession(QObject *parent)
+    : QObject(parent)
+    , ioDevice(nullptr)
+    , ownedMemory(new HostMemory)
+    , sharedMemory(nullptr)
+    , sharedClient(0)
+    , memoryMap(nullptr)
+    , instructionCoverage(nullptr)
+    , referenceModel(nullptr)
+    , metrics(nullptr)
+    , waveform(nullptr)
+    , capture(nullptr)
+    , breakpoints(nullptr)
+    , inFlight(false)
+    , watchdogEnabled(true)
+    , linkBaudRate(115200)
+    , deadlineMarginMs(100)
+    , recovering(false)
+    , settling(false)
+    , resetAttempts(0)
+    , readiesDuringRecovery(0)
+    , recoveries(0)
+{
+    hostMemory = ownedMemory.get();
+
+    watchdog.setSingleShot(true);
+    connect(&watchdog, &QTimer::timeout, this, &RiscVSession::deadlineExpired);
+}
+
+RiscVSession::~RiscVSession()
+{
+    cancelAll("Session destroyed");
+}
+
+void RiscVSession::setDevice(QIODevice *device)
+{
+    if (ioDevice) {
+        disconnect(ioDevice, nullptr, this, nullptr);
+    }
+
+    ioDevice = device;
+    decoder.reset();
+
+    if (ioDevice) {
+        connect(ioDevice, &QIODevice::readyRead, this, &RiscVSession::readAvailable);
+    }
+}
+
+void RiscVSession::setLinkTiming(int baudRate, int marginMs)
+{
+    linkBaudRate = qMax(1, baudRate);
+    deadlineMarginMs = qMax(0, marginMs);
+}
+
+void RiscVSession::setWatchdogEnabled(bool enabled)
+{
+    watchdogEnabled = enabled;
+    if (!enabled) {
+        watchdog.stop();
+    }
+}
+
+int RiscVSession::deadlineFor(const Operation& operation) const
+{
+    using namespace UartProtocol;
+
+    // Bytes both ways for the whole exchange, ending with the ready byte
+    int bytes = 1;
+    switch (operation.kind) {
+    case Operation::Execute:
+        bytes += InstructionFrameSize;
+        switch (responseFor(operation.machineCode)) {
+        case Response::Store: bytes += StoreFrameSize; break;
+        case Response::Load:  bytes += LoadFrameSize + WordSize; break;
+        default: break;
+        }
+        break;
+    case Operation::ReadPC:
+        bytes += 1 + WordSize;
+        break;
+    case Operation::Reset:
+        bytes += 1;
+        break;
+    }
+    return int((bytes * 10 * 1000LL + linkBaudRate - 1) / linkBaudRate) + deadlineMarginMs;
+}
+
+QString RiscVSession::describe(const Operation& operation)
+{
+    switch (operation.kind) {
+    case Operation::Execute:
+        return QString("instruction 0x%1").arg(operation.machineCode, 8, 16, QChar('0'));
+    case Operation::ReadPC:
+        return "PC request";
+    case Operation::Reset:
+        return "reset";
+    }
+    return QString();
+}
+
+void RiscVSession::setMemory(HostMemory *memory)
+{
+    hostMemory = memory ? memory : ownedMemory.get();
+}
+
+SessionFuture RiscVSession::execute(quint32 machineCode)
+{
+    Operation operation;
+    operation.kind = Operation::Execute;
+    operation.machineCode = machineCode;
+    return enqueue(operation);
+}
+
+SessionFuture RiscVSession::execute(const QString& instruction)
+{
+    quint32 machineCode;
+    QString errorMessage;
+    if (!converter.convertToMachineCode(instruction, machineCode, errorMessage)) {
+        AsyncPromise<SessionResult> promise;
+        SessionResult result;
+        result.errorMessage = QString("Invalid RISC-V instruction: %1").arg(errorMessage);
+        promise.finish(result);
+        return promise.future();
+    }
+    return execute(machineCode);
+}
+
+SessionFuture RiscVSession::readPC()
+{
+    Operation operation;
+    operation.kind = Operation::ReadPC;
+    return enqueue(operation);
+}
+
+SessionFuture RiscVSession::reset()
+{
+    Operation operation;
+    operation.kind = Operation::Reset;
+    return enqueue(operation);
+}
+
+SessionFuture RiscVSession::enqueue(Operation operation)
+{
+    operation.result.machineCode = operation.machineCode;
+    SessionFuture future = operation.promise.future();
+    queue.enqueue(operation);
+    startNext();
+    return future;
+}
+
+bool RiscVSession::writeBytes(const char *data, qint64 size)
+{
+    qint64 written = ioDevice->write(data, size);
+    if (metrics && written > 0) {
+        metrics->bytesSent->add(quint64(written));
+    }
+    if (waveform && written > 0) {
+        waveform->bytesSent(data, written);
+    }
+    return written == size;
+}
+
+void RiscVSession::updateQueueDepth()
+{
+    if (metrics) {
+        metrics->queueDepth->set(pendingOperations());
+    }
+}
+
+void RiscVSession::startNext()
+{
+    TRACE_ZONE("session.send");
+    while (!inFlight && !queue.isEmpty()) {
+        current = queue.dequeue();
+
+        if (!ioDevice || !ioDevice->isOpen()) {
+            current.result.errorMessage = "Not connected to any serial port.";
+            if (metrics) {
+                metrics->failedOperations->add();
+            }
+            current.promise.finish(current.result);
+            continue;
+        }
+
+        bool written = false;
+        switch (current.kind) {
+        case Operation::Execute: {
+            decoder.expect(UartProtocol::responseFor(current.machineCode));
+            QByteArray frame = UartProtocol::instructionFrame(current.machineCode);
+            written = writeBytes(frame.constData(), frame.size());
+            if (written) {
+                if (instructionCoverage) {
+                    instructionCoverage->record(current.machineCode);
+                }
+                if (waveform) {
+                    waveform->instructionSent(current.machineCode);
+                }
+                if (capture) {
+                    capture->instructionSent(current.machineCode);
+                }
+                emit instructionSent(current.machineCode);
+            }
+            break;
+        }
+        case Operation::ReadPC:
+            decoder.expect(UartProtocol::Response::ProgramCounter);
+            written = writeBytes(&UartProtocol::ProgramCounterCommand, 1);
+            if (written) {
+                if (waveform) {
+                    waveform->commandSent(UartProtocol::ProgramCounterCommand);
+                }
+                if (capture) {
+                    capture->commandSent(UartProtocol::ProgramCounterCommand);
+                }
+                emit commandSent(quint8(UartProtocol::ProgramCounterCommand));
+            }
+            break;
+        case Operation::Reset:
+            decoder.expect(UartProtocol::Response::Ready);
+            written = writeBytes(&UartProtocol::ResetCommand, 1);
+            if (written) {
+                if (waveform) {
+                    waveform->commandSent(UartProtocol::ResetCommand);
+                }
+                if (capture) {
+                    capture->commandSent(UartProtocol::ResetCommand);
+                }
+                emit commandSent(quint8(UartProtocol::ResetCommand));
+            }
+            break;
+        }
+
+        if (!written) {
+            decoder.reset();
+            current.result.errorMessage = QString("Failed to send: %1").arg(ioDevice->errorString());
+            if (metrics) {
+                metrics->failedOperations->add();
+            }
+            current.promise.finish(current.result);
+            continue;
+        }
+        inFlight = true;
+        if (metrics) {
+            commandTimer.start();
+        }
+        if (watchdogEnabled) {
+            watchdog.start(deadlineFor(current));
+        }
+    }
+    updateQueueDepth();
+}
+
+void RiscVSession::finishCurrent(bool ok, const QString& errorMessage)
+{
+    Operation finished = current;
+    current = Operation();
+    inFlight = false;
+    watchdog.stop();
+
+    finished.result.ok = ok;
+    finished.result.errorMessage = errorMessage;
+
+    // Send the next queued command before running continuations so the
+    // link never idles while the caller reacts to this result
+    startNext();
+
+    TRACE_ZONE("session.continuations");
+    finished.promise.finish(finished.result);
+}
+
+void RiscVSession::cancelAll(const QString& reason)
+{
+    QQueue<Operation> cancelled;
+    watchdog.stop();
+    recovering = false;
+    settling = false;
+    if (inFlight) {
+        cancelled.enqueue(current);
+        current = Operation();
+        inFlight = false;
+    }
+    while (!queue.isEmpty()) {
+        cancelled.enqueue(queue.dequeue());
+    }
+    decoder.reset();
+    if (metrics && !cancelled.isEmpty()) {
+        metrics->failedOperations->add(quint64(cancelled.size()));
+        updateQueueDepth();
+    }
+
+    for (Operation& operation : cancelled) {
+        operation.result.ok = false;
+        operation.result.errorMessage = reason;
+        operation.promise.finish(operation.result);
+    }
+}
+
+void RiscVSession::readAvailable()
+{
+    if (!ioDevice) {
+        return;
+    }
+    TRACE_ZONE("session.readAvailable");
+
+    // Drain into a stack buffer and decode in place: no QByteArray per
+    // readyRead, and a burst from a socket or the simulator is one pass
+    char chunk[ReadChunk];
+    qint64 received = 0;
+    qint64 count;
+    while ((count = ioDevice->read(chunk, ReadChunk)) > 0) {
+        received += count;
+        if (waveform) {
+            waveform->bytesReceived(chunk, count);
+        }
+        decoder.feed(chunk, int(count));
+
+        ProtocolDecoder::Event event;
+        while (decoder.nextEvent(event)) {
+            handleEvent(event);
+        }
+        if (!ioDevice) {
+            break;      // an event handler detached the device
+        }
+    }
+    if (metrics) {
+        metrics->bytesReceived->add(quint64(received));
+    }
+}
+
+void RiscVSession::handleEvent(const ProtocolDecoder::Event& event)
+{
+    if (waveform) {
+        waveform->eventDecoded(event);
+    }
+    if (capture) {
+        capture->eventDecoded(event);
+    }
+
+    switch (event.type) {
+    case ProtocolDecoder::Event::Store: {
+        TRACE_ZONE("session.memoryService");
+        if (memoryMap && memoryMap->contains(event.address)) {
+            memoryMap->store(event.address, event.value);
+        } else if (sharedMemory) {
+            sharedMemory->writeWord(event.address, event.value, sharedClient);
+        } else {
+            hostMemory->writeWord(event.address, event.value);
+        }
+        current.result.access = SessionResult::StoreAccess;
+        current.result.address = event.address;
+        current.result.value = event.value;
+        if (metrics) {
+            metrics->stores->add();
+        }
+        emit storeReceived(event.address, event.flags, event.value);
+        if (breakpoints) {
+            if (const BreakpointSet::Breakpoint *hit = breakpoints->onStore(event.address, event.value)) {
+                emit watchpointHit(hit->toString(), event.address, event.value);
+            }
+        }
+        break;
+    }
+
+    case ProtocolDecoder::Event::LoadRequest: {
+        TRACE_ZONE("session.memoryService");
+        quint32 value = memoryMap && memoryMap->contains(event.address) ? memoryMap->load(event.address)
+                        : sharedMemory ? sharedMemory->readWord(event.address, sharedClient)
+                                       : hostMemory->readWord(event.address);
+        char reply[UartProtocol::WordSize];
+        UartProtocol::writeWord(reply, value);
+        writeBytes(reply, sizeof(reply));
+        if (waveform) {
+            waveform->loadDataSent(value);
+        }
+        if (capture) {
+            capture->loadServed(event.address, event.flags, value);
+        }
+        current.result.access = SessionResult::LoadAccess;
+        current.result.address = event.address;
+        current.result.value = value;
+        if (metrics) {
+            metrics->loads->add();
+        }
+        emit loadServed(event.address, event.flags, value);
+        if (breakpoints) {
+            if (const BreakpointSet::Breakpoint *hit = breakpoints->onLoad(event.address, value)) {
+                emit watchpointHit(hit->toString(), event.address, value);
+            }
+        }
+        break;
+    }
+
+    case ProtocolDecoder::Event::ProgramCounter:
+        current.result.value = event.value;
+        emit programCounterReceived(event.value);
+        break;
+
+    case ProtocolDecoder::Event::CpuReady:
+        emit cpuReady();
+        if (recovering) {
+            // Each reset, and the hung command itself if it was only slow, can
+            // still answer; re-issuing on the first ready would let the stale
+            // ones complete the commands after it
+            readiesDuringRecovery++;
+            if (readiesDuringRecovery > resetAttempts) {
+                finishRecovery(true);
+            } else {
+                settling = true;
+                Operation reset;
+                reset.kind = Operation::Reset;
+                watchdog.start(deadlineFor(reset));
+            }
+        } else if (inFlight) {
+            if (referenceModel) {
+                if (current.kind == Operation::Execute) {
+                    referenceModel->execute(current.machineCode, memoryMap, current.result.value);
+                } else if (current.kind == Operation::Reset) {
+                    referenceModel->resetProgramCounter();
+                }
+            }
+            if (metrics) {
+                metrics->commandLatency->observeMicroseconds(quint64(commandTimer.nsecsElapsed() / 1000));
+                if (current.kind == Operation::Execute) {
+                    metrics->instructions->add();
+                }
+            }
+            finishCurrent(true);
+        }
+        break;
+
+    case ProtocolDecoder::Event::UnexpectedByte:
+        if (metrics) {
+            metrics->protocolErrors->add();
+        }
+        emit protocolError(QString("Unexpected byte 0x%1").arg(event.value, 2, 16, QChar('0')));
+        break;
+    }
+}
+
+void RiscVSession::deadlineExpired()
+{
+    if (!inFlight || !ioDevice || !ioDevice->isOpen()) {
+        return;
+    }
+
+    if (settling) {
+        // No more replies on the way: the core is listening to us again
+        finishRecovery(false);
+        return;
+    }
+
+    if (!recovering) {
+        recovering = true;
+        resetAttempts = 0;
+        readiesDuringRecovery = 0;
+        if (metrics) {
+            metrics->hangs->add();
+        }
+        emit hangDetected(describe(current), deadlineFor(current));
+    }
+
+    if (resetAttempts >= MaxResetAttempts) {
+        QString message = QString("Core did not recover from a hang after %1 resets").arg(resetAttempts);
+        emit recoveryFailed(message);
+        cancelAll(message);
+        return;
+    }
+
+    // Whatever half-frame the controller was in is abandoned; the next ready byte means it is listening again
+    resetAttempts++;
+    decoder.reset();
+    decoder.expect(UartProtocol::Response::Ready);
+    writeBytes(&UartProtocol::ResetCommand, 1);
+    if (waveform) {
+        waveform->commandSent(UartProtocol::ResetCommand);
+    }
+    if (capture) {
+        capture->commandSent(UartProtocol::ResetCommand);
+    }
+    emit commandSent(quint8(UartProtocol::ResetCommand));
+
+    Operation reset;
+    reset.kind = Operation::Reset;
+    watchdog.start(deadlineFor(reset));
+}
+
+void RiscVSession::finishRecovery(bool commandCompleted)
+{
+    recovering = false;
+    settling = false;
+    watchdog.stop();
+    recoveries++;
+    if (metrics) {
+        metrics->recoveries->add();
+    }
+    emit recovered(resetAttempts);
+    if (!inFlight) {
+        startNext();
+        return;
+    }
+
+    // One ready more than resets sent: the command ran after all, before the
+    // resets, so it is finished rather than run twice. Its PC reply, if any,
+    // was lost, so a PC read is simply asked again.
+    if (commandCompleted && current.kind != Operation::ReadPC) {
+        if (referenceModel) {
+            if (current.kind == Operation::Execute) {
+                referenceModel->execute(current.machineCode, memoryMap, current.result.value);
+            }
+            referenceModel->resetProgramCounter();
+        }
+        if (metrics && current.kind == Operation::Execute) {
+            metrics->instructions->add();
+        }
+        finishCurrent(true);
+        return;
+    }
+
+    if (referenceModel) {
+        referenceModel->resetProgramCounter();
+    }
+    inFlight = false;
+    current.result = SessionResult();
+    current.result.machineCode = current.machineCode;
+    queue.prepend(current);
+    current = Operation();
+    startNext();
+}
@@ -0,0 +1,177 @@
+#ifndef RISCVSESSION_H
+#define RISCVSESSION_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <memory>
+#include "asyncresult.h"
+#include "hostmemory.h"
+#include "sharedmemory.h"
+#include "memorymap.h"
+#include "uartprotocol.h"
+#include "riscvmachinecodeconverter.h"
+#include "instructioncoverage.h"
+#include "referencemodel.h"
+#include "sessionmetrics.h"
+#include "vcdwriter.h"
+#include "capturefile.h"
+#include "breakpoints.h"
+
+struct SessionResult {
+    enum Access { NoAccess, LoadAccess, StoreAccess };
+
+    bool ok = false;
+    QString errorMessage;
+    quint32 machineCode = 0;
+    quint32 value = 0;          // program counter, stored data or loaded data
+    quint32 address = 0;        // memory address for loads and stores
+    Access access = NoAccess;
+};
+
+using SessionFuture = AsyncResult<SessionResult>;
+
+// One connection to a core: sends commands, decodes the controller's replies
+// and serves its loads and stores from the host memory model. Operations can
+// be issued at any time; they are queued and sent back to back as soon as the
+// core reports CPU_READY, and each returns a future that finishes when the
+// core is ready again. No widgets, no blocking waits.
+//
+// Every command has a deadline derived from the bytes its exchange moves and
+// the link's baud rate. If the core misses it, the watchdog sends the reset
+// command until a ready byte comes back and then re-issues the command that
+// hung, so everything after the last completed command still runs.
+class RiscVSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RiscVSession(QObject *parent = nullptr);
+    ~RiscVSession();
+
+    // The device is not owned; it must be open for reading and writing
+    void setDevice(QIODevice *device);
+    QIODevice *device() const { return ioDevice; }
+
+    // Shared memory model; by default the session uses its own
+    void setMemory(HostMemory *memory);
+    HostMemory *memory() const { return hostMemory; }
+
+    // Optional memory shared with other sessions, as the given client; when
+    // set, loads and stores go there instead of memory(). Not owned.
+    void setSharedMemory(SharedMemory *memory, int client) { sharedMemory = memory; sharedClient = client; }
+    SharedMemory *shared() const { return sharedMemory; }
+
+    // Optional devices on the bus; loads and stores in their pages go to them
+    // instead of memory. Not owned.
+    void setMemoryMap(MemoryMap *map) { memoryMap = map; }
+    MemoryMap *devices() const { return memoryMap; }
+
+    void setCoverage(InstructionCoverage *coverage) { instructionCoverage = coverage; }
+
+    // Optional software mirror, stepped with every completed instruction
+    void setReferenceModel(ReferenceModel *model) { referenceModel = model; }
+    ReferenceModel *reference() const { return referenceModel; }
+
+    // Optional live counters; not owned, must outlive the session
+    void setMetrics(const SessionMetrics *sessionMetrics) { metrics = sessionMetrics; }
+
+    // Optional waveform of the link; not owned, must outlive the session
+    void setWaveform(VcdWriter *writer) { waveform = writer; }
+
+    // Optional indexed capture of every command and reply; not owned, must outlive the session
+    void setCapture(CaptureWriter *writer) { capture = writer; }
+
+    // Optional store and load watchpoints, checked on every access; not owned
+    void setBreakpoints(const BreakpointSet *set) { breakpoints = set; }
+
+    // Link timing for deadlines: 10 bits per byte at baudRate, plus a fixed
+    // margin for USB latency and host-side handling
+    void setLinkTiming(int baudRate, int marginMs);
+    void setWatchdogEnabled(bool enabled);
+    bool isRecovering() const { return recovering; }
+    quint64 recoveryCount() const { return recoveries; }    // hangs recovered from, not failed ones
+
+    SessionFuture execute(quint32 machineCode);
+    SessionFuture execute(const QString& instruction);
+    SessionFuture readPC();
+    SessionFuture reset();
+
+    int pendingOperations() const { return queue.size() + (inFlight ? 1 : 0); }
+    bool isBusy() const { return inFlight; }
+
+    // Fails every queued and in-flight operation, e.g. after a disconnect
+    void cancelAll(const QString& reason);
+
+signals:
+    void instructionSent(quint32 machineCode);
+    void commandSent(quint8 command);
+    void storeReceived(quint32 address, quint8 flags, quint32 value);
+    void loadServed(quint32 address, quint8 size, quint32 value);
+    void programCounterReceived(quint32 value);
+    void cpuReady();
+    void protocolError(const QString& message);
+    void hangDetected(const QString& operation, int deadlineMs);
+    void recovered(int resetAttempts);
+    void recoveryFailed(const QString& message);
+    void watchpointHit(const QString& watchpoint, quint32 address, quint32 value);
+
+private slots:
+    void readAvailable();
+    void deadlineExpired();
+
+private:
+    struct Operation {
+        enum Kind { Execute, ReadPC, Reset };
+        Kind kind = Execute;
+        quint32 machineCode = 0;
+        AsyncPromise<SessionResult> promise;
+        SessionResult result;
+    };
+
+    SessionFuture enqueue(Operation operation);
+    void startNext();
+    void finishCurrent(bool ok, const QString& errorMessage = QString());
+    void handleEvent(const ProtocolDecoder::Event& event);
+    bool writeBytes(const char *data, qint64 size);
+    int deadlineFor(const Operation& operation) const;
+    static QString describe(const Operation& operation);
+    void updateQueueDepth();
+    void finishRecovery(bool commandCompleted);
+
+    static const int MaxResetAttempts = 6;  // enough to flush a half-received instruction word
+    static const int ReadChunk = 4096;      // bytes decoded per read() in readAvailable
+
+    QIODevice *ioDevice;
+    HostMemory *hostMemory;
+    std::unique_ptr<HostMemory> ownedMemory;
+    SharedMemory *sharedMemory;
+    int sharedClient;
+    MemoryMap *memoryMap;
+    InstructionCoverage *instructionCoverage;
+    ReferenceModel *referenceModel;
+    const SessionMetrics *metrics;
+    VcdWriter *waveform;
+    CaptureWriter *capture;
+    const BreakpointSet *breakpoints;
+    QElapsedTimer commandTimer;
+    RiscVMachineCodeConverter converter;
+    ProtocolDecoder decoder;
+    QQueue<Operation> queue;
+    Operation current;
+    bool inFlight;
+
+    QTimer watchdog;
+    bool watchdogEnabled;
+    int linkBaudRate;
+    int deadlineMarginMs;
+    bool recovering;
+    bool settling;              // a ready came back; waiting out the rest before re-issuing
+    int resetAttempts;
+    int readiesDuringRecovery;
+    quint64 recoveries;
+};
+
+#endif // RISCVSESSION_H
@@ -0,0 +1,386 @@
+// Headless runner: streams assembly programs to cores over serial ports, ptys
+// or TCP (or to in-process simulated cores) and checks the memory they leave
+// behind. No display needed, so it can run unattended; the exit status, JSON
+// summary and optional JUnit XML report the outcome.
+//
+// Exit status: 0 all programs passed, 1 a program failed, 2 usage or connection error.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QTimer>
+#include <memory>
+#include <vector>
+#include "regressionscheduler.h"
+#include "simulatedcore.h"
+#include "faultylink.h"
+#include "transport.h"
+#include "memorypreload.h"
+#include "memorymap.h"
+#include "sharedmemory.h"
+#include "metricsserver.h"
+#include "tracing.h"
+
+namespace {
+
+enum ExitStatus { Passed = 0, Failed = 1, UsageError = 2 };
+
+bool parsePositive(const QString& text, int& value)
+{
+    bool ok;
+    value = text.toInt(&ok);
+    return ok && value > 0;
+}
+
+// "first" or "first-last", byte addresses
+bool parseRange(const QString& text, quint32& first, quint32& last)
+{
+    const int dash = text.indexOf('-');
+    if (!HostMemory::parseAddress((dash < 0 ? text : text.left(dash)).trimmed(), first)) {
+        return false;
+    }
+    last = first;
+    return (dash < 0 || HostMemory::parseAddress(text.mid(dash + 1).trimmed(), last)) && last >= first;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("Risc-V-Testing-runner");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Streams RISC-V assembly programs to a core over UART and checks its memory.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("programs", "Assembly files (.s) to run, in order.", "<program.s>...");
+
+    QCommandLineOption portOption({"p", "port"}, "Where a core is attached: a serial port name, serial:<name>, pty:<path>, "
+                                 "tcp:<host>:<port> or sim:. Repeat for a pool of boards.", "transport");
+    QCommandLineOption simulatorOption("simulators", "Add this many in-process simulated cores to the pool.", "count", "0");
+    QCommandLineOption baudOption({"b", "baud"}, "Baud rate (default 115200).", "rate", "115200");
+    QCommandLineOption expectOption({"e", "expect"},
+                                    "Expected memory for the program at the same position. "
+                                    "memory_map.csv layout or \"address value\" lines.", "file");
+    QCommandLineOption imageOption("expect-image",
+                                   "Whole memory image the program at the same position must leave behind: "
+                                   "a checkpoint file, memory_map.csv or \"address value\" lines. "
+                                   "Words not listed must be zero.", "file");
+    QCommandLineOption referenceOption("reference",
+                                       "Mirror every core in a reference model and require identical memory.");
+    QCommandLineOption preloadOption("preload",
+                                     "Load a data file into host memory before every program: raw .bin, "
+                                     "Intel HEX, $readmemh .hex, memory_map.csv or \"address value\" lines, "
+                                     "placed at the address (default 0). Repeatable.", "file[@address]");
+    QCommandLineOption mmioOption("mmio",
+                                  "Map a host device into the core's address space: console, timer, exit or fifo, "
+                                  "at its default address in 0xFFFF0000-0xFFFF3FFF or a page-aligned one. "
+                                  "Repeatable; \"all\" maps every device at its default.", "device[@address]");
+    QCommandLineOption resetOption("reset", "Reset the core before each program.");
+    QCommandLineOption runToEndOption("run-to-end", "Keep running the remaining programs after a failure.");
+    QCommandLineOption timeoutOption({"t", "timeout"}, "Time limit per program (default 10000).", "ms", "10000");
+    QCommandLineOption responseTimeoutOption("response-timeout",
+                                             "Longest wait for any reply from the core (default 1000).", "ms", "1000");
+    QCommandLineOption marginOption("deadline-margin",
+                                    "Slack added to each command's link-time deadline before the watchdog resets the core (default 100).",
+                                    "ms", "100");
+    QCommandLineOption attemptsOption("attempts", "Targets to try a program on after link failures (default 2).", "count", "2");
+    QCommandLineOption summaryOption({"o", "summary"}, "Write the JSON summary to a file instead of stdout.", "file");
+    QCommandLineOption junitOption("junit", "Also write a JUnit XML report.", "file");
+    QCommandLineOption traceOption("trace", "Record a timeline of the run and write it as Chrome trace JSON.", "file");
+    QCommandLineOption vcdOption("vcd",
+                                 "Write each target's link activity as a VCD waveform; with several targets "
+                                 "the target name is added before the extension.", "file");
+    QCommandLineOption captureOption("capture",
+                                     "Record each target's commands and replies as an indexed capture "
+                                     "(read it with Risc-V-Testing-capture); named like --vcd files.", "file");
+    QCommandLineOption faultsOption("faults",
+                                    "Pass every link through a fault injector: drop=, flip=, dup= (rates per byte), "
+                                    "burst=rate[:length], jitter=ms, dir=rx|tx|both, seed=. Each target adds its "
+                                    "position to the seed.", "spec");
+    QCommandLineOption sharedOption("shared-memory",
+                                    "Serve every target from one host memory, so programs running at the same time "
+                                    "on different cores see each other's stores.");
+    QCommandLineOption logRangeOption("log-accesses",
+                                      "With --shared-memory, record every load and store in this address range. "
+                                      "Repeatable.", "first[-last]");
+    QCommandLineOption accessLogOption("access-log",
+                                       "Write the recorded accesses as CSV, in the order memory saw them.", "file");
+    QCommandLineOption metricsOption("metrics-port",
+                                     "Serve Prometheus metrics on 127.0.0.1:<port>/metrics while running.", "port");
+    parser.addOptions({portOption, simulatorOption, baudOption, expectOption, imageOption, referenceOption,
+                       preloadOption, mmioOption, resetOption, runToEndOption, timeoutOption, responseTimeoutOption, marginOption,
+                       attemptsOption, summaryOption, junitOption, metricsOption, traceOption, vcdOption, captureOption,
+                       faultsOption, sharedOption, logRangeOption, accessLogOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList programFiles = parser.positionalArguments();
+    const QStringList expectFiles = parser.values(expectOption);
+    const QStringList imageFiles = parser.values(imageOption);
+    const QStringList portNames = parser.values(portOption);
+
+    bool simulatorsOk;
+    int simulators = parser.value(simulatorOption).toInt(&simulatorsOk);
+    int attempts = 0;
+    if (!simulatorsOk || simulators < 0 || !parsePositive(parser.value(attemptsOption), attempts)) {
+        err << "Attempts must be positive and simulators a count.\n";
+        return UsageError;
+    }
+    if ((portNames.isEmpty() && simulators == 0) || programFiles.isEmpty()) {
+        err << "A port or simulator and at least one program are required.\n\n" << parser.helpText();
+        return UsageError;
+    }
+    if (expectFiles.size() > programFiles.size() || imageFiles.size() > programFiles.size()) {
+        err << "More --expect or --expect-image files than programs.\n";
+        return UsageError;
+    }
+    const bool shareMemory = parser.isSet(sharedOption);
+    if (!shareMemory && (parser.isSet(logRangeOption) || parser.isSet(accessLogOption))) {
+        err << "--log-accesses and --access-log need --shared-memory.\n";
+        return UsageError;
+    }
+    if (shareMemory && parser.isSet(referenceOption)) {
+        err << "A reference model cannot follow a memory other cores also write: --reference and --shared-memory "
+               "do not mix.\n";
+        return UsageError;
+    }
+
+    ProgramRunner::Options options;
+    options.resetFirst = parser.isSet(resetOption);
+    options.compareWithReference = parser.isSet(referenceOption);
+    int baudRate = 0;
+    if (!parsePositive(parser.value(baudOption), baudRate) || !parsePositive(parser.value(timeoutOption), options.timeoutMs)
+        || !parsePositive(parser.value(responseTimeoutOption), options.responseTimeoutMs)) {
+        err << "Baud rate and timeouts must be positive integers.\n";
+        return UsageError;
+    }
+    bool marginOk;
+    const int deadlineMargin = parser.value(marginOption).toInt(&marginOk);
+    if (!marginOk || deadlineMargin < 0) {
+        err << "Deadline margin must be a non-negative integer.\n";
+        return UsageError;
+    }
+
+    // Data files are loaded once and shared copy-on-write by every program
+    HostMemory initialMemory;
+    for (const QString& spec : parser.values(preloadOption)) {
+        MemoryPreload preload;
+        QString errorMessage;
+        if (!MemoryPreload::parse(spec, preload, errorMessage) || !preload.load(initialMemory, errorMessage)) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+    }
+
+    // Laid out once here so an overlap is reported before anything runs
+    QVector<MemoryMap::Region> deviceRegions;
+    MemoryMap layout;
+    for (const QString& spec : parser.values(mmioOption)) {
+        QString errorMessage;
+        QVector<MemoryMap::Region> regions;
+        MemoryMap::Region region;
+        if (spec == "all") {
+            regions = MemoryMap::defaultLayout();
+        } else if (MemoryMap::parse(spec, region, errorMessage)) {
+            regions.append(region);
+        } else {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+        for (const MemoryMap::Region& added : regions) {
+            if (!layout.addRegion(added, errorMessage)) {
+                err << errorMessage << "\n";
+                return UsageError;
+            }
+            deviceRegions.append(added);
+        }
+    }
+
+    FaultyLink::Faults faults;
+    const bool injectFaults = parser.isSet(faultsOption);
+    if (injectFaults) {
+        QString errorMessage;
+        if (!FaultyLink::parse(parser.value(faultsOption), faults, errorMessage)) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+    }
+
+    // Assemble everything up front so a typo fails before the board is touched
+    QVector<TestProgram> programs;
+    for (int i = 0; i < programFiles.size(); i++) {
+        TestProgram program;
+        QString errorMessage;
+        if (!ProgramRunner::loadProgram(programFiles[i], program, errorMessage)
+            || (i < expectFiles.size()
+                && !ProgramRunner::loadExpectedMemory(expectFiles[i], program.expectedMemory, errorMessage))
+            || (i < imageFiles.size()
+                && !MemoryComparison::loadImage(imageFiles[i], program.expectedImage, errorMessage))) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+        program.hasExpectedImage = i < imageFiles.size();
+        program.initialMemory = initialMemory;
+        programs.append(program);
+    }
+
+    // The registry, shared memory and devices outlive the scheduler's sessions
+    SharedMemory sharedMemory;
+    if (shareMemory) {
+        sharedMemory.load(initialMemory);
+        for (const QString& range : parser.values(logRangeOption)) {
+            quint32 first;
+            quint32 last;
+            if (!parseRange(range, first, last)) {
+                err << QString("'%1': expected an address or first-last\n").arg(range);
+                return UsageError;
+            }
+            sharedMemory.logRange(first, last);
+        }
+    }
+    MetricsRegistry metrics;
+    MetricsServer metricsServer(&metrics);
+    if (parser.isSet(metricsOption)) {
+        int metricsPort = 0;
+        QString errorMessage;
+        if (!parsePositive(parser.value(metricsOption), metricsPort) || metricsPort > 65535) {
+            err << "Metrics port must be between 1 and 65535.\n";
+            return UsageError;
+        }
+        if (!metricsServer.listen(quint16(metricsPort), errorMessage)) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+    }
+
+    std::vector<std::unique_ptr<QIODevice>> devices;
+    RegressionScheduler scheduler;
+    scheduler.setMetrics(&metrics);
+    scheduler.setReferenceModels(options.compareWithReference);
+    scheduler.setDeviceRegions(deviceRegions);
+    if (shareMemory) {
+        scheduler.setSharedMemory(&sharedMemory);
+    }
+    scheduler.setRunnerOptions(options);
+    scheduler.setMaxAttempts(attempts);
+    scheduler.setStopOnFailure(!parser.isSet(runToEndOption));
+    scheduler.setLinkTiming(baudRate, deadlineMargin);
+
+    // With --faults each target talks through its own injector, seeded apart
+    auto attach = [&](const QString& name, std::unique_ptr<QIODevice> device) {
+        QIODevice *link = device.get();
+        devices.push_back(std::move(device));
+        if (injectFaults) {
+            std::unique_ptr<FaultyLink> faulty(new FaultyLink);
+            FaultyLink::Faults targetFaults = faults;
+            targetFaults.seed += quint64(scheduler.targetCount());
+            faulty->setDevice(link);
+            faulty->setFaults(targetFaults);
+            faulty->open(QIODevice::ReadWrite);
+            link = faulty.get();
+            devices.push_back(std::move(faulty));
+        }
+        scheduler.addTarget(name, link);
+    };
+
+    // A board that cannot be opened is reported and left out of the pool
+    int simulatedCores = 0;
+    for (const QString& portName : portNames) {
+        Transport transport;
+        QString errorMessage;
+        if (!Transport::parse(portName, transport, errorMessage)) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+        std::unique_ptr<QIODevice> device(transport.open(baudRate, nullptr, errorMessage));
+        if (!device) {
+            err << errorMessage << "\n";
+            continue;
+        }
+        const QString name = transport.kind == Transport::InProcess ? QString("sim%1").arg(simulatedCores++)
+                                                                    : transport.name();
+        attach(name, std::move(device));
+    }
+    for (int i = 0; i < simulators; i++) {
+        std::unique_ptr<SimulatedCore> core(new SimulatedCore);
+        core->open(QIODevice::ReadWrite);
+        attach(QString("sim%1").arg(simulatedCores++), std::move(core));
+    }
+    if (scheduler.targetCount() == 0) {
+        return UsageError;
+    }
+    if (parser.isSet(vcdOption)) {
+        QString errorMessage;
+        if (!scheduler.recordWaveforms(parser.value(vcdOption), errorMessage)) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+    }
+    if (parser.isSet(captureOption)) {
+        QString errorMessage;
+        if (!scheduler.recordCaptures(parser.value(captureOption), errorMessage)) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+    }
+
+    QObject::connect(&scheduler, &RegressionScheduler::programFinished,
+                     [&err](const ProgramResult& result, const QString& target, int attempt) {
+        if (result.passed) {
+            err << QString("PASS %1 on %2 (%3 instructions, %4 ms)\n")
+                       .arg(result.name, target).arg(result.completed).arg(result.elapsedMs);
+        } else {
+            err << QString("FAIL %1 on %2 (attempt %3): %4\n").arg(result.name, target).arg(attempt).arg(result.failure);
+        }
+        err.flush();
+    });
+
+    if (parser.isSet(traceOption)) {
+        Tracing::setThreadName("runner");
+        Tracing::setEnabled(true);
+    }
+
+    // Started from the event loop so that exit() is seen even if every target fails at once
+    SuiteResult suite;
+    QTimer::singleShot(0, [&]() {
+        scheduler.run(programs).then([&](const SuiteResult& result) {
+            suite = result;
+            app.exit(result.allPassed() ? Passed : Failed);
+        });
+    });
+    int status = app.exec();
+
+    QString errorMessage;
+    if (parser.isSet(traceOption)) {
+        Tracing::setEnabled(false);
+        if (!Tracing::writeChromeTrace(parser.value(traceOption), errorMessage)) {
+            err << errorMessage << "\n";
+            return UsageError;
+        }
+    }
+    if (parser.isSet(accessLogOption) && !sharedMemory.exportAccessLog(parser.value(accessLogOption), errorMessage)) {
+        err << errorMessage << "\n";
+        return UsageError;
+    }
+    if (parser.isSet(junitOption)
+        && !suite.writeJUnit(parser.value(junitOption), "Risc-V-Testing", errorMessage)) {
+        err << errorMessage << "\n";
+        return UsageError;
+    }
+
+    QByteArray json = QJsonDocument(suite.toJson()).toJson();
+    if (parser.isSet(summaryOption)) {
+        QFile summaryFile(parser.value(summaryOption));
+        if (!summaryFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << QString("Failed to write %1: %2\n").arg(summaryFile.fileName(), summaryFile.errorString());
+            return UsageError;
+        }
+        summaryFile.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return status;
+}
@@ -0,0 +1,172 @@
+#include "rv32icore.h"
+
+namespace {
+
+qint32 signExtend(quint32 value, int bits)
+{
+    const quint32 mask = 1u << (bits - 1);
+    return qint32((value ^ mask) - mask);
+}
+
+qint32 immediateI(quint32 instruction) { return qint32(instruction) >> 20; }
+
+qint32 immediateS(quint32 instruction)
+{
+    return (qint32(instruction & 0xFE000000) >> 20) | qint32((instruction >> 7) & 0x1F);
+}
+
+qint32 immediateB(quint32 instruction)
+{
+    quint32 value = ((instruction >> 31) & 1) << 12
+                    | ((instruction >> 7) & 1) << 11
+                    | ((instruction >> 25) & 0x3F) << 5
+                    | ((instruction >> 8) & 0xF) << 1;
+    return signExtend(value, 13);
+}
+
+qint32 immediateJ(quint32 instruction)
+{
+    quint32 value = ((instruction >> 31) & 1) << 20
+                    | ((instruction >> 12) & 0xFF) << 12
+                    | ((instruction >> 20) & 1) << 11
+                    | ((instruction >> 21) & 0x3FF) << 1;
+    return signExtend(value, 21);
+}
+
+}
+
+Rv32iCore::MemoryAccess Rv32iCore::execute(quint32 instruction)
+{
+    const quint32 opcode = instruction & 0x7F;
+    const int rd = (instruction >> 7) & 0x1F;
+    const quint32 funct3 = (instruction >> 12) & 0x7;
+    const int rs1 = (instruction >> 15) & 0x1F;
+    const int rs2 = (instruction >> 20) & 0x1F;
+    const bool alternate = (instruction >> 30) & 1;
+    const quint32 a = current.registers[rs1];
+    const quint32 b = current.registers[rs2];
+    const quint32 pc = current.pc;
+
+    MemoryAccess access;
+    current.lastPc = pc;
+    quint32 nextPc = pc + 4;
+    current.retired++;
+
+    switch (opcode) {
+    case 0x37: // lui
+        setRegister(rd, instruction & 0xFFFFF000);
+        break;
+    case 0x17: // auipc
+        setRegister(rd, pc + (instruction & 0xFFFFF000));
+        break;
+    case 0x6F: // jal
+        setRegister(rd, pc + 4);
+        nextPc = pc + immediateJ(instruction);
+        break;
+    case 0x67: // jalr
+        setRegister(rd, pc + 4);
+        nextPc = (a + immediateI(instruction)) & ~1u;
+        break;
+
+    case 0x63: { // branches
+        bool taken = false;
+        switch (funct3) {
+        case 0: taken = a == b; break;
+        case 1: taken = a != b; break;
+        case 4: taken = qint32(a) < qint32(b); break;
+        case 5: taken = qint32(a) >= qint32(b); break;
+        case 6: taken = a < b; break;
+        case 7: taken = a >= b; break;
+        }
+        if (taken) {
+            nextPc = pc + immediateB(instruction);
+        }
+        break;
+    }
+
+    case 0x03: // loads: rd is written by completeLoad()
+        access.kind = MemoryAccess::Load;
+        access.address = a + immediateI(instruction);
+        access.funct3 = funct3;
+        access.rd = rd;
+        break;
+
+    case 0x23: // stores
+        access.kind = MemoryAccess::Store;
+        access.address = a + immediateS(instruction);
+        access.funct3 = funct3;
+        access.value = funct3 == 0 ? (b & 0xFF) : funct3 == 1 ? (b & 0xFFFF) : b;
+        break;
+
+    case 0x13: { // register-immediate
+        const qint32 immediate = immediateI(instruction);
+        const int shamt = (instruction >> 20) & 0x1F;
+        switch (funct3) {
+        case 0: setRegister(rd, a + immediate); break;
+        case 1: setRegister(rd, a << shamt); break;
+        case 2: setRegister(rd, qint32(a) < immediate ? 1 : 0); break;
+        case 3: setRegister(rd, a < quint32(immediate) ? 1 : 0); break;
+        case 4: setRegister(rd, a ^ quint32(immediate)); break;
+        case 5: setRegister(rd, alternate ? quint32(qint32(a) >> shamt) : a >> shamt); break;
+        case 6: setRegister(rd, a | quint32(immediate)); break;
+        case 7: setRegister(rd, a & quint32(immediate)); break;
+        }
+        break;
+    }
+
+    case 0x33: { // register-register
+        const int shamt = b & 0x1F;
+        switch (funct3) {
+        case 0: setRegister(rd, alternate ? a - b : a + b); break;
+        case 1: setRegister(rd, a << shamt); break;
+        case 2: setRegister(rd, qint32(a) < qint32(b) ? 1 : 0); break;
+        case 3: setRegister(rd, a < b ? 1 : 0); break;
+        case 4: setRegister(rd, a ^ b); break;
+        case 5: setRegister(rd, alternate ? quint32(qint32(a) >> shamt) : a >> shamt); break;
+        case 6: setRegister(rd, a | b); break;
+        case 7: setRegister(rd, a & b); break;
+        }
+        break;
+    }
+
+    case 0x73: { // CSR accesses read the retired counter for cycle/instret, zero otherwise
+        const quint32 csr = instruction >> 20;
+        if (funct3 != 0) {
+            const bool counter = csr == 0xC00 || csr == 0xC02 || csr == 0xB00 || csr == 0xB02;
+            setRegister(rd, counter ? quint32(current.retired) : 0);
+        }
+        break;
+    }
+
+    default: // fence and anything unknown retire as a no-op
+        break;
+    }
+
+    current.pc = nextPc;
+    return access;
+}
+
+void Rv32iCore::setRegisterValue(int index, quint32 value)
+{
+    setRegister(index & 31, value);
+}
+
+void Rv32iCore::setState(const State& state)
+{
+    current = state;
+    current.registers[0] = 0;
+}
+
+void Rv32iCore::completeLoad(const MemoryAccess& access, quint32 word)
+{
+    const int shift = (access.address & 3) * 8;
+    quint32 value = word;
+    switch (access.funct3) {
+    case 0: value = quint32(signExtend((word >> shift) & 0xFF, 8)); break;
+    case 1: value = quint32(signExtend((word >> (shift & 16)) & 0xFFFF, 16)); break;
+    case 4: value = (word >> shift) & 0xFF; break;
+    case 5: value = (word >> (shift & 16)) & 0xFFFF; break;
+    default: break;
+    }
+    setRegister(access.rd, value);
+}
@@ -0,0 +1,60 @@
+#ifndef RV32ICORE_H
+#define RV32ICORE_H
+
+#include <QtGlobal>
+#include <array>
+
+// Architectural state and instruction semantics of the chip's RV32I subset,
+// with no I/O of its own: loads and stores are handed back to the caller,
+// which serves them from whatever memory it has.
+class Rv32iCore
+{
+public:
+    struct MemoryAccess {
+        enum Kind { None, Load, Store };
+        Kind kind = None;
+        quint32 address = 0;
+        quint32 value = 0;      // store data, masked to the access size
+        quint32 funct3 = 0;     // access size and signedness
+        int rd = 0;
+    };
+
+    struct State {
+        std::array<quint32, 32> registers{};
+        quint32 pc = 0;         // next instruction
+        quint32 lastPc = 0;     // last executed instruction, what a PC request returns
+        quint64 retired = 0;
+    };
+
+    Rv32iCore() { powerOn(); }
+
+    void powerOn() { current = State(); }
+
+    // The chip's reset clears the program counter but keeps the registers
+    void resetProgramCounter() { current.pc = 0; current.lastPc = 0; }
+
+    // A load must be finished with completeLoad() once its word is known
+    MemoryAccess execute(quint32 instruction);
+    void completeLoad(const MemoryAccess& access, quint32 word);
+
+    quint32 registerValue(int index) const { return current.registers[index & 31]; }
+    void setRegisterValue(int index, quint32 value);
+    quint32 programCounter() const { return current.pc; }
+    quint32 lastProgramCounter() const { return current.lastPc; }
+    quint64 instructionsRetired() const { return current.retired; }
+
+    const State& state() const { return current; }
+    void setState(const State& state);
+
+private:
+    void setRegister(int index, quint32 value)
+    {
+        if (index != 0) {
+            current.registers[index] = value;
+        }
+    }
+
+    State current;
+};
+
+#endif // RV32ICORE_H
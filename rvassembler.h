@@ -0,0 +1,431 @@
+#ifndef RVASSEMBLER_H
+#define RVASSEMBLER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+// Compile-time RV32I encoder for programs embedded in C++:
+//
+//   constexpr uint32_t word = rv::assemble("addi x5, x0, 56");
+//   constexpr auto program = rv::assemble({"lui x10, 0x1000", "sw x5, 0(x10)"});
+//   static_assert(program[0] == 0x00001537 && program[1] == 0x00552023);
+//
+// As in the converter, the lui and auipc operand is the full value (x10 =
+// 0x1000 above), not its upper 20 bits.
+// Accepts what RiscVMachineCodeConverter accepts, from the same instruction
+// table, and encodes it identically. Offsets are numbers, not labels. In a
+// constant expression a malformed line is a compile error naming the problem;
+// at run time it throws std::invalid_argument.
+//
+// No Qt, so it can be included anywhere; the encoders below are also what the
+// host uses for the short programs it builds itself.
+namespace rv {
+
+enum class Format : std::uint8_t { R, I, S, B, U, J };
+
+struct Instruction {
+    const char *name;
+    std::uint8_t opcode;
+    std::uint8_t funct3;
+    std::int8_t funct7;     // -1 when the encoding has no funct7 field
+    std::int16_t funct12;   // ecall/ebreak only, else -1
+    Format format;
+};
+
+inline constexpr Instruction instructions[] = {
+    {"lui",    0x37, 0, -1, -1, Format::U},
+    {"auipc",  0x17, 0, -1, -1, Format::U},
+    {"jal",    0x6f, 0, -1, -1, Format::J},
+    {"jalr",   0x67, 0, -1, -1, Format::I},
+    {"beq",    0x63, 0, -1, -1, Format::B},
+    {"bne",    0x63, 1, -1, -1, Format::B},
+    {"blt",    0x63, 4, -1, -1, Format::B},
+    {"bge",    0x63, 5, -1, -1, Format::B},
+    {"bltu",   0x63, 6, -1, -1, Format::B},
+    {"bgeu",   0x63, 7, -1, -1, Format::B},
+    {"lb",     0x03, 0, -1, -1, Format::I},
+    {"lh",     0x03, 1, -1, -1, Format::I},
+    {"lw",     0x03, 2, -1, -1, Format::I},
+    {"lbu",    0x03, 4, -1, -1, Format::I},
+    {"lhu",    0x03, 5, -1, -1, Format::I},
+    {"sb",     0x23, 0, -1, -1, Format::S},
+    {"sh",     0x23, 1, -1, -1, Format::S},
+    {"sw",     0x23, 2, -1, -1, Format::S},
+    {"addi",   0x13, 0, -1, -1, Format::I},
+    {"slti",   0x13, 2, -1, -1, Format::I},
+    {"sltiu",  0x13, 3, -1, -1, Format::I},
+    {"xori",   0x13, 4, -1, -1, Format::I},
+    {"ori",    0x13, 6, -1, -1, Format::I},
+    {"andi",   0x13, 7, -1, -1, Format::I},
+    {"slli",   0x13, 1, 0x00, -1, Format::I},
+    {"srli",   0x13, 5, 0x00, -1, Format::I},
+    {"srai",   0x13, 5, 0x20, -1, Format::I},
+    {"add",    0x33, 0, 0x00, -1, Format::R},
+    {"sub",    0x33, 0, 0x20, -1, Format::R},
+    {"sll",    0x33, 1, 0x00, -1, Format::R},
+    {"slt",    0x33, 2, 0x00, -1, Format::R},
+    {"sltu",   0x33, 3, 0x00, -1, Format::R},
+    {"xor",    0x33, 4, 0x00, -1, Format::R},
+    {"srl",    0x33, 5, 0x00, -1, Format::R},
+    {"sra",    0x33, 5, 0x20, -1, Format::R},
+    {"or",     0x33, 6, 0x00, -1, Format::R},
+    {"and",    0x33, 7, 0x00, -1, Format::R},
+    {"fence",  0x0f, 0, -1, -1, Format::I},
+    {"ecall",  0x73, 0, -1, 0x000, Format::I},
+    {"ebreak", 0x73, 0, -1, 0x001, Format::I},
+    {"csrrw",  0x73, 1, -1, -1, Format::I},
+    {"csrrs",  0x73, 2, -1, -1, Format::I},
+    {"csrrc",  0x73, 3, -1, -1, Format::I},
+    {"csrrwi", 0x73, 5, -1, -1, Format::I},
+    {"csrrsi", 0x73, 6, -1, -1, Format::I},
+    {"csrrci", 0x73, 7, -1, -1, Format::I},
+};
+
+// ABI names, indexed by register number
+inline constexpr const char *registerNames[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+    "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+    "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+};
+
+// Field packing; immediates are taken modulo their field width
+
+constexpr std::uint32_t encodeR(std::uint32_t opcode, std::uint32_t funct3, std::uint32_t funct7,
+                                int rd, int rs1, int rs2)
+{
+    return (funct7 << 25) | (std::uint32_t(rs2) << 20) | (std::uint32_t(rs1) << 15) | (funct3 << 12)
+           | (std::uint32_t(rd) << 7) | opcode;
+}
+
+constexpr std::uint32_t encodeI(std::uint32_t opcode, std::uint32_t funct3, int rd, int rs1, std::int32_t imm)
+{
+    return ((std::uint32_t(imm) & 0xFFF) << 20) | (std::uint32_t(rs1) << 15) | (funct3 << 12)
+           | (std::uint32_t(rd) << 7) | opcode;
+}
+
+constexpr std::uint32_t encodeS(std::uint32_t opcode, std::uint32_t funct3, int rs1, int rs2, std::int32_t imm)
+{
+    const std::uint32_t value = std::uint32_t(imm);
+    return (((value >> 5) & 0x7F) << 25) | (std::uint32_t(rs2) << 20) | (std::uint32_t(rs1) << 15)
+           | (funct3 << 12) | ((value & 0x1F) << 7) | opcode;
+}
+
+constexpr std::uint32_t encodeB(std::uint32_t opcode, std::uint32_t funct3, int rs1, int rs2, std::int32_t offset)
+{
+    const std::uint32_t value = std::uint32_t(offset);
+    return (((value >> 12) & 1) << 31) | (((value >> 5) & 0x3F) << 25) | (std::uint32_t(rs2) << 20)
+           | (std::uint32_t(rs1) << 15) | (funct3 << 12) | (((value >> 1) & 0xF) << 8)
+           | (((value >> 11) & 1) << 7) | opcode;
+}
+
+// value is the full 32-bit quantity; its upper 20 bits are kept
+constexpr std::uint32_t encodeU(std::uint32_t opcode, int rd, std::uint32_t value)
+{
+    return (value & 0xFFFFF000) | (std::uint32_t(rd) << 7) | opcode;
+}
+
+constexpr std::uint32_t encodeJ(std::uint32_t opcode, int rd, std::int32_t offset)
+{
+    const std::uint32_t value = std::uint32_t(offset);
+    return (((value >> 20) & 1) << 31) | (((value >> 1) & 0x3FF) << 21) | (((value >> 11) & 1) << 20)
+           | (((value >> 12) & 0xFF) << 12) | (std::uint32_t(rd) << 7) | opcode;
+}
+
+// The handful the host emits itself
+
+constexpr std::uint32_t lui(int rd, std::uint32_t upper) { return encodeU(0x37, rd, upper << 12); }
+constexpr std::uint32_t addi(int rd, int rs1, std::int32_t imm) { return encodeI(0x13, 0, rd, rs1, imm); }
+constexpr std::uint32_t sw(int rs2, std::int32_t offset, int rs1) { return encodeS(0x23, 2, rs1, rs2, offset); }
+constexpr std::uint32_t jal(int rd, std::int32_t offset) { return encodeJ(0x6f, rd, offset); }
+
+// %hi and %lo: value == (hi(value) << 12) + lo(value) with lo in the signed
+// 12-bit range, so hi rounds up whenever lo comes out negative
+constexpr std::uint32_t hi(std::uint32_t value) { return ((value + 0x800) >> 12) & 0xFFFFF; }
+constexpr std::int32_t lo(std::uint32_t value) { return std::int32_t(value - (hi(value) << 12)); }
+
+// Fewest words that set rd to value: addi, lui, or lui then addi. Returns
+// how many were written to out.
+constexpr int li(std::uint32_t (&out)[2], int rd, std::uint32_t value)
+{
+    if (hi(value) == 0) {
+        out[0] = addi(rd, 0, lo(value));
+        return 1;
+    }
+    out[0] = lui(rd, hi(value));
+    if (lo(value) == 0) {
+        return 1;
+    }
+    out[1] = addi(rd, rd, lo(value));
+    return 2;
+}
+
+namespace detail {
+
+constexpr bool isSeparator(char c) { return c == ' ' || c == '\t' || c == ',' || c == '\r' || c == '\n'; }
+constexpr char toLower(char c) { return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c; }
+
+constexpr bool sameName(std::string_view token, const char *name)
+{
+    std::size_t i = 0;
+    for (; i < token.size(); i++) {
+        if (name[i] == '\0' || toLower(token[i]) != name[i]) {
+            return false;
+        }
+    }
+    return name[i] == '\0';
+}
+
+// Splits on spaces and commas, like the runtime converter; '#' and "//" start a comment
+struct Tokens {
+    std::string_view text;
+    std::size_t position = 0;
+
+    constexpr std::string_view next()
+    {
+        while (position < text.size() && isSeparator(text[position])) {
+            position++;
+        }
+        const std::size_t start = position;
+        while (position < text.size() && !isSeparator(text[position])) {
+            position++;
+        }
+        return text.substr(start, position - start);
+    }
+};
+
+constexpr std::string_view stripComment(std::string_view line)
+{
+    for (std::size_t i = 0; i < line.size(); i++) {
+        if (line[i] == '#' || (line[i] == '/' && i + 1 < line.size() && line[i + 1] == '/')) {
+            return line.substr(0, i);
+        }
+    }
+    return line;
+}
+
+constexpr int parseRegister(std::string_view token)
+{
+    for (int i = 0; i < 32; i++) {
+        if (sameName(token, registerNames[i])) {
+            return i;
+        }
+    }
+    if (token.size() >= 2 && token.size() <= 3 && toLower(token[0]) == 'x') {
+        int number = 0;
+        for (std::size_t i = 1; i < token.size(); i++) {
+            if (token[i] < '0' || token[i] > '9') {
+                throw std::invalid_argument("rv::assemble: invalid register");
+            }
+            number = number * 10 + (token[i] - '0');
+        }
+        if (number < 32) {
+            return number;
+        }
+    }
+    throw std::invalid_argument("rv::assemble: invalid register");
+}
+
+// Decimal, 0x hex or 0b binary, optionally signed
+constexpr std::int64_t parseNumber(std::string_view token)
+{
+    bool negative = false;
+    if (!token.empty() && (token[0] == '-' || token[0] == '+')) {
+        negative = token[0] == '-';
+        token.remove_prefix(1);
+    }
+    int base = 10;
+    if (token.size() > 2 && token[0] == '0' && (toLower(token[1]) == 'x' || toLower(token[1]) == 'b')) {
+        base = toLower(token[1]) == 'x' ? 16 : 2;
+        token.remove_prefix(2);
+    }
+    if (token.empty()) {
+        throw std::invalid_argument("rv::assemble: missing immediate");
+    }
+    std::int64_t value = 0;
+    for (char c : token) {
+        const char lower = toLower(c);
+        const int digit = lower >= '0' && lower <= '9' ? lower - '0' : lower >= 'a' && lower <= 'f' ? lower - 'a' + 10 : 99;
+        if (digit >= base) {
+            throw std::invalid_argument("rv::assemble: invalid immediate");
+        }
+        value = value * base + digit;
+        if (value > 0xFFFFFFFFll) {
+            throw std::invalid_argument("rv::assemble: immediate out of range");
+        }
+    }
+    return negative ? -value : value;
+}
+
+constexpr std::int32_t checkedImmediate(std::int64_t value, std::int64_t low, std::int64_t high, bool even)
+{
+    if (value < low || value > high) {
+        throw std::invalid_argument("rv::assemble: immediate out of range");
+    }
+    if (even && (value & 1)) {
+        throw std::invalid_argument("rv::assemble: jump and branch offsets must be even");
+    }
+    return std::int32_t(std::uint32_t(std::uint64_t(value)));
+}
+
+// A 12-bit immediate may be written signed or as its unsigned bit pattern
+constexpr std::int32_t immediate12(std::string_view token) { return checkedImmediate(parseNumber(token), -2048, 4095, false); }
+
+// "offset(rs1)"
+struct BaseOffset {
+    std::int32_t offset = 0;
+    int rs1 = 0;
+};
+
+constexpr BaseOffset parseBaseOffset(std::string_view token)
+{
+    const std::size_t open = token.find('(');
+    if (open == std::string_view::npos || token.empty() || token.back() != ')') {
+        throw std::invalid_argument("rv::assemble: expected offset(rs1)");
+    }
+    BaseOffset result;
+    result.offset = immediate12(token.substr(0, open));
+    result.rs1 = parseRegister(token.substr(open + 1, token.size() - open - 2));
+    return result;
+}
+
+constexpr const Instruction& findInstruction(std::string_view mnemonic)
+{
+    for (const Instruction& instruction : instructions) {
+        if (sameName(mnemonic, instruction.name)) {
+            return instruction;
+        }
+    }
+    throw std::invalid_argument("rv::assemble: unknown instruction");
+}
+
+constexpr void expectEnd(Tokens& tokens)
+{
+    if (!tokens.next().empty()) {
+        throw std::invalid_argument("rv::assemble: too many operands");
+    }
+}
+
+constexpr std::string_view operand(Tokens& tokens)
+{
+    const std::string_view token = tokens.next();
+    if (token.empty()) {
+        throw std::invalid_argument("rv::assemble: missing operand");
+    }
+    return token;
+}
+
+}
+
+constexpr std::uint32_t assemble(std::string_view line)
+{
+    detail::Tokens tokens{detail::stripComment(line)};
+    const Instruction& instruction = detail::findInstruction(tokens.next());
+    const std::uint32_t opcode = instruction.opcode;
+    const std::uint32_t funct3 = instruction.funct3;
+    std::uint32_t word = 0;
+
+    switch (instruction.format) {
+    case Format::R: {
+        const int rd = detail::parseRegister(detail::operand(tokens));
+        const int rs1 = detail::parseRegister(detail::operand(tokens));
+        const int rs2 = detail::parseRegister(detail::operand(tokens));
+        word = encodeR(opcode, funct3, std::uint32_t(instruction.funct7), rd, rs1, rs2);
+        break;
+    }
+
+    case Format::I:
+        if (opcode == 0x0f) {
+            word = 0x0000000f;      // fence with no operands, as the runtime converter emits
+        } else if (instruction.funct12 >= 0) {
+            word = (std::uint32_t(instruction.funct12) << 20) | opcode;
+        } else if (opcode == 0x73) {
+            // csrxx rd, csr
+            const int rd = detail::parseRegister(detail::operand(tokens));
+            const std::int32_t csr = detail::checkedImmediate(detail::parseNumber(detail::operand(tokens)), 0, 4095, false);
+            word = encodeI(opcode, funct3, rd, 0, csr);
+        } else if (opcode == 0x03) {
+            const int rd = detail::parseRegister(detail::operand(tokens));
+            const detail::BaseOffset address = detail::parseBaseOffset(detail::operand(tokens));
+            word = encodeI(opcode, funct3, rd, address.rs1, address.offset);
+        } else {
+            const int rd = detail::parseRegister(detail::operand(tokens));
+            const int rs1 = detail::parseRegister(detail::operand(tokens));
+            const std::string_view immediate = detail::operand(tokens);
+            if (instruction.funct7 >= 0) {
+                const std::int32_t shamt = detail::checkedImmediate(detail::parseNumber(immediate), 0, 31, false);
+                word = encodeR(opcode, funct3, std::uint32_t(instruction.funct7), rd, rs1, shamt);
+            } else {
+                word = encodeI(opcode, funct3, rd, rs1, detail::immediate12(immediate));
+            }
+        }
+        break;
+
+    case Format::S: {
+        const int rs2 = detail::parseRegister(detail::operand(tokens));
+        const detail::BaseOffset address = detail::parseBaseOffset(detail::operand(tokens));
+        word = encodeS(opcode, funct3, address.rs1, rs2, address.offset);
+        break;
+    }
+
+    case Format::B: {
+        const int rs1 = detail::parseRegister(detail::operand(tokens));
+        const int rs2 = detail::parseRegister(detail::operand(tokens));
+        const std::int32_t offset = detail::checkedImmediate(detail::parseNumber(detail::operand(tokens)),
+                                                             -4096, 4094, true);
+        word = encodeB(opcode, funct3, rs1, rs2, offset);
+        break;
+    }
+
+    case Format::U: {
+        const int rd = detail::parseRegister(detail::operand(tokens));
+        const std::int32_t value = detail::checkedImmediate(detail::parseNumber(detail::operand(tokens)),
+                                                            -2147483648ll, 4294967295ll, false);
+        word = encodeU(opcode, rd, std::uint32_t(value));
+        break;
+    }
+
+    case Format::J: {
+        const int rd = detail::parseRegister(detail::operand(tokens));
+        const std::int32_t offset = detail::checkedImmediate(detail::parseNumber(detail::operand(tokens)),
+                                                             -(1 << 20), (1 << 20) - 2, true);
+        word = encodeJ(opcode, rd, offset);
+        break;
+    }
+    }
+
+    detail::expectEnd(tokens);
+    return word;
+}
+
+// One word per line: rv::assemble({"addi x5, x0, 1", "sw x5, 0(x0)"})
+template <std::size_t N>
+constexpr std::array<std::uint32_t, N> assemble(const char *const (&lines)[N])
+{
+    std::array<std::uint32_t, N> words{};
+    for (std::size_t i = 0; i < N; i++) {
+        words[i] = assemble(std::string_view(lines[i]));
+    }
+    return words;
+}
+
+// Pinned against RiscVMachineCodeConverter's output for the same lines
+static_assert(assemble("addi x5, x0, 56") == 0x03800293, "I-type");
+static_assert(assemble("add x5, x6, x7") == 0x007302b3, "R-type");
+static_assert(assemble("srai t0, s1, 3") == 0x4034d293, "shift");
+static_assert(assemble("lw x5, -4(x10)") == 0xffc52283, "load");
+static_assert(assemble("sw x5, 2044(x10)") == 0x7e552e23, "store");
+static_assert(assemble("bne x5, x6, -8") == 0xfe629ce3, "branch");
+static_assert(assemble("lui x10, 0x12345000") == 0x12345537, "U-type");
+static_assert(assemble("jal ra, 2048") == 0x001000ef, "J-type");
+static_assert(assemble("ebreak") == 0x00100073, "system");
+static_assert(jal(0, -8) == assemble("jal x0, -8") && sw(3, 8, 0) == assemble("sw x3, 8(x0)"), "encoders");
+static_assert(hi(0x12345FFF) == 0x12346 && lo(0x12345FFF) == -1, "%hi rounds up for a negative %lo");
+static_assert(hi(0xFFFFF800) == 0 && lo(0xFFFFF800) == -2048 && hi(0x7FFFF800) == 0x80000, "%hi wraps");
+
+}
+
+#endif // RVASSEMBLER_H
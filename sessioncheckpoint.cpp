@@ -0,0 +1,238 @@
+#include "sessioncheckpoint.h"
+#include "rvassembler.h"
+#include <QFile>
+#include <QtEndian>
+
+namespace {
+
+const quint32 CheckpointFileMagic = 0x50435652; // "RVCP"
+const quint32 CheckpointFileVersion = 1;
+
+bool fitsJal(qint64 offset)
+{
+    return offset >= -(1 << 20) && offset < (1 << 20) && (offset & 1) == 0;
+}
+
+void appendLoadImmediate(QVector<quint32>& program, int rd, quint32 value)
+{
+    quint32 words[2];
+    const int count = rv::li(words, rd, value);
+    for (int i = 0; i < count; i++) {
+        program.append(words[i]);
+    }
+}
+
+}
+
+SessionCheckpoint SessionCheckpoint::capture(const RiscVSession& session)
+{
+    SessionCheckpoint checkpoint;
+    checkpoint.memory = session.memory()->snapshot();
+
+    if (const ReferenceModel *reference = session.reference()) {
+        checkpoint.hasReferenceState = true;
+        checkpoint.referenceState = reference->processor().state();
+        checkpoint.referenceMemory = reference->memory().snapshot();
+        checkpoint.hasExpectedPc = true;
+        checkpoint.expectedPc = reference->processor().lastProgramCounter();
+        checkpoint.instructionsCompleted = reference->processor().instructionsRetired();
+    }
+    return checkpoint;
+}
+
+void SessionCheckpoint::writeMemory(QDataStream& stream, const HostMemory& memory)
+{
+    const QVector<quint32> pages = memory.touchedPages();
+    stream << quint32(pages.size());
+
+    QByteArray raw(HostMemory::PageSize, Qt::Uninitialized);
+    for (quint32 pageIndex : pages) {
+        const quint32 *words = memory.pageData(pageIndex);
+        for (int i = 0; i < HostMemory::PageWords; i++) {
+            qToLittleEndian(words[i], raw.data() + i * 4);
+        }
+        stream << pageIndex << qCompress(raw);
+    }
+}
+
+bool SessionCheckpoint::readMemory(QDataStream& stream, HostMemory& memory)
+{
+    memory.clear();
+
+    quint32 pageCount;
+    stream >> pageCount;
+
+    quint32 words[HostMemory::PageWords];
+    for (quint32 i = 0; i < pageCount && stream.status() == QDataStream::Ok; i++) {
+        quint32 pageIndex;
+        QByteArray compressed;
+        stream >> pageIndex >> compressed;
+
+        QByteArray raw = qUncompress(compressed);
+        if (raw.size() != int(HostMemory::PageSize) || pageIndex >= (1u << (32 - HostMemory::PageBits))) {
+            return false;
+        }
+        for (int w = 0; w < HostMemory::PageWords; w++) {
+            words[w] = qFromLittleEndian<quint32>(raw.constData() + w * 4);
+        }
+        memory.writePage(pageIndex, words);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool SessionCheckpoint::save(const QString& fileName, QString& errorMessage) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = QString("Could not create %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << CheckpointFileMagic << CheckpointFileVersion;
+    out << programName << programPosition << instructionsCompleted;
+    out << hasExpectedPc << expectedPc;
+    out << hasReferenceState;
+    if (hasReferenceState) {
+        for (quint32 value : referenceState.registers) {
+            out << value;
+        }
+        out << referenceState.pc << referenceState.lastPc << referenceState.retired;
+    }
+    writeMemory(out, memory);
+    if (hasReferenceState) {
+        writeMemory(out, referenceMemory);
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        errorMessage = QString("Failed to write checkpoint: %1").arg(file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool SessionCheckpoint::isCheckpointFile(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0;
+    in >> magic;
+    return in.status() == QDataStream::Ok && magic == CheckpointFileMagic;
+}
+
+bool SessionCheckpoint::load(const QString& fileName, QString& errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != CheckpointFileMagic || version != CheckpointFileVersion) {
+        errorMessage = "Not a checkpoint file or unsupported version";
+        return false;
+    }
+
+    in >> programName >> programPosition >> instructionsCompleted;
+    in >> hasExpectedPc >> expectedPc;
+    in >> hasReferenceState;
+    referenceState = Rv32iCore::State();
+    if (hasReferenceState) {
+        for (quint32& value : referenceState.registers) {
+            in >> value;
+        }
+        in >> referenceState.pc >> referenceState.lastPc >> referenceState.retired;
+    }
+
+    bool memoryOk = readMemory(in, memory);
+    if (memoryOk && hasReferenceState) {
+        memoryOk = readMemory(in, referenceMemory);
+    } else {
+        referenceMemory.clear();
+    }
+
+    if (!memoryOk || in.status() != QDataStream::Ok) {
+        errorMessage = "Checkpoint file is truncated or corrupt";
+        return false;
+    }
+    return true;
+}
+
+AsyncResult<SessionResult> SessionCheckpoint::restore(RiscVSession *session) const
+{
+    // Loads are served from host memory, so this alone restores what the board sees
+    *session->memory() = memory;
+
+    // After the reset the board's PC is 0 and advances by 4 per instruction
+    QVector<quint32> program;
+    if (hasReferenceState) {
+        for (int rd = 1; rd < 32; rd++) {
+            appendLoadImmediate(program, rd, referenceState.registers[rd]);
+        }
+    }
+
+    QString warning;
+    if (hasReferenceState || hasExpectedPc) {
+        const quint32 lastPc = hasReferenceState ? referenceState.lastPc : expectedPc;
+        const quint32 nextPc = hasReferenceState ? referenceState.pc : expectedPc + 4;
+
+        // Jump to the last executed address, then retire one jal there that
+        // lands on the next one, so both the PC request and execution match
+        const quint32 here = quint32(program.size() * 4);
+        const qint64 toLast = qint64(qint32(lastPc - here));
+        const qint64 toNext = qint64(qint32(nextPc - lastPc));
+        if ((lastPc == here || fitsJal(toLast)) && fitsJal(toNext)) {
+            if (lastPc != here) {
+                program.append(rv::jal(0, qint32(toLast)));
+            }
+            program.append(rv::jal(0, qint32(toNext)));
+        } else {
+            warning = QString("Program counter 0x%1 is out of jump range; it was not restored")
+                          .arg(lastPc, 8, 16, QChar('0'));
+        }
+    }
+
+    QVector<SessionFuture> steps;
+    steps.append(session->reset());
+    for (quint32 machineCode : program) {
+        steps.append(session->execute(machineCode));
+    }
+
+    AsyncPromise<SessionResult> promise;
+    const bool referenceState = hasReferenceState;
+    const Rv32iCore::State state = this->referenceState;
+    const HostMemory expectedReferenceMemory = referenceMemory;
+    whenAll(steps).then([promise, session, referenceState, state, expectedReferenceMemory, warning]
+                        (const QVector<SessionResult>& results) mutable {
+        SessionResult combined;
+        combined.ok = true;
+        for (const SessionResult& result : results) {
+            if (!result.ok) {
+                combined.ok = false;
+                combined.errorMessage = result.errorMessage;
+                break;
+            }
+        }
+        if (combined.ok) {
+            combined.errorMessage = warning;
+            if (ReferenceModel *reference = session->reference()) {
+                if (referenceState) {
+                    reference->processor().setState(state);
+                    reference->memory() = expectedReferenceMemory;
+                }
+            }
+        }
+        promise.finish(combined);
+    });
+    return promise.future();
+}
@@ -0,0 +1,50 @@
+#ifndef SESSIONCHECKPOINT_H
+#define SESSIONCHECKPOINT_H
+
+#include <QString>
+#include <QDataStream>
+#include "hostmemory.h"
+#include "rv32icore.h"
+#include "riscvsession.h"
+
+// Everything needed to pick a long run up again on a fresh board: the host
+// memory model, where the program was, the PC the board should report and
+// the reference model's state when one is attached.
+//
+// Capturing is cheap (the memories are copy-on-write snapshots), so a
+// checkpoint can be taken and written out while streaming continues.
+class SessionCheckpoint
+{
+public:
+    HostMemory memory;
+    QString programName;
+    qint64 programPosition = -1;        // index of the last instruction sent, -1 for none
+    quint64 instructionsCompleted = 0;
+
+    bool hasExpectedPc = false;
+    quint32 expectedPc = 0;             // what a PC request should return
+
+    bool hasReferenceState = false;
+    Rv32iCore::State referenceState;
+    HostMemory referenceMemory;
+
+    static SessionCheckpoint capture(const RiscVSession& session);
+
+    // Little-endian, versioned; only touched pages are stored, compressed
+    bool save(const QString& fileName, QString& errorMessage) const;
+    bool load(const QString& fileName, QString& errorMessage);
+    // Only looks at the file's magic number
+    static bool isCheckpointFile(const QString& fileName);
+
+    // Loads the host memory and queues the commands that bring the board's
+    // registers (from the reference state) and program counter back. The
+    // reference model, if any, is reset to the checkpointed state once the
+    // board has caught up.
+    AsyncResult<SessionResult> restore(RiscVSession *session) const;
+
+private:
+    static void writeMemory(QDataStream& stream, const HostMemory& memory);
+    static bool readMemory(QDataStream& stream, HostMemory& memory);
+};
+
+#endif // SESSIONCHECKPOINT_H
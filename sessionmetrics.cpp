@@ -0,0 +1,24 @@
+#include "sessionmetrics.h"
+
+SessionMetrics SessionMetrics::registerTarget(MetricsRegistry& registry, const QString& target)
+{
+    const QString labels = MetricsRegistry::label("target", target);
+
+    SessionMetrics metrics;
+    metrics.instructions = registry.counter("riscv_instructions_total", "Instructions completed by the core.", labels);
+    metrics.loads = registry.counter("riscv_loads_total", "Loads served from host memory.", labels);
+    metrics.stores = registry.counter("riscv_stores_total", "Stores received from the core.", labels);
+    metrics.bytesSent = registry.counter("riscv_uart_sent_bytes_total", "Bytes written to the link.", labels);
+    metrics.bytesReceived = registry.counter("riscv_uart_received_bytes_total", "Bytes read from the link.", labels);
+    metrics.protocolErrors = registry.counter("riscv_protocol_errors_total",
+                                              "Bytes that did not fit the expected reply frame.", labels);
+    metrics.failedOperations = registry.counter("riscv_failed_operations_total",
+                                                "Commands that could not be sent or were cancelled.", labels);
+    metrics.hangs = registry.counter("riscv_hangs_total", "Commands that missed their watchdog deadline.", labels);
+    metrics.recoveries = registry.counter("riscv_recoveries_total", "Hangs the watchdog recovered from.", labels);
+    metrics.serialErrors = registry.counter("riscv_serial_errors_total", "Errors reported by the serial port.", labels);
+    metrics.queueDepth = registry.gauge("riscv_queued_operations", "Commands queued or in flight.", labels);
+    metrics.commandLatency = registry.histogram("riscv_command_latency_seconds",
+                                                "Time from sending a command to CPU_READY.", labels);
+    return metrics;
+}
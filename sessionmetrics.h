@@ -0,0 +1,27 @@
+#ifndef SESSIONMETRICS_H
+#define SESSIONMETRICS_H
+
+#include <QString>
+#include "metricsregistry.h"
+
+// The counters a RiscVSession updates, all labelled with one target name
+// (port or simulator) so many boards can share a registry and a dashboard.
+// Pointers are owned by the registry and never null once registered.
+struct SessionMetrics {
+    MetricCounter *instructions = nullptr;
+    MetricCounter *loads = nullptr;
+    MetricCounter *stores = nullptr;
+    MetricCounter *bytesSent = nullptr;
+    MetricCounter *bytesReceived = nullptr;
+    MetricCounter *protocolErrors = nullptr;
+    MetricCounter *failedOperations = nullptr;
+    MetricCounter *hangs = nullptr;
+    MetricCounter *recoveries = nullptr;
+    MetricCounter *serialErrors = nullptr;      // bumped by whoever owns the port
+    MetricGauge *queueDepth = nullptr;
+    MetricHistogram *commandLatency = nullptr;  // command sent to CPU_READY
+
+    static SessionMetrics registerTarget(MetricsRegistry& registry, const QString& target);
+};
+
+#endif // SESSIONMETRICS_H
@@ -0,0 +1,226 @@
+#include "sharedmemory.h"
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <algorithm>
+#include <cstring>
+
+SharedMemory::SharedMemory()
+    : nextSequence(0)
+{
+    for (std::atomic<PageTable *>& table : directory) {
+        table.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+SharedMemory::~SharedMemory()
+{
+    for (std::atomic<PageTable *>& slot : directory) {
+        PageTable *table = slot.load(std::memory_order_relaxed);
+        if (!table) {
+            continue;
+        }
+        for (std::atomic<Page *>& page : table->pages) {
+            delete page.load(std::memory_order_relaxed);
+        }
+        delete table;
+    }
+}
+
+int SharedMemory::addClient(const QString& name)
+{
+    std::unique_ptr<Client> client(new Client);
+    client->name = name;
+    clients.push_back(std::move(client));
+    return int(clients.size()) - 1;
+}
+
+SharedMemory::Page *SharedMemory::touchPage(quint32 pageIndex)
+{
+    // Whoever loses the race to publish a table or page frees its own and uses the winner's
+    std::atomic<PageTable *>& tableSlot = directory[pageIndex >> HostMemory::TableBits];
+    PageTable *table = tableSlot.load(std::memory_order_acquire);
+    if (!table) {
+        PageTable *fresh = new PageTable();
+        if (tableSlot.compare_exchange_strong(table, fresh, std::memory_order_acq_rel)) {
+            table = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+
+    std::atomic<Page *>& pageSlot = table->pages[pageIndex & ((1 << HostMemory::TableBits) - 1)];
+    Page *page = pageSlot.load(std::memory_order_acquire);
+    if (!page) {
+        Page *fresh = new Page();
+        for (const std::pair<quint32, quint32>& range : loggedRanges) {
+            markLogged(fresh, pageIndex, range.first, range.second);
+        }
+        if (pageSlot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) {
+            page = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+    return page;
+}
+
+void SharedMemory::logRange(quint32 first, quint32 last)
+{
+    loggedRanges.emplace_back(first & ~3u, last);
+    for (quint32 tableIndex = 0; tableIndex < (1u << DirectoryBits); tableIndex++) {
+        PageTable *table = directory[tableIndex].load(std::memory_order_relaxed);
+        if (!table) {
+            continue;
+        }
+        for (quint32 slot = 0; slot < (1u << HostMemory::TableBits); slot++) {
+            if (Page *page = table->pages[slot].load(std::memory_order_relaxed)) {
+                markLogged(page, (tableIndex << HostMemory::TableBits) | slot, first & ~3u, last);
+            }
+        }
+    }
+}
+
+void SharedMemory::markLogged(Page *page, quint32 pageIndex, quint32 first, quint32 last)
+{
+    const quint32 pageStart = pageIndex << HostMemory::PageBits;
+    const quint32 pageLast = pageStart + (HostMemory::PageSize - 1);
+    if (last < pageStart || first > pageLast) {
+        return;
+    }
+
+    // Word indices within the page, inclusive; whole bitmap words are filled at once
+    const int from = int((qMax(first, pageStart) - pageStart) >> 2);
+    const int to = int((qMin(last, pageLast) - pageStart) >> 2);
+    const quint32 fromMask = ~0u << (from & 31);
+    const quint32 toMask = ~0u >> (31 - (to & 31));
+    if (from >> 5 == to >> 5) {
+        page->logged[from >> 5] |= fromMask & toMask;
+        return;
+    }
+    page->logged[from >> 5] |= fromMask;
+    std::memset(&page->logged[(from >> 5) + 1], 0xFF, sizeof(quint32) * size_t((to >> 5) - (from >> 5) - 1));
+    page->logged[to >> 5] |= toMask;
+}
+
+bool SharedMemory::isInLoggedRange(quint32 address) const
+{
+    address &= ~3u;
+    for (const std::pair<quint32, quint32>& range : loggedRanges) {
+        if (address >= range.first && address <= range.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SharedMemory::load(const HostMemory& image)
+{
+    for (std::atomic<PageTable *>& slot : directory) {
+        if (PageTable *table = slot.load(std::memory_order_relaxed)) {
+            for (std::atomic<Page *>& page : table->pages) {
+                if (Page *existing = page.load(std::memory_order_relaxed)) {
+                    for (std::atomic<quint32>& word : existing->words) {
+                        word.store(0, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+    }
+    for (quint32 pageIndex : image.touchedPages()) {
+        const quint32 *words = image.pageData(pageIndex);
+        Page *page = touchPage(pageIndex);
+        for (int i = 0; i < HostMemory::PageWords; i++) {
+            page->words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+}
+
+quint32 SharedMemory::loggedAccess(Page *page, int index, quint32 address, quint32 value, bool store, int client)
+{
+    Access access;
+    access.client = client;
+    access.address = address & ~3u;
+    access.store = store;
+    {
+        // Same stripe for the same word: its sequence numbers follow the order of its accesses
+        QMutexLocker locker(&stripes[(address >> 2) % LockStripes]);
+        if (store) {
+            page->words[index].store(value, std::memory_order_release);
+        } else {
+            value = page->words[index].load(std::memory_order_acquire);
+        }
+        access.sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+    }
+    access.value = value;
+
+    Client *owner = clients[size_t(client)].get();
+    QMutexLocker locker(&owner->mutex);
+    owner->log.append(access);
+    return value;
+}
+
+HostMemory SharedMemory::snapshot() const
+{
+    HostMemory image;
+    quint32 words[HostMemory::PageWords];
+    for (quint32 tableIndex = 0; tableIndex < (1u << DirectoryBits); tableIndex++) {
+        const PageTable *table = directory[tableIndex].load(std::memory_order_acquire);
+        if (!table) {
+            continue;
+        }
+        for (quint32 slot = 0; slot < (1u << HostMemory::TableBits); slot++) {
+            const Page *page = table->pages[slot].load(std::memory_order_acquire);
+            if (!page) {
+                continue;
+            }
+            bool nonZero = false;
+            for (int i = 0; i < HostMemory::PageWords; i++) {
+                words[i] = page->words[i].load(std::memory_order_acquire);
+                nonZero = nonZero || words[i] != 0;
+            }
+            // Pages that only exist for logging stay untouched in the copy
+            if (nonZero) {
+                image.writePage((tableIndex << HostMemory::TableBits) | slot, words);
+            }
+        }
+    }
+    return image;
+}
+
+QVector<SharedMemory::Access> SharedMemory::accessLog(int client) const
+{
+    const Client *owner = clients[size_t(client)].get();
+    QMutexLocker locker(&owner->mutex);
+    return owner->log;
+}
+
+QVector<SharedMemory::Access> SharedMemory::accessLog() const
+{
+    QVector<Access> merged;
+    for (int client = 0; client < clientCount(); client++) {
+        merged += accessLog(client);
+    }
+    std::sort(merged.begin(), merged.end(), [](const Access& a, const Access& b) {
+        return a.sequence < b.sequence;
+    });
+    return merged;
+}
+
+bool SharedMemory::exportAccessLog(const QString& fileName, QString& errorMessage) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        errorMessage = QString("Failed to create access log: %1").arg(file.errorString());
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "sequence,client,kind,address,value\n";
+    for (const Access& access : accessLog()) {
+        out << access.sequence << "," << clientName(access.client) << "," << (access.store ? "store" : "load")
+            << QString(",0x%1,0x%2\n").arg(access.address, 8, 16, QChar('0')).arg(access.value, 8, 16, QChar('0'));
+    }
+    out.flush();
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "hostmemory.h"
+
+// Host memory that several sessions serve their cores' loads and stores
+// from, so programs on different boards can talk through memory. Words are
+// atomics in pages that are allocated on first write and published with a
+// compare-and-swap: loads and stores from sessions on any thread take no
+// lock, and a load returns the whole of the last word stored.
+//
+// Each session is a client with its own access log, kept in the order that
+// session served its accesses. Nothing is logged unless address ranges are
+// marked for it; accesses there are stamped with a global sequence number,
+// under a lock striped by address, so merged logs show the order every
+// logged word actually saw.
+class SharedMemory
+{
+public:
+    struct Access {
+        quint64 sequence = 0;   // order across all clients
+        int client = 0;
+        quint32 address = 0;
+        quint32 value = 0;
+        bool store = false;
+    };
+
+    SharedMemory();
+    ~SharedMemory();
+
+    // Setup, before any session serves from the memory
+    int addClient(const QString& name);
+    QString clientName(int client) const { return clients[size_t(client)]->name; }
+    int clientCount() const { return int(clients.size()); }
+    // Marks whole pages' bitmaps at once; pages are not allocated for it,
+    // ones created later pick the ranges up
+    void logRange(quint32 first, quint32 last);
+    // Replaces the contents; logged ranges stay marked
+    void load(const HostMemory& image);
+
+    // Addresses are byte addresses; the low two bits are ignored
+    quint32 readWord(quint32 address, int client)
+    {
+        Page *page = findPage(address >> HostMemory::PageBits);
+        if (!page) {
+            // A logged word is logged even before anything is stored to its page
+            if (loggedRanges.empty() || !isInLoggedRange(address)) {
+                return 0;
+            }
+            page = touchPage(address >> HostMemory::PageBits);
+        }
+        const int index = (address >> 2) & (HostMemory::PageWords - 1);
+        if (page->isLogged(index)) {
+            return loggedAccess(page, index, address, 0, false, client);
+        }
+        return page->words[index].load(std::memory_order_acquire);
+    }
+
+    void writeWord(quint32 address, quint32 value, int client)
+    {
+        Page *page = touchPage(address >> HostMemory::PageBits);
+        const int index = (address >> 2) & (HostMemory::PageWords - 1);
+        if (page->isLogged(index)) {
+            loggedAccess(page, index, address, value, true, client);
+            return;
+        }
+        page->words[index].store(value, std::memory_order_release);
+    }
+
+    // Copy of the current contents, for comparisons and export
+    HostMemory snapshot() const;
+
+    QVector<Access> accessLog(int client) const;
+    QVector<Access> accessLog() const;      // every client's, by sequence number
+
+    // "sequence,client,kind,address,value" rows, by sequence number
+    bool exportAccessLog(const QString& fileName, QString& errorMessage) const;
+
+private:
+    static const int DirectoryBits = 32 - HostMemory::PageBits - HostMemory::TableBits;
+    static const int LockStripes = 64;
+
+    struct Page {
+        std::atomic<quint32> words[HostMemory::PageWords];
+        quint32 logged[HostMemory::PageWords / 32];     // bit per word; only changed during setup
+
+        bool isLogged(int index) const { return logged[index >> 5] & (1u << (index & 31)); }
+    };
+    struct PageTable {
+        std::atomic<Page *> pages[1 << HostMemory::TableBits];
+    };
+    struct Client {
+        QString name;
+        mutable QMutex mutex;   // only contended while the log is read
+        QVector<Access> log;
+    };
+
+    Page *findPage(quint32 pageIndex) const
+    {
+        const PageTable *table = directory[pageIndex >> HostMemory::TableBits].load(std::memory_order_acquire);
+        return table ? table->pages[pageIndex & ((1 << HostMemory::TableBits) - 1)].load(std::memory_order_acquire)
+                     : nullptr;
+    }
+    Page *touchPage(quint32 pageIndex);
+    static void markLogged(Page *page, quint32 pageIndex, quint32 first, quint32 last);
+    bool isInLoggedRange(quint32 address) const;
+    quint32 loggedAccess(Page *page, int index, quint32 address, quint32 value, bool store, int client);
+
+    std::atomic<PageTable *> directory[1 << DirectoryBits];
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<std::pair<quint32, quint32>> loggedRanges;  // first and last byte; only changed during setup
+    std::atomic<quint64> nextSequence;
+    QMutex stripes[LockStripes];
+};
+
+#endif // SHAREDMEMORY_H
@@ -0,0 +1,148 @@
+#include "simulatedcore.h"
+#include "uartprotocol.h"
+#include "tracing.h"
+#include <QTimer>
+#include <cstring>
+
+SimulatedCore::SimulatedCore(QObject *parent)
+    : QIODevice(parent)
+    , outputPosition(0)
+    , notifyQueued(false)
+    , responseDelay(0)
+{
+    powerOn();
+}
+
+void SimulatedCore::powerOn()
+{
+    core.powerOn();
+    state = CpuReady;
+    pendingBytes = 0;
+    pendingLoad = Rv32iCore::MemoryAccess();
+    output.clear();
+    outputPosition = 0;
+}
+
+void SimulatedCore::close()
+{
+    output.clear();
+    outputPosition = 0;
+    state = CpuReady;
+    pendingBytes = 0;
+    QIODevice::close();
+}
+
+qint64 SimulatedCore::bytesAvailable() const
+{
+    return output.size() - outputPosition + QIODevice::bytesAvailable();
+}
+
+qint64 SimulatedCore::readData(char *data, qint64 maxSize)
+{
+    qint64 count = qMin(maxSize, qint64(output.size() - outputPosition));
+    std::memcpy(data, output.constData() + outputPosition, size_t(count));
+    outputPosition += int(count);
+    if (outputPosition == output.size()) {
+        output.clear();
+        outputPosition = 0;
+    }
+    return count;
+}
+
+qint64 SimulatedCore::writeData(const char *data, qint64 maxSize)
+{
+    TRACE_ZONE("simulator.write");
+    for (qint64 i = 0; i < maxSize; i++) {
+        receive(quint8(data[i]));
+    }
+    emit bytesWritten(maxSize);
+    return maxSize;
+}
+
+void SimulatedCore::receive(quint8 byte)
+{
+    switch (state) {
+    case CpuReady:
+        if (byte == quint8(UartProtocol::ResetCommand)) {
+            // Registers keep their values across a reset (docs/doc.md)
+            core.resetProgramCounter();
+            sendByte(UartProtocol::CpuReady);
+        } else if (byte == quint8(UartProtocol::ProgramCounterCommand)) {
+            sendWord(core.lastProgramCounter());
+            sendByte(UartProtocol::CpuReady);
+        } else {
+            state = AwaitInstruction;
+            pendingBytes = 0;
+        }
+        break;
+
+    case AwaitInstruction:
+    case AwaitLoadData:
+        pending[pendingBytes++] = char(byte);
+        if (pendingBytes == UartProtocol::WordSize) {
+            pendingBytes = 0;
+            quint32 word = UartProtocol::readWord(pending);
+            if (state == AwaitInstruction) {
+                state = CpuReady;
+                execute(word);
+            } else {
+                state = CpuReady;
+                core.completeLoad(pendingLoad, word);
+                sendByte(UartProtocol::CpuReady);
+            }
+        }
+        break;
+    }
+}
+
+void SimulatedCore::execute(quint32 instruction)
+{
+    Rv32iCore::MemoryAccess access = core.execute(instruction);
+    switch (access.kind) {
+    case Rv32iCore::MemoryAccess::Load:
+        // Ask the host for the word; the ready byte follows once it arrives
+        pendingLoad = access;
+        sendWord(access.address);
+        sendByte(quint8(access.funct3));
+        state = AwaitLoadData;
+        return;
+    case Rv32iCore::MemoryAccess::Store:
+        sendWord(access.address);
+        sendByte(UartProtocol::WriteFlag);
+        sendWord(access.value);
+        break;
+    case Rv32iCore::MemoryAccess::None:
+        break;
+    }
+    sendByte(UartProtocol::CpuReady);
+}
+
+void SimulatedCore::sendByte(quint8 byte)
+{
+    output.append(char(byte));
+    notifyReadyRead();
+}
+
+void SimulatedCore::sendWord(quint32 value)
+{
+    char bytes[UartProtocol::WordSize];
+    UartProtocol::writeWord(bytes, value);
+    output.append(bytes, sizeof(bytes));
+    notifyReadyRead();
+}
+
+void SimulatedCore::notifyReadyRead()
+{
+    if (notifyQueued) {
+        return;
+    }
+    notifyQueued = true;
+
+    // Never re-enter the reader from inside its own write
+    QTimer::singleShot(responseDelay, this, [this]() {
+        notifyQueued = false;
+        if (isOpen() && bytesAvailable() > 0) {
+            emit readyRead();
+        }
+    });
+}
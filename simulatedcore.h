@@ -0,0 +1,61 @@
+#ifndef SIMULATEDCORE_H
+#define SIMULATEDCORE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include "rv32icore.h"
+
+// In-process stand-in for a board: an RV32I interpreter behind the same
+// UART controller protocol the hardware speaks (docs/doc.md), exposed as a
+// QIODevice so a RiscVSession can drive it exactly like a serial port.
+// Replies become readable from the event loop, as they would from a port.
+//
+// Like the hardware, reset only clears the program counter, not the
+// registers. Loads and stores go to the host through the protocol; the
+// simulator has no memory of its own.
+class SimulatedCore : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit SimulatedCore(QObject *parent = nullptr);
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    void close() override;
+
+    // Extra delay before each reply becomes readable, to model slow targets
+    void setResponseDelay(int milliseconds) { responseDelay = milliseconds; }
+
+    Rv32iCore& processor() { return core; }
+    const Rv32iCore& processor() const { return core; }
+
+    // Power-on state: registers and program counter cleared, controller in CPU_READY
+    void powerOn();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    enum State { CpuReady, AwaitInstruction, AwaitLoadData };
+
+    void receive(quint8 byte);
+    void execute(quint32 instruction);
+    void sendByte(quint8 byte);
+    void sendWord(quint32 value);
+    void notifyReadyRead();
+
+    Rv32iCore core;
+    State state;
+    char pending[4];
+    int pendingBytes;
+    Rv32iCore::MemoryAccess pendingLoad;
+
+    QByteArray output;
+    int outputPosition;
+    bool notifyQueued;
+    int responseDelay;
+};
+
+#endif // SIMULATEDCORE_H
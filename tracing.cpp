@@ -0,0 +1,255 @@
+#include "tracing.h"
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QMap>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace Tracing {
+
+std::atomic<bool> active{false};
+
+namespace {
+
+const int RingCapacity = 1 << 16;   // events kept per thread
+
+// Single producer (the owning thread), read by the exporter without
+// stopping it. Each slot is written with relaxed stores and published by
+// the release store of head; the exporter re-reads head after copying and
+// drops slots the producer may have overwritten meanwhile.
+struct Ring {
+    struct Slot {
+        std::atomic<const char *> name{nullptr};
+        std::atomic<quint64> start{0};
+        std::atomic<quint64> end{0};
+    };
+
+    int threadId = 0;
+    QString threadName;                 // guarded by the registry mutex
+    std::atomic<quint64> head{0};       // events ever written
+    std::atomic<quint64> floor{0};      // events before this were cleared
+    std::unique_ptr<Slot[]> buffer{new Slot[RingCapacity]};
+};
+
+struct Registry {
+    QMutex mutex;
+    std::vector<std::unique_ptr<Ring>> rings;   // never shrinks, threads may exit
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+Ring *threadRing()
+{
+    thread_local Ring *ring = nullptr;
+    if (!ring) {
+        Registry& shared = registry();
+        QMutexLocker locker(&shared.mutex);
+        shared.rings.emplace_back(new Ring);
+        ring = shared.rings.back().get();
+        ring->threadId = int(shared.rings.size());
+    }
+    return ring;
+}
+
+struct Event {
+    const char *name;
+    quint64 start;
+    quint64 end;
+};
+
+// Copies what the ring still holds, without the slots the producer may have
+// overwritten meanwhile. Called with the registry mutex held.
+void copyEvents(const Ring& ring, std::vector<Event>& events)
+{
+    const quint64 head = ring.head.load(std::memory_order_acquire);
+    const quint64 floor = ring.floor.load(std::memory_order_relaxed);
+    quint64 from = head > RingCapacity ? head - RingCapacity : 0;
+    from = qMax(from, floor);
+
+    events.clear();
+    for (quint64 i = from; i < head; i++) {
+        const Ring::Slot& slot = ring.buffer[i & (RingCapacity - 1)];
+        events.push_back({slot.name.load(std::memory_order_relaxed),
+                          slot.start.load(std::memory_order_relaxed),
+                          slot.end.load(std::memory_order_relaxed)});
+    }
+
+    // Slots below this may have been reused while they were copied. The fence
+    // keeps the copies above from moving past the re-read, and the slot the
+    // producer may be filling right now, event after - RingCapacity, goes too.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const quint64 after = ring.head.load(std::memory_order_relaxed);
+    const quint64 valid = after >= RingCapacity ? after - RingCapacity + 1 : 0;
+    const size_t skip = size_t(qMin(quint64(events.size()), valid > from ? valid - from : 0));
+    events.erase(events.begin(), events.begin() + skip);
+    events.erase(std::remove_if(events.begin(), events.end(),
+                                [](const Event& event) { return !event.name || event.end < event.start; }),
+                 events.end());
+}
+
+QByteArray jsonString(const QByteArray& utf8)
+{
+    QByteArray out = "\"";
+    for (char c : utf8) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (uchar(c) < 0x20) {
+            out += "\\u00" + QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
+}
+
+QByteArray microseconds(quint64 nanoseconds)
+{
+    return QByteArray::number(nanoseconds / 1000) + '.'
+           + QByteArray::number(nanoseconds % 1000).rightJustified(3, '0');
+}
+
+}
+
+void setEnabled(bool enabled)
+{
+    active.store(enabled, std::memory_order_relaxed);
+}
+
+quint64 now()
+{
+    // +1 so a zone that starts at the epoch is not mistaken for a disabled one
+    return quint64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - epoch).count()) + 1;
+}
+
+void record(const char *name, quint64 startNs, quint64 endNs)
+{
+    Ring *ring = threadRing();
+    const quint64 index = ring->head.load(std::memory_order_relaxed);
+    Ring::Slot& slot = ring->buffer[index & (RingCapacity - 1)];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(startNs, std::memory_order_relaxed);
+    slot.end.store(endNs, std::memory_order_relaxed);
+    ring->head.store(index + 1, std::memory_order_release);
+}
+
+void clear()
+{
+    Registry& shared = registry();
+    QMutexLocker locker(&shared.mutex);
+    for (const std::unique_ptr<Ring>& ring : shared.rings) {
+        ring->floor.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+void setThreadName(const QString& name)
+{
+    Ring *ring = threadRing();
+    QMutexLocker locker(&registry().mutex);
+    ring->threadName = name;
+}
+
+bool writeChromeTrace(const QString& fileName, QString& errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = QString("Could not create %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    Registry& shared = registry();
+    QMutexLocker locker(&shared.mutex);
+
+    std::vector<Event> events;
+    bool first = true;
+
+    file.write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (const std::unique_ptr<Ring>& ring : shared.rings) {
+        copyEvents(*ring, events);
+
+        const QByteArray tid = QByteArray::number(ring->threadId);
+        QByteArray line;
+        const QString threadName = ring->threadName.isEmpty()
+                                       ? QString("thread %1").arg(ring->threadId) : ring->threadName;
+        line = "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+               + ",\"args\":{\"name\":" + jsonString(threadName.toUtf8()) + "}}";
+        file.write(first ? line : ",\n" + line);
+        first = false;
+
+        for (const Event& event : events) {
+            line = ",\n{\"name\":" + jsonString(QByteArray(event.name))
+                   + ",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid
+                   + ",\"ts\":" + microseconds(event.start)
+                   + ",\"dur\":" + microseconds(event.end - event.start) + "}";
+            file.write(line);
+        }
+    }
+    file.write("\n]}\n");
+
+    if (file.error() != QFileDevice::NoError) {
+        errorMessage = QString("Failed to write %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+QVector<ZoneTotal> totals()
+{
+    Registry& shared = registry();
+    QMutexLocker locker(&shared.mutex);
+
+    QMap<QByteArray, ZoneTotal> byName;
+    std::vector<Event> events;
+    std::vector<std::pair<const Event *, quint64>> open;    // enclosing zones, with their children's time
+    for (const std::unique_ptr<Ring>& ring : shared.rings) {
+        copyEvents(*ring, events);
+
+        // Outer zones first, so each event's parent is on the stack when it is seen
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.start != b.start ? a.start < b.start : a.end > b.end;
+        });
+
+        open.clear();
+        auto close = [&byName](const std::pair<const Event *, quint64>& zone) {
+            const quint64 duration = zone.first->end - zone.first->start;
+            ZoneTotal& total = byName[QByteArray(zone.first->name)];
+            total.count++;
+            total.totalNs += duration;
+            total.selfNs += duration - qMin(duration, zone.second);
+        };
+        for (const Event& event : events) {
+            while (!open.empty() && open.back().first->end <= event.start) {
+                close(open.back());
+                open.pop_back();
+            }
+            if (!open.empty()) {
+                open.back().second += event.end - event.start;
+            }
+            open.push_back({&event, 0});
+        }
+        while (!open.empty()) {
+            close(open.back());
+            open.pop_back();
+        }
+    }
+
+    QVector<ZoneTotal> result;
+    for (auto it = byName.begin(); it != byName.end(); ++it) {
+        it->name = QString::fromUtf8(it.key());
+        result.append(*it);
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,77 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+
+// Timeline tracing of the host's own hot paths. A TRACE_ZONE records its
+// scope's start and duration into a ring buffer owned by the calling
+// thread, so recording never takes a lock; only the newest events of each
+// thread are kept. When tracing is off a zone costs one relaxed load.
+//
+// writeChromeTrace() dumps everything recorded so far as Chrome trace JSON,
+// which chrome://tracing and ui.perfetto.dev both open.
+namespace Tracing {
+
+extern std::atomic<bool> active;
+
+inline bool isEnabled() { return active.load(std::memory_order_relaxed); }
+void setEnabled(bool enabled);
+
+// Drops everything recorded so far, on every thread
+void clear();
+
+// Nanoseconds on a monotonic clock
+quint64 now();
+
+// Zone names must be string literals (or otherwise live forever)
+void record(const char *name, quint64 startNs, quint64 endNs);
+
+// Names the calling thread in the exported trace
+void setThreadName(const QString& name);
+
+bool writeChromeTrace(const QString& fileName, QString& errorMessage);
+
+struct ZoneTotal {
+    QString name;
+    quint64 count = 0;
+    quint64 totalNs = 0;        // inclusive
+    quint64 selfNs = 0;         // minus zones nested inside it on the same thread
+};
+
+// Per zone name over what the rings still hold, sorted by name; keep runs
+// short enough (or clear() often enough) that nothing was overwritten
+QVector<ZoneTotal> totals();
+
+class Zone
+{
+public:
+    explicit Zone(const char *zoneName)
+        : name(zoneName)
+        , start(isEnabled() ? now() : 0)
+    {
+    }
+    ~Zone()
+    {
+        if (start) {
+            record(name, start, now());
+        }
+    }
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char *name;
+    quint64 start;
+};
+
+}
+
+#define TRACE_ZONE_CONCAT2(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT2(a, b)
+#define TRACE_ZONE(name) Tracing::Zone TRACE_ZONE_CONCAT(traceZone, __LINE__)(name)
+
+#endif // TRACING_H
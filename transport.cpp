@@ -0,0 +1,149 @@
+#include "transport.h"
+#include "simulatedcore.h"
+#include <QSerialPort>
+#include <QSerialPortInfo>
+#include <QTcpSocket>
+
+bool Transport::parse(const QString& text, Transport& transport, QString& errorMessage)
+{
+    const QString trimmed = text.trimmed();
+    const int colon = trimmed.indexOf(':');
+    const QString scheme = colon < 0 ? QString() : trimmed.left(colon).toLower();
+    const QString rest = colon < 0 ? trimmed : trimmed.mid(colon + 1);
+
+    transport = Transport();
+    if (trimmed == "sim" || scheme == "sim") {
+        transport.kind = InProcess;
+        transport.description = "In-process simulated core";
+        return true;
+    }
+
+    if (scheme == "tcp") {
+        transport.kind = Tcp;
+        QString host = rest;
+        quint16 port = DefaultTcpPort;
+        const int portColon = rest.lastIndexOf(':');
+        if (portColon >= 0) {
+            bool ok;
+            const int value = rest.mid(portColon + 1).toInt(&ok);
+            if (!ok || value <= 0 || value > 65535) {
+                errorMessage = QString("'%1': the TCP port must be between 1 and 65535").arg(text);
+                return false;
+            }
+            port = quint16(value);
+            host = rest.left(portColon);
+        }
+        if (host.isEmpty()) {
+            host = "127.0.0.1";
+        }
+        transport.address = QString("%1:%2").arg(host).arg(port);
+        transport.description = "Simulation over TCP";
+        return true;
+    }
+
+    if (scheme == "pty" || scheme == "serial") {
+        transport.kind = scheme == "pty" ? Pty : Serial;
+        transport.address = rest;
+    } else {
+        // A bare port name; Windows names such as COM3 have no colon either
+        transport.kind = Serial;
+        transport.address = trimmed;
+    }
+    if (transport.address.isEmpty()) {
+        errorMessage = QString("'%1': no port or path given").arg(text);
+        return false;
+    }
+    transport.description = transport.kind == Pty ? "Pseudo-terminal" : QString();
+    return true;
+}
+
+QString Transport::toString() const
+{
+    switch (kind) {
+    case Serial:    return "serial:" + address;
+    case Pty:       return "pty:" + address;
+    case Tcp:       return "tcp:" + address;
+    case InProcess: return "sim:";
+    }
+    return QString();
+}
+
+QString Transport::name() const
+{
+    return kind == InProcess ? QString("sim") : address;
+}
+
+QList<Transport> Transport::serialPorts()
+{
+    QList<Transport> transports;
+    for (const QSerialPortInfo& port : QSerialPortInfo::availablePorts()) {
+        Transport serial;
+        serial.kind = Serial;
+        serial.address = port.portName();
+        serial.description = port.description();
+        transports.append(serial);
+    }
+    return transports;
+}
+
+QList<Transport> Transport::builtIn()
+{
+    QList<Transport> transports;
+    Transport simulated;
+    simulated.kind = InProcess;
+    simulated.description = "In-process simulated core";
+    transports.append(simulated);
+
+    Transport tcp;
+    tcp.kind = Tcp;
+    tcp.address = QString("127.0.0.1:%1").arg(DefaultTcpPort);
+    tcp.description = "Simulation over TCP";
+    transports.append(tcp);
+    return transports;
+}
+
+QIODevice *Transport::open(int baudRate, QObject *parent, QString& errorMessage) const
+{
+    switch (kind) {
+    case Serial:
+    case Pty: {
+        // QSerialPort takes a full path as well as a port name, so a pty is just another tty
+        QSerialPort *port = new QSerialPort(parent);
+        port->setPortName(address);
+        port->setBaudRate(baudRate);
+        port->setDataBits(QSerialPort::Data8);
+        port->setParity(QSerialPort::NoParity);
+        port->setStopBits(QSerialPort::OneStop);
+        port->setFlowControl(QSerialPort::NoFlowControl);
+        if (!port->open(QIODevice::ReadWrite)) {
+            errorMessage = QString("Failed to connect to %1: %2").arg(address, port->errorString());
+            delete port;
+            return nullptr;
+        }
+        return port;
+    }
+
+    case Tcp: {
+        const int colon = address.lastIndexOf(':');
+        QTcpSocket *socket = new QTcpSocket(parent);
+        // Frames are a few bytes each; do not let Nagle hold them back
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        socket->connectToHost(address.left(colon), quint16(address.mid(colon + 1).toUInt()));
+        if (!socket->waitForConnected(ConnectTimeoutMs)) {
+            errorMessage = QString("Failed to connect to %1: %2").arg(address, socket->errorString());
+            delete socket;
+            return nullptr;
+        }
+        return socket;
+    }
+
+    case InProcess: {
+        SimulatedCore *core = new SimulatedCore(parent);
+        core->open(QIODevice::ReadWrite);
+        return core;
+    }
+    }
+
+    errorMessage = "Unknown transport";
+    return nullptr;
+}
@@ -0,0 +1,44 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <QIODevice>
+#include <QList>
+#include <QString>
+
+// Where a session's bytes go. Every transport is a QIODevice, the interface
+// RiscVSession already drives, so framing and decoding are the same for all
+// of them; this only names, lists and opens them.
+//
+//   serial:<name>      a board on a serial port (a bare name means this too)
+//   pty:<path>         a pseudo-terminal, e.g. an RTL simulation's UART behind socat
+//   tcp:<host>:<port>  a simulation listening on a socket, normally on localhost
+//   sim:               the in-process SimulatedCore, at its own speed
+class Transport
+{
+public:
+    enum Kind { Serial, Pty, Tcp, InProcess };
+
+    Kind kind = Serial;
+    QString address;        // port name, pty path or host:port; empty in-process
+    QString description;    // shown next to the name in port lists
+
+    static const quint16 DefaultTcpPort = 5555;
+    static const int ConnectTimeoutMs = 3000;
+
+    static bool parse(const QString& text, Transport& transport, QString& errorMessage);
+    QString toString() const;
+    // Short name for logs and metric labels: the port name, path or host:port
+    QString name() const;
+
+    // Serial ports present now. Enumeration can take a while with many USB
+    // adapters, so the GUI calls this off its thread (see PortWatcher).
+    static QList<Transport> serialPorts();
+    // The in-process core and the default localhost TCP endpoint
+    static QList<Transport> builtIn();
+
+    // A new, open device owned by parent; nullptr and a message on failure.
+    // TCP blocks for up to ConnectTimeoutMs while connecting.
+    QIODevice *open(int baudRate, QObject *parent, QString& errorMessage) const;
+};
+
+#endif // TRANSPORT_H
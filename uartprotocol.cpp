@@ -0,0 +1,102 @@
+#include "uartprotocol.h"
+
+ProtocolDecoder::ProtocolDecoder()
+    : readPosition(0)
+    , stage(Idle)
+{
+}
+
+void ProtocolDecoder::reset()
+{
+    buffer.clear();
+    readPosition = 0;
+    stage = Idle;
+}
+
+void ProtocolDecoder::expect(UartProtocol::Response response)
+{
+    switch (response) {
+    case UartProtocol::Response::Ready:          stage = AwaitReady; break;
+    case UartProtocol::Response::Store:          stage = AwaitStore; break;
+    case UartProtocol::Response::Load:           stage = AwaitLoad; break;
+    case UartProtocol::Response::ProgramCounter: stage = AwaitProgramCounter; break;
+    }
+}
+
+void ProtocolDecoder::feed(const char *data, int size)
+{
+    // Drop consumed bytes before growing the buffer instead of after every frame
+    if (readPosition > 0 && readPosition == buffer.size()) {
+        buffer.clear();
+        readPosition = 0;
+    } else if (readPosition >= 4096) {
+        buffer.remove(0, readPosition);
+        readPosition = 0;
+    }
+    buffer.append(data, size);
+}
+
+const char *ProtocolDecoder::take(int count)
+{
+    if (buffer.size() - readPosition < count) {
+        return nullptr;
+    }
+    const char *bytes = buffer.constData() + readPosition;
+    readPosition += count;
+    return bytes;
+}
+
+bool ProtocolDecoder::nextEvent(Event& event)
+{
+    const char *bytes;
+    switch (stage) {
+    case AwaitStore:
+        if (!(bytes = take(UartProtocol::StoreFrameSize))) {
+            return false;
+        }
+        event.type = Event::Store;
+        event.address = UartProtocol::readWord(bytes);
+        event.flags = quint8(bytes[4]);
+        event.value = UartProtocol::readWord(bytes + 5);
+        stage = AwaitReady;
+        return true;
+
+    case AwaitLoad:
+        if (!(bytes = take(UartProtocol::LoadFrameSize))) {
+            return false;
+        }
+        event.type = Event::LoadRequest;
+        event.address = UartProtocol::readWord(bytes);
+        event.flags = quint8(bytes[4]);
+        event.value = 0;
+        stage = AwaitReady;
+        return true;
+
+    case AwaitProgramCounter:
+        if (!(bytes = take(UartProtocol::WordSize))) {
+            return false;
+        }
+        event.type = Event::ProgramCounter;
+        event.value = UartProtocol::readWord(bytes);
+        stage = AwaitReady;
+        return true;
+
+    case AwaitReady:
+    case Idle:
+        if (!(bytes = take(1))) {
+            return false;
+        }
+        event.address = 0;
+        event.flags = 0;
+        event.value = quint8(bytes[0]);
+        if (quint8(bytes[0]) == UartProtocol::CpuReady) {
+            event.type = Event::CpuReady;
+            stage = Idle;
+        } else {
+            // Stay in the current stage: the ready byte may still follow
+            event.type = Event::UnexpectedByte;
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,105 @@
+#ifndef UARTPROTOCOL_H
+#define UARTPROTOCOL_H
+
+#include <QByteArray>
+
+// Byte-level protocol of the core's UART controller (see docs/doc.md)
+namespace UartProtocol {
+
+// Host -> core commands, sent while the controller is in CPU_READY
+const char ResetCommand = 0x01;
+const char ProgramCounterCommand = 0x02;
+const char InstructionCommand = 0x03;   // any value other than 1 or 2 works
+
+// Core -> host
+const quint8 CpuReady = 0x01;
+const quint8 WriteFlag = 65;            // read/write byte of a store frame
+
+const int InstructionFrameSize = 5;     // command + 32-bit word
+const int StoreFrameSize = 9;           // address + read/write + data
+const int LoadFrameSize = 5;            // address + size
+const int WordSize = 4;
+
+// What the controller sends back after a command, before CPU_READY
+enum class Response { Ready, Store, Load, ProgramCounter };
+
+inline Response responseFor(quint32 machineCode)
+{
+    switch (machineCode & 0x7F) {
+    case 0x23: return Response::Store;
+    case 0x03: return Response::Load;
+    default:   return Response::Ready;
+    }
+}
+
+inline quint32 readWord(const char *bytes)
+{
+    return quint32(quint8(bytes[0]))
+           | (quint32(quint8(bytes[1])) << 8)
+           | (quint32(quint8(bytes[2])) << 16)
+           | (quint32(quint8(bytes[3])) << 24);
+}
+
+inline void writeWord(char *bytes, quint32 value)
+{
+    bytes[0] = char(value & 0xFF);
+    bytes[1] = char((value >> 8) & 0xFF);
+    bytes[2] = char((value >> 16) & 0xFF);
+    bytes[3] = char((value >> 24) & 0xFF);
+}
+
+inline QByteArray instructionFrame(quint32 machineCode)
+{
+    QByteArray frame(InstructionFrameSize, Qt::Uninitialized);
+    frame[0] = InstructionCommand;
+    writeWord(frame.data() + 1, machineCode);
+    return frame;
+}
+
+inline QByteArray wordBytes(quint32 value)
+{
+    QByteArray bytes(WordSize, Qt::Uninitialized);
+    writeWord(bytes.data(), value);
+    return bytes;
+}
+
+}
+
+// Turns received bytes into protocol events. The controller's replies are
+// only unambiguous given what was sent, so the session tells the decoder
+// which response to expect before each command.
+class ProtocolDecoder
+{
+public:
+    struct Event {
+        enum Type { CpuReady, ProgramCounter, Store, LoadRequest, UnexpectedByte };
+        Type type = CpuReady;
+        quint32 address = 0;
+        quint32 value = 0;      // store data, program counter or unexpected byte
+        quint8 flags = 0;       // store read/write byte or load size
+    };
+
+    ProtocolDecoder();
+
+    void expect(UartProtocol::Response response);
+    void feed(const char *data, int size);
+    void feed(const QByteArray& bytes) { feed(bytes.constData(), bytes.size()); }
+
+    // Decodes the next complete event; false when more bytes are needed
+    bool nextEvent(Event& event);
+
+    bool isIdle() const { return stage == Idle; }
+    int bufferedBytes() const { return buffer.size() - readPosition; }
+    void reset();
+
+private:
+    enum Stage { Idle, AwaitReady, AwaitStore, AwaitLoad, AwaitProgramCounter };
+
+    const char *take(int count);
+
+    QByteArray buffer;
+    int readPosition;
+    Stage stage;
+};
+
+#endif // UARTPROTOCOL_H
@@ -0,0 +1,278 @@
+#include "vcdwriter.h"
+#include <QDateTime>
+#include <algorithm>
+
+namespace {
+
+struct SignalInfo {
+    const char *name;
+    int width;
+};
+
+// In VcdWriter::Signal order; identifiers are '!' + index
+const SignalInfo signalInfo[] = {
+    {"tx_byte", 8}, {"tx_valid", 1}, {"rx_byte", 8}, {"rx_valid", 1}, {"frame", 4}, {"fsm_state", 4},
+    {"instruction", 32}, {"pc", 32}, {"mem_addr", 32}, {"mem_data", 32}, {"mem_we", 1}, {"mem_valid", 1},
+    {"cpu_ready", 1},
+};
+
+const char *frameNames[] = {
+    "none", "instruction", "reset", "pc request", "load data", "store", "load request", "pc", "ready", "unexpected byte"
+};
+
+const char *stateNames[] = {
+    "IDLE", "RESET_CPU", "SEND_READY", "CPU_READY", "SEND_PC_PREV", "SEND_PC", "WAIT_INST", "RUN_CPU",
+    "CPU_CLK", "SEND_ADDRESS", "SEND_MEMWRITE", "SEND_DATA", "SEND_SIZELOAD", "WAIT_RECV_DATA", "RECV_DATA",
+    "RECV_DATA_CLK"
+};
+
+void appendCodes(QByteArray& out, const char *title, const char *const *names, int count)
+{
+    out += "$comment ";
+    out += title;
+    for (int i = 0; i < count; i++) {
+        out += QByteArray(i == 0 ? " " : ", ") + QByteArray::number(i) + ' ' + names[i];
+    }
+    out += " $end\n";
+}
+
+}
+
+VcdWriter::VcdWriter()
+    : currentTime(0)
+    , changes(0)
+    , writeFailed(false)
+{
+    std::fill(values, values + SignalCount, 0);
+}
+
+VcdWriter::~VcdWriter()
+{
+    QString errorMessage;
+    close(errorMessage);
+}
+
+bool VcdWriter::open(const QString& fileName, QString& errorMessage)
+{
+    QString closeError;
+    close(closeError);
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = QString("Could not open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    currentTime = 0;
+    changes = 0;
+    writeFailed = false;
+    std::fill(values, values + SignalCount, 0);
+    buffer.reserve(FlushThreshold + 4096);
+    writeHeader();
+    clock.start();
+    return true;
+}
+
+bool VcdWriter::close(QString& errorMessage)
+{
+    if (!file.isOpen()) {
+        return true;
+    }
+    flush();
+    const bool ok = !writeFailed;
+    if (!ok) {
+        errorMessage = QString("Failed to write %1: %2").arg(file.fileName(), file.errorString());
+    }
+    file.close();
+    return ok;
+}
+
+void VcdWriter::writeHeader()
+{
+    buffer += "$date " + QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8() + " $end\n";
+    buffer += "$version Risc-V-Testing host link $end\n";
+    appendCodes(buffer, "frame:", frameNames, int(sizeof(frameNames) / sizeof(frameNames[0])));
+    appendCodes(buffer, "fsm_state:", stateNames, int(sizeof(stateNames) / sizeof(stateNames[0])));
+    buffer += "$timescale 1ns $end\n";
+    buffer += "$scope module host $end\n";
+    for (int i = 0; i < SignalCount; i++) {
+        buffer += QByteArray("$var wire ") + QByteArray::number(signalInfo[i].width) + ' ' + char('!' + i) + ' '
+                  + signalInfo[i].name;
+        if (signalInfo[i].width > 1) {
+            buffer += " [" + QByteArray::number(signalInfo[i].width - 1) + ":0]";
+        }
+        buffer += " $end\n";
+    }
+    buffer += "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n";
+    for (int i = 0; i < SignalCount; i++) {
+        buffer += signalInfo[i].width > 1 ? QByteArray("b0 ") : QByteArray("0");
+        buffer += char('!' + i);
+        buffer += '\n';
+    }
+    buffer += "$end\n";
+}
+
+void VcdWriter::advance(quint64 time)
+{
+    if (time <= currentTime) {
+        return;
+    }
+    currentTime = time;
+    char digits[24];
+    int length = 0;
+    do {
+        digits[length++] = char('0' + time % 10);
+        time /= 10;
+    } while (time);
+    buffer += '#';
+    while (length) {
+        buffer += digits[--length];
+    }
+    buffer += '\n';
+}
+
+void VcdWriter::set(Signal signal, quint32 value)
+{
+    if (values[signal] == value) {
+        return;
+    }
+    values[signal] = value;
+    changes++;
+
+    if (signalInfo[signal].width == 1) {
+        buffer += value ? '1' : '0';
+    } else {
+        // Leading zeros are implied
+        char bits[34];
+        int length = 0;
+        bits[length++] = 'b';
+        int top = 31;
+        while (top > 0 && !((value >> top) & 1)) {
+            top--;
+        }
+        for (int bit = top; bit >= 0; bit--) {
+            bits[length++] = char('0' + ((value >> bit) & 1));
+        }
+        bits[length++] = ' ';
+        buffer.append(bits, length);
+    }
+    buffer += char('!' + signal);
+    buffer += '\n';
+
+    if (buffer.size() >= FlushThreshold) {
+        flush();
+    }
+}
+
+void VcdWriter::pulse(Signal signal)
+{
+    set(signal, 1);
+    advance(currentTime + 1);
+    set(signal, 0);
+}
+
+void VcdWriter::flush()
+{
+    if (buffer.isEmpty()) {
+        return;
+    }
+    if (file.write(buffer) != buffer.size()) {
+        writeFailed = true;
+    }
+    buffer.clear();
+}
+
+void VcdWriter::bytesSent(const char *data, qint64 size)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    advance(quint64(clock.nsecsElapsed()));
+    for (qint64 i = 0; i < size; i++) {
+        set(TxByte, quint8(data[i]));
+        pulse(TxValid);
+    }
+}
+
+void VcdWriter::bytesReceived(const char *data, qint64 size)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    advance(quint64(clock.nsecsElapsed()));
+    for (qint64 i = 0; i < size; i++) {
+        set(RxByte, quint8(data[i]));
+        pulse(RxValid);
+    }
+}
+
+void VcdWriter::instructionSent(quint32 machineCode)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    set(InstructionWord, machineCode);
+    set(FrameType, InstructionFrame);
+    setState(RunCpu);
+}
+
+void VcdWriter::commandSent(char command)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    if (command == UartProtocol::ResetCommand) {
+        set(FrameType, ResetFrame);
+        setState(ResetCpu);
+    } else {
+        set(FrameType, PcRequestFrame);
+        setState(SendPc);
+    }
+}
+
+void VcdWriter::loadDataSent(quint32 value)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    set(FrameType, LoadDataFrame);
+    set(MemData, value);
+    pulse(MemValid);
+    setState(RecvDataClk);
+}
+
+void VcdWriter::eventDecoded(const ProtocolDecoder::Event& event)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    switch (event.type) {
+    case ProtocolDecoder::Event::CpuReady:
+        set(FrameType, ReadyFrame);
+        setState(CpuReady);
+        pulse(CpuReadyPulse);
+        break;
+    case ProtocolDecoder::Event::ProgramCounter:
+        set(FrameType, PcFrame);
+        set(ProgramCounter, event.value);
+        setState(SendReady);
+        break;
+    case ProtocolDecoder::Event::Store:
+        set(FrameType, StoreFrame);
+        set(MemAddress, event.address);
+        set(MemData, event.value);
+        set(MemWriteEnable, 1);
+        pulse(MemValid);
+        setState(SendData);
+        break;
+    case ProtocolDecoder::Event::LoadRequest:
+        // The data follows when the host replies
+        set(FrameType, LoadRequestFrame);
+        set(MemAddress, event.address);
+        set(MemWriteEnable, 0);
+        setState(WaitRecvData);
+        break;
+    case ProtocolDecoder::Event::UnexpectedByte:
+        set(FrameType, UnexpectedFrame);
+        break;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef VCDWRITER_H
+#define VCDWRITER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include "uartprotocol.h"
+
+// Streams a session's link activity as a Value Change Dump, so the host side
+// can be opened in GTKWave next to the controller's RTL trace. Timestamps are
+// host nanoseconds since open(); output goes through a buffer flushed in
+// large writes, so multi-million-event sessions stay cheap.
+//
+// Signals, all under the "host" scope:
+//   tx_byte[7:0], tx_valid     each byte written to the device (1 ns pulse)
+//   rx_byte[7:0], rx_valid     each byte read from the device
+//   frame[3:0]                 last frame sent or decoded, see Frame
+//   fsm_state[3:0]             controller state inferred by the host, see State
+//   instruction[31:0]          last instruction word sent
+//   pc[31:0]                   last program counter read back
+//   mem_addr[31:0], mem_data[31:0], mem_we, mem_valid
+//                              last load or store the host served
+//   cpu_ready                  pulse per CPU_READY byte
+// The header's $comment lists the numeric codes of frame and fsm_state.
+class VcdWriter
+{
+public:
+    enum Frame {
+        NoFrame, InstructionFrame, ResetFrame, PcRequestFrame, LoadDataFrame,
+        StoreFrame, LoadRequestFrame, PcFrame, ReadyFrame, UnexpectedFrame
+    };
+
+    // Named as in docs/img/CommFSM.png; the host sees only the states that
+    // move bytes, so the others are never entered
+    enum State {
+        Idle, ResetCpu, SendReady, CpuReady, SendPcPrev, SendPc, WaitInst, RunCpu,
+        CpuClk, SendAddress, SendMemWrite, SendData, SendSizeLoad, WaitRecvData, RecvData, RecvDataClk
+    };
+
+    VcdWriter();
+    ~VcdWriter();
+
+    bool open(const QString& fileName, QString& errorMessage);
+    // Flushes and closes; false if any write failed
+    bool close(QString& errorMessage);
+    bool isOpen() const { return file.isOpen(); }
+    quint64 changeCount() const { return changes; }
+
+    // Called by RiscVSession on its event path
+    void bytesSent(const char *data, qint64 size);
+    void bytesReceived(const char *data, qint64 size);
+    void instructionSent(quint32 machineCode);
+    void commandSent(char command);
+    void loadDataSent(quint32 value);
+    void eventDecoded(const ProtocolDecoder::Event& event);
+
+private:
+    enum Signal {
+        TxByte, TxValid, RxByte, RxValid, FrameType, FsmState, InstructionWord,
+        ProgramCounter, MemAddress, MemData, MemWriteEnable, MemValid, CpuReadyPulse, SignalCount
+    };
+
+    static const int FlushThreshold = 1 << 20;
+
+    void writeHeader();
+    void advance(quint64 time);
+    void set(Signal signal, quint32 value);
+    void pulse(Signal signal);
+    void setState(State state) { set(FsmState, quint32(state)); }
+    void flush();
+
+    QFile file;
+    QByteArray buffer;
+    QElapsedTimer clock;
+    quint64 currentTime;
+    quint32 values[SignalCount];
+    quint64 changes;
+    bool writeFailed;
+};
+
+#endif // VCDWRITER_H